@@ -1199,5 +1199,18 @@ void wiz_recv_data(uint8_t sn, uint8_t *wizdata, uint16_t len);
  */
 void wiz_recv_ignore(uint8_t sn, uint16_t len);
 
+/**
+ * @ingroup Basic_IO_function
+ * @brief It copies data to your buffer from internal RX memory without updating the Rx read pointer
+ * @details It copies the data of the length of <i>len(variable)</i> bytes at <i>offset</i> bytes from the Rx read pointer.
+ * The data is consumed later by wiz_recv_data() or wiz_recv_ignore().
+ * @param (uint8_t)sn Socket number. It should be <b>0 ~ 7</b>.
+ * @param offset Offset from the Rx read pointer
+ * @param wizdata Pointer buffer to read data
+ * @param len Data length
+ * @sa wiz_recv_data(), wiz_recv_ignore()
+ */
+void wiz_recv_peek(uint8_t sn, uint16_t offset, uint8_t *wizdata, uint16_t len);
+
 #endif
 
@@ -81,12 +81,12 @@ uint32_t UART_Init(UART_TypeDef *UARTx, UART_InitTypeDef* UART_InitStruct)
     tmpreg = UARTx->LCR_H;
     tmpreg &= ~(0x00EE);
     tmpreg |= (UART_InitStruct->UART_WordLength | UART_InitStruct->UART_StopBits | UART_InitStruct->UART_Parity);
-    UARTx->LCR_H |= tmpreg;
+    UARTx->LCR_H = tmpreg; // Re-initialization: the previous word length / stop / parity bits are cleared
 
     tmpreg = UARTx->CR;
     tmpreg &= ~(UART_CR_CTSEn | UART_CR_RTSEn | UART_CR_RXE | UART_CR_TXE | UART_CR_UARTEN);
     tmpreg |= (UART_InitStruct->UART_Mode | UART_InitStruct->UART_HardwareFlowControl);
-    UARTx->CR |= tmpreg;
+    UARTx->CR = tmpreg;
 
     UARTx->CR |= UART_CR_UARTEN;
 
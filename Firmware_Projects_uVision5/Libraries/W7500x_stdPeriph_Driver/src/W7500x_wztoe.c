@@ -84,3 +84,15 @@ void wiz_recv_ignore(uint8_t sn, uint16_t len)
     setSn_RX_RD(sn,ptr);
 }
 
+
+void wiz_recv_peek(uint8_t sn, uint16_t offset, uint8_t *wizdata, uint16_t len)
+{
+    uint32_t ptr = 0;
+    uint32_t sn_rx_base = 0; 
+
+    if(len == 0) return;
+    ptr = getSn_RX_RD(sn) + offset;
+    sn_rx_base = (RXMEM_BASE) | ((sn&0x7)<<18);
+    WIZCHIP_READ_BUF(sn_rx_base, ptr, wizdata, len);
+}
+
@@ -0,0 +1,203 @@
+/*
+ * bench_segcp.c
+ * W7500x S2E App - Linux host simulation build: SEGCP command lookup check and benchmark
+ *
+ * Usage: bench_segcp [rounds]       (make bench)
+ *
+ * segcp.c is included, find_SEGCP_cmd() is static; linked with the application objects in place of sim_main.o and segcp.o.
+ * 1. Every 2-character key (65536) is looked up and compared with a linear search of tbSEGCPCMD: the switch cases
+ *    must match the table and the enum (teSEGCPCMDNUM).
+ * 2. All commands of tbSEGCPCMD are looked up [rounds] times by find_SEGCP_cmd() and the linear search (strncmp, as
+ *    parse_SEGCP() did before); time per lookup.
+ * 3. A request of every read command without side effects (the settings and status read of a configuration tool) is
+ *    processed by proc_SEGCP() [rounds / 100] times with each lookup (SEGCP_FIND_CMD); CPU time per request.
+ */
+
+#include <stdint.h>
+
+static uint8_t (*bench_find_cmd)(uint8_t * pmsg);
+#define SEGCP_FIND_CMD(pmsg)		bench_find_cmd(pmsg)
+
+#include "../src/Configuration/segcp.c"
+
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "sim.h"
+
+#define BENCH_ROUNDS				100000
+#define BENCH_REQ_SIZE				1024
+#define BENCH_REP_SIZE				8192
+
+// sim_main.c is not linked
+sim_options_t sim_opt;
+
+uint64_t sim_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+void sim_wake(void) {}
+void sim_reboot(void) { exit(1); }
+int sim_pty_open(int * slave, char * name, int len) { return -1; }
+
+// proc_SEGCP() reads the timer, WZTOE and GPIO registers: the peripheral range is mapped as sim_main.c does (no hardware thread)
+static void bench_periph_map(void)
+{
+	void * p;
+
+	p = mmap((void *)SIM_PERIPH_BASE, (SIM_PERIPH_END - SIM_PERIPH_BASE), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+	if(p != (void *)SIM_PERIPH_BASE)
+	{
+		fprintf(stderr, "bench: peripheral address range 0x%08lx mapping failed\r\n", SIM_PERIPH_BASE);
+		exit(1);
+	}
+}
+
+static uint64_t bench_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static uint8_t find_linear(uint8_t * pmsg)
+{
+	uint8_t cmdnum;
+
+	for(cmdnum = 0; tbSEGCPCMD[cmdnum] != 0; cmdnum++)
+	{
+		if(!strncmp((char *)tbSEGCPCMD[cmdnum], (char *)pmsg, strlen((char *)tbSEGCPCMD[cmdnum]))) return cmdnum;
+	}
+	return SEGCP_UNKNOWN;
+}
+
+static double bench(uint8_t (*find)(uint8_t *), uint8_t lines[][4], int num, long rounds, uint32_t * sum)
+{
+	uint64_t start;
+	long r;
+	int i;
+
+	*sum = 0;
+	start = bench_cpu_ns();
+	for(r = 0; r < rounds; r++)
+	{
+		for(i = 0; i < num; i++) *sum += find(lines[i]);
+	}
+	return (double)(bench_cpu_ns() - start) / ((double)rounds * num);
+}
+
+// Request of the read commands: a command is taken if its read alone returns no error and no action (reboot, save ...)
+static int make_read_request(uint8_t * req, int num)
+{
+	uint8_t line[8];
+	uint8_t rep[BENCH_REP_SIZE];
+	uint16_t len = 0;
+	int cmds = 0;
+	int i;
+
+	bench_find_cmd = find_SEGCP_cmd;
+	gSEGCPPRIVILEGE = SEGCP_PRIVILEGE_READ;
+	for(i = 0; i < num; i++)
+	{
+		sprintf((char *)line, "%s\r\n", tbSEGCPCMD[i]);
+		if(proc_SEGCP(line, rep) != 0) continue;
+		len += sprintf((char *)&req[len], "%s\r\n", tbSEGCPCMD[i]);
+		cmds++;
+	}
+	return cmds;
+}
+
+static double bench_request(uint8_t (*find)(uint8_t *), uint8_t * req, long rounds, uint32_t * sum)
+{
+	static uint8_t rep[BENCH_REP_SIZE];
+	uint8_t buf[BENCH_REQ_SIZE];
+	uint16_t len = strlen((char *)req) + 1;
+	uint64_t start;
+	long r;
+
+	bench_find_cmd = find;
+	*sum = 0;
+	start = bench_cpu_ns();
+	for(r = 0; r < rounds; r++)
+	{
+		memcpy(buf, req, len); // proc_SEGCP() splits the request in place (strtok)
+		*sum += proc_SEGCP(buf, rep);
+		*sum += strlen((char *)rep);
+	}
+	return (double)(bench_cpu_ns() - start) / (double)rounds;
+}
+
+int main(int argc, char * argv[])
+{
+	static uint8_t lines[256][4];
+	static uint8_t req[BENCH_REQ_SIZE];
+	long rounds = (argc > 1) ? atol(argv[1]) : BENCH_ROUNDS;
+	uint8_t key[4] = {0, };
+	uint32_t sum[4];
+	double ns[4];
+	int errors = 0;
+	int num;
+	int cmds;
+	int c0, c1;
+
+	// 1. Every key
+	for(c0 = 0; c0 < 256; c0++)
+	{
+		for(c1 = 0; c1 < 256; c1++)
+		{
+			key[0] = (uint8_t)c0;
+			key[1] = (uint8_t)c1;
+			if((c0 != 0) && (find_SEGCP_cmd(key) != find_linear(key)))
+			{
+				if(errors++ < 10) printf("MISMATCH: [%02X %02X] switch %d, table %d\r\n", c0, c1, find_SEGCP_cmd(key), find_linear(key));
+			}
+		}
+	}
+	for(num = 0; tbSEGCPCMD[num] != 0; num++)
+	{
+		if(find_SEGCP_cmd(tbSEGCPCMD[num]) != num)
+		{
+			if(errors++ < 10) printf("MISMATCH: %s is %d in tbSEGCPCMD, not found by the switch\r\n", tbSEGCPCMD[num], num);
+		}
+	}
+	if(errors)
+	{
+		printf("FAIL: %d lookups differ from tbSEGCPCMD\r\n", errors);
+		return 1;
+	}
+	printf("PASS: %d commands, 65536 keys\r\n", num);
+
+	// 2. Lookup time
+	for(c0 = 0; c0 < num; c0++) memcpy(lines[c0], tbSEGCPCMD[c0], 3);
+
+	ns[0] = bench(find_linear, lines, num, rounds, &sum[0]);
+	ns[1] = bench(find_SEGCP_cmd, lines, num, rounds, &sum[1]);
+
+	printf("%-24s %8.1f ns/lookup\r\n", "linear (strncmp)", ns[0]);
+	printf("%-24s %8.1f ns/lookup\r\n", "switch (find_SEGCP_cmd)", ns[1]);
+
+	// 3. Read request through proc_SEGCP()
+	bench_periph_map();
+	set_DevConfig_to_factory_value();
+	cmds = make_read_request(req, num);
+	rounds = (rounds >= 100) ? (rounds / 100) : 1;
+
+	ns[2] = bench_request(find_linear, req, rounds, &sum[2]);
+	ns[3] = bench_request(find_SEGCP_cmd, req, rounds, &sum[3]);
+
+	printf("%-24s %8.2f usec/request (%d commands)\r\n", "linear (strncmp)", ns[2] / 1000.0, cmds);
+	printf("%-24s %8.2f usec/request (%d commands)\r\n", "switch (find_SEGCP_cmd)", ns[3] / 1000.0, cmds);
+
+	if((sum[0] != sum[1]) || (sum[2] != sum[3]))
+	{
+		printf("FAIL: checksum %u / %u, request %u / %u\r\n", sum[0], sum[1], sum[2], sum[3]);
+		return 1;
+	}
+	return 0;
+}
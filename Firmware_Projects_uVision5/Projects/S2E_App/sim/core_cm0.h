@@ -0,0 +1,58 @@
+/*
+ * core_cm0.h
+ * Host simulation build: replaces the CMSIS Cortex-M0 core header (Libraries/CMSIS/Include/core_cm0.h),
+ * found first on the include path. The core intrinsics and the NVIC / SysTick functions are
+ * implemented by the simulated core (sim_core.c).
+ */
+
+#ifndef __CORE_CM0_H_GENERIC
+#define __CORE_CM0_H_GENERIC
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* IO definitions (access restrictions to peripheral registers) */
+#define     __I     volatile const
+#define     __O     volatile
+#define     __IO    volatile
+
+#define __ASM            __asm__
+#define __INLINE         inline
+#define __STATIC_INLINE  static inline
+
+/* Core intrinsics */
+void __enable_irq(void);
+void __disable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+uint32_t __get_IPSR(void);
+void __WFI(void);
+
+__STATIC_INLINE void __NOP(void) { __ASM volatile ("" ::: "memory"); }
+__STATIC_INLINE void __DSB(void) { __sync_synchronize(); }
+__STATIC_INLINE void __ISB(void) { __sync_synchronize(); }
+__STATIC_INLINE void __DMB(void) { __sync_synchronize(); }
+__STATIC_INLINE uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+__STATIC_INLINE uint32_t __REV16(uint32_t value) { return (uint32_t)((__builtin_bswap32(value) >> 16) | (__builtin_bswap32(value) << 16)); }
+
+/* NVIC */
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type IRQn);
+void NVIC_SystemReset(void);
+
+/* SysTick */
+uint32_t SysTick_Config(uint32_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CORE_CM0_H_GENERIC */
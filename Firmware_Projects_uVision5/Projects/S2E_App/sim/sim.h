@@ -0,0 +1,67 @@
+/*
+ * sim.h
+ * W7500x S2E App - Linux host simulation build
+ *
+ * The S2E application runs unmodified on the main thread. The peripherals are simulated by a 'hardware' thread
+ * that services the timers, the data UART (pty) and the WZTOE sockets (Linux TCP/UDP sockets), and raises the
+ * interrupts; the ISRs are run on the main thread as signal handlers, masked by PRIMASK as on the Cortex-M0 core.
+ */
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdint.h>
+#include <poll.h>
+
+#define SIM_IRQ_SYSTICK			31		// SysTick exception, pending / enable bit position in the simulated NVIC
+
+#define SIM_PERIPH_BASE			0x40000000UL	// APB1 ~ WZTOE socket buffers, mapped to the host memory
+#define SIM_PERIPH_END			0x46200000UL
+
+#define SIM_FLASH_SIZE			0x40000			// Main flash (128kB), Information block, Data flash 0/1
+
+#define SIM_POLL_MAX			32
+
+typedef struct {
+	uint8_t bind_ip[4];			// Host address the simulated sockets are bound to
+	uint16_t port_offset;		// Added to the local port numbers of the simulated sockets
+	uint8_t uart_pacing;		// [1] UART characters are paced at the configured baud rate / [0] host speed
+	const char * flash_file;	// Flash image file (config data / app backup area)
+	const char * uart_link;		// Symbolic link to the data UART pty, NULL: not used
+	uint8_t recv_log;			// [1] The socket RECV commands are logged to stderr (one per drain pass)
+} sim_options_t;
+
+extern sim_options_t sim_opt;
+
+/* sim_main.c */
+uint64_t sim_time_ns(void);
+void sim_wake(void);								// Wakes up the hardware thread; call after changing the polled state
+void sim_reboot(void);
+int sim_pty_open(int * slave, char * name, int len);	// ret: master fd / -1
+
+/* sim_core.c */
+void sim_core_init(void);
+void sim_irq_raise(int irqn);						// Any thread, SIM_IRQ_SYSTICK or IRQn_Type >= 0
+uint32_t sim_irq_pending(int irqn);
+uint32_t sim_critical_enter(void);					// Main thread: interrupts masked while the simulated peripheral state is locked
+void sim_critical_exit(uint32_t primask);
+uint64_t sim_systick_period_ns(void);				// 0: SysTick not configured
+
+/* sim_timer.c */
+uint64_t sim_timer_service(uint64_t now);			// ret: next deadline (ns)
+
+/* sim_uart.c */
+void sim_uart_init(void);
+int sim_uart_pollfds(struct pollfd * pfd);
+uint64_t sim_uart_service(uint64_t now, const struct pollfd * pfd, int cnt);
+
+/* sim_wztoe.c */
+void sim_wztoe_init(void);
+int sim_wztoe_pollfds(struct pollfd * pfd);
+uint64_t sim_wztoe_service(uint64_t now, const struct pollfd * pfd, int cnt);
+
+/* sim_flash.c */
+void sim_flash_init(void);
+void sim_flash_sync(void);
+
+#endif /* __SIM_H__ */
@@ -0,0 +1,231 @@
+/*
+ * sim_core.c
+ * W7500x S2E App - Linux host simulation build: Cortex-M0 core (PRIMASK, IPSR, WFI, NVIC, SysTick)
+ *
+ * The interrupts are raised by the hardware thread as a signal to the main thread; the signal handler runs the
+ * pending ISRs unless PRIMASK is set, then they are run by __enable_irq() / __set_PRIMASK(0).
+ * ISRs are not nested: a pending interrupt waits for the running ISR to return, then the highest priority runs first.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include "W7500x.h"
+#include "W7500x_it.h"
+#include "sim.h"
+
+#define SIM_IRQ_SIGNAL		SIGUSR1
+#define SIM_IRQ_NUM			32
+#define SIM_PRIO_LOWEST		((1 << __NVIC_PRIO_BITS) - 1)
+
+void PORT3_Handler(void);
+
+// Vector table: IRQ number order as startup_W7500x.s, SysTick at SIM_IRQ_SYSTICK
+static void (* const sim_vector[SIM_IRQ_NUM])(void) = {
+	SSP0_Handler, SSP1_Handler, UART0_Handler, UART1_Handler, UART2_Handler, I2C0_Handler, I2C1_Handler, PORT0_Handler,
+	PORT1_Handler, PORT2_Handler, PORT3_Handler, DMA_Handler, DUALTIMER0_Handler, DUALTIMER1_Handler, PWM0_Handler, PWM1_Handler,
+	PWM2_Handler, PWM3_Handler, PWM4_Handler, PWM5_Handler, PWM6_Handler, PWM7_Handler, 0, ADC_Handler,
+	WZTOE_Handler, EXTI_Handler, 0, 0, 0, 0, 0, SysTick_Handler
+};
+
+static pthread_t main_thread;
+
+static volatile uint32_t irq_primask = 0;
+static volatile uint32_t irq_pending = 0;
+static volatile uint32_t irq_enabled = 0;
+static volatile uint32_t irq_active = 0;
+static volatile uint32_t irq_exception = 0;	// IPSR: exception number of the running ISR, 0 in thread mode
+static uint8_t irq_prio[SIM_IRQ_NUM];
+
+static uint64_t systick_ns = 0;
+
+static int irq_next(void)
+{
+	uint32_t act = irq_pending & irq_enabled;
+	int i, next = -1;
+
+	for(i = 0; i < SIM_IRQ_NUM; i++)
+	{
+		if((act & (1UL << i)) && ((next < 0) || (irq_prio[i] < irq_prio[next]))) next = i;
+	}
+	return next;
+}
+
+static void irq_dispatch(void)
+{
+	int irqn;
+
+	while(!irq_primask && (irq_pending & irq_enabled))
+	{
+		if(__atomic_exchange_n(&irq_active, 1, __ATOMIC_ACQUIRE)) return; // ISR running; the pending ones follow it
+
+		while(!irq_primask && ((irqn = irq_next()) >= 0))
+		{
+			__atomic_and_fetch(&irq_pending, ~(1UL << irqn), __ATOMIC_ACQ_REL);
+			irq_exception = (irqn == SIM_IRQ_SYSTICK) ? 15 : (16 + irqn);
+			if(sim_vector[irqn]) sim_vector[irqn]();
+			irq_exception = 0;
+		}
+
+		__atomic_store_n(&irq_active, 0, __ATOMIC_RELEASE);
+	}
+}
+
+static void irq_signal_handler(int sig)
+{
+	int saved_errno = errno;
+
+	(void)sig;
+	irq_dispatch();
+	errno = saved_errno;
+}
+
+void sim_core_init(void)
+{
+	struct sigaction sa;
+	int i;
+
+	main_thread = pthread_self();
+	for(i = 0; i < SIM_IRQ_NUM; i++) irq_prio[i] = 0;
+
+	sa.sa_handler = irq_signal_handler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIM_IRQ_SIGNAL, &sa, 0);
+}
+
+void sim_irq_raise(int irqn)
+{
+	uint32_t bit = (1UL << irqn);
+
+	if(__atomic_fetch_or(&irq_pending, bit, __ATOMIC_ACQ_REL) & bit) return; // Already pending
+	if(!(irq_enabled & bit)) return;
+
+	if(pthread_equal(pthread_self(), main_thread)) irq_dispatch(); // Raised by an ISR / the application itself
+	else pthread_kill(main_thread, SIM_IRQ_SIGNAL);
+}
+
+uint32_t sim_irq_pending(int irqn)
+{
+	return ((irq_pending >> irqn) & 0x01);
+}
+
+uint32_t sim_critical_enter(void)
+{
+	uint32_t primask = irq_primask;
+
+	irq_primask = 1;
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	return primask;
+}
+
+void sim_critical_exit(uint32_t primask)
+{
+	__set_PRIMASK(primask);
+}
+
+uint64_t sim_systick_period_ns(void)
+{
+	return systick_ns;
+}
+
+/* Core intrinsics */
+void __disable_irq(void)
+{
+	irq_primask = 1;
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+void __enable_irq(void)
+{
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	irq_primask = 0;
+	irq_dispatch();
+}
+
+uint32_t __get_PRIMASK(void)
+{
+	return irq_primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+	if(priMask) __disable_irq();
+	else __enable_irq();
+}
+
+uint32_t __get_IPSR(void)
+{
+	return irq_exception;
+}
+
+// Sleeps until an enabled interrupt is pending; PRIMASK does not block the wake-up, as on the core
+void __WFI(void)
+{
+	sigset_t block, prev;
+
+	sigemptyset(&block);
+	sigaddset(&block, SIM_IRQ_SIGNAL);
+	pthread_sigmask(SIG_BLOCK, &block, &prev);
+	if(!(irq_pending & irq_enabled)) sigsuspend(&prev);
+	pthread_sigmask(SIG_SETMASK, &prev, 0);
+}
+
+/* NVIC */
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	__atomic_or_fetch(&irq_enabled, (1UL << IRQn), __ATOMIC_ACQ_REL);
+	if(irq_pending & (1UL << IRQn)) pthread_kill(main_thread, SIM_IRQ_SIGNAL);
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+	__atomic_and_fetch(&irq_enabled, ~(1UL << IRQn), __ATOMIC_ACQ_REL);
+}
+
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)
+{
+	return sim_irq_pending(IRQn);
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+	sim_irq_raise(IRQn);
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+	__atomic_and_fetch(&irq_pending, ~(1UL << IRQn), __ATOMIC_ACQ_REL);
+}
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+	if(IRQn == SysTick_IRQn) irq_prio[SIM_IRQ_SYSTICK] = (priority & SIM_PRIO_LOWEST);
+	else if(IRQn >= 0) irq_prio[IRQn] = (priority & SIM_PRIO_LOWEST);
+}
+
+uint32_t NVIC_GetPriority(IRQn_Type IRQn)
+{
+	if(IRQn == SysTick_IRQn) return irq_prio[SIM_IRQ_SYSTICK];
+	else if(IRQn >= 0) return irq_prio[IRQn];
+	return 0;
+}
+
+void NVIC_SystemReset(void)
+{
+	sim_reboot();
+}
+
+/* SysTick */
+uint32_t SysTick_Config(uint32_t ticks)
+{
+	if((ticks - 1) > 0xFFFFFF) return 1; // Reload value impossible
+	if(GetSystemClock() == 0) return 1;
+
+	NVIC_SetPriority(SysTick_IRQn, SIM_PRIO_LOWEST);
+	systick_ns = ((uint64_t)ticks * 1000000000ULL) / GetSystemClock();
+	__atomic_or_fetch(&irq_enabled, (1UL << SIM_IRQ_SYSTICK), __ATOMIC_ACQ_REL);
+	sim_wake();
+
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * sim_flash.c
+ * W7500x S2E App - Linux host simulation build: flashHandler.c replacement
+ *
+ * The W7500 flash (main flash, Information block, Data flash 0/1) is a file mapped image (sim_opt.flash_file);
+ * the device settings and the backup application area are kept over the simulator restarts.
+ * Program operations clear bits only as the flash memory; the erased state is 0xFF.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "W7500x.h"
+#include "flashHandler.h"
+#include "sim.h"
+
+static uint8_t * flash_image = 0;
+
+void sim_flash_init(void)
+{
+	struct stat st;
+	int fd;
+
+	fd = open(sim_opt.flash_file, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if((fd < 0) || (fstat(fd, &st) < 0))
+	{
+		perror("sim: flash image");
+		_exit(1);
+	}
+
+	if(st.st_size != SIM_FLASH_SIZE)
+	{
+		if(ftruncate(fd, SIM_FLASH_SIZE) < 0)
+		{
+			perror("sim: flash image");
+			_exit(1);
+		}
+	}
+
+	flash_image = mmap(0, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	syscall(SYS_close, fd); // close() is the ioLibrary socket API
+	if(flash_image == MAP_FAILED)
+	{
+		perror("sim: flash image");
+		_exit(1);
+	}
+
+	if(st.st_size < SIM_FLASH_SIZE) memset(&flash_image[st.st_size], 0xFF, SIM_FLASH_SIZE - st.st_size); // New: erased
+}
+
+void sim_flash_sync(void)
+{
+	if(flash_image) msync(flash_image, SIM_FLASH_SIZE, MS_SYNC);
+}
+
+void erase_flash_sector(uint32_t sector_addr)
+{
+	uint16_t erase_id = 0;
+	uint32_t addr = 0;
+
+	if(sector_addr == (sector_addr & FLASH_END_ADDR))
+	{
+		erase_id = IAP_ERAS_SECT;
+		addr = sector_addr;
+	}
+	else if((sector_addr >= DAT0_START_ADDR) && (sector_addr == (sector_addr & DAT0_END_ADDR)))
+	{
+		erase_id = IAP_ERAS_DAT0;
+		addr = 0;
+	}
+	else if((sector_addr >= DAT1_START_ADDR) && (sector_addr == (sector_addr & DAT1_END_ADDR)))
+	{
+		erase_id = IAP_ERAS_DAT1;
+		addr = 0;
+	}
+	else
+	{
+#ifdef _FLASH_DEBUG_
+		printf(" > FLASH:SECTOR_ERASE_FAILED: [0x%.8x]\r\n", sector_addr);
+#endif
+		return;
+	}
+
+	DO_IAP(erase_id, addr, 0, 0);
+}
+
+void erase_flash_block(uint32_t block_addr)
+{
+	if(block_addr != (block_addr & FLASH_END_ADDR))
+	{
+#ifdef _FLASH_DEBUG_
+		printf(" > FLASH:BLOCK_ERASE_FAILED: [0x%.8x]\r\n", block_addr);
+#endif
+		return;
+	}
+
+	DO_IAP(IAP_ERAS_BLCK, block_addr, 0, 0);
+}
+
+uint32_t write_flash(uint32_t addr, uint8_t * data, uint32_t data_len)
+{
+	// Invalid memory address range: Data blocks
+	if((addr >= DAT0_START_ADDR) && (addr == (addr & DAT1_END_ADDR)))
+	{
+		if((data_len > SECT_SIZE) || (DAT0_START_ADDR + data_len > DAT1_END_ADDR)) return 0;
+	}
+
+	// Invalid data_len
+	if((data_len == 0) && (addr + data_len > DAT1_END_ADDR)) return 0;
+
+	// Invalid memory address range: Information block, Do not access
+	if((addr > FLASH_END_ADDR) && (addr < DAT0_START_ADDR)) return 0;
+
+	DO_IAP(IAP_PROG, addr, data, data_len);
+
+	return data_len;
+}
+
+uint32_t read_flash(uint32_t addr, uint8_t *data, uint32_t data_len)
+{
+	uint32_t i;
+
+	for(i = 0; i < data_len; i++)
+	{
+		data[i] = ((addr + i) < SIM_FLASH_SIZE) ? flash_image[addr + i] : 0xFF;
+	}
+
+	return i;
+}
+
+// IAP functions of the W7500 boot ROM
+void DO_IAP( uint32_t id, uint32_t dst_addr, uint8_t* src_addr, uint32_t size)
+{
+	uint32_t i;
+
+	switch(id)
+	{
+		case IAP_ERAS_DAT0:
+			memset(&flash_image[DAT0_START_ADDR], 0xFF, SECT_SIZE);
+			break;
+		case IAP_ERAS_DAT1:
+			memset(&flash_image[DAT1_START_ADDR], 0xFF, SECT_SIZE);
+			break;
+		case IAP_ERAS_SECT:
+			dst_addr &= ~(SECT_SIZE - 1);
+			if(dst_addr <= FLASH_END_ADDR) memset(&flash_image[dst_addr], 0xFF, SECT_SIZE);
+			break;
+		case IAP_ERAS_BLCK:
+			dst_addr &= ~(BLOCK_SIZE - 1);
+			if(dst_addr <= FLASH_END_ADDR) memset(&flash_image[dst_addr], 0xFF, BLOCK_SIZE);
+			break;
+		case IAP_ERAS_CHIP:
+		case IAP_ERAS_MASS:
+			memset(&flash_image[FLASH_START_ADDR], 0xFF, (FLASH_END_ADDR - FLASH_START_ADDR + 1));
+			break;
+		case IAP_PROG:
+			for(i = 0; (i < size) && ((dst_addr + i) < SIM_FLASH_SIZE); i++) flash_image[dst_addr + i] &= src_addr[i];
+			break;
+		default:
+			break;
+	}
+}
@@ -0,0 +1,223 @@
+/*
+ * sim_main.c
+ * W7500x S2E App - Linux host simulation build: entry point, peripheral memory map and the hardware thread
+ *
+ * Usage: s2e_sim [-a bind_addr] [-p port_offset] [-f flash_file] [-u uart_link] [-n]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <arpa/inet.h>
+#include "sim.h"
+
+#define SIM_DEFAULT_FLASH_FILE		"s2e_sim_flash.bin"
+#define SIM_IDLE_NS					100000000ULL	// Hardware thread max. sleep time
+
+// GPIO data registers: the inputs read high (pull-up) - HW_TRIG / BOOT_ENTRY inactive
+#define SIM_GPIO_DATA(port)			(*(volatile uint32_t *)(0x42000000UL + ((port) * 0x01000000UL)))
+
+int s2e_app_main(void); // S2E App main(), main.c is built with -Dmain=s2e_app_main
+
+sim_options_t sim_opt;
+
+static char ** sim_argv;
+static int wake_pipe[2] = {-1, -1};
+
+static void usage(const char * name)
+{
+	printf("Usage: %s [-a bind_addr] [-p port_offset] [-f flash_file] [-u uart_link] [-n] [-r]\r\n", name);
+	printf("  -a  Host address the simulated sockets are bound to (default: 127.0.0.1)\r\n");
+	printf("  -p  Offset added to the local port numbers, e.g. data 5000, config 50001 (default: 0)\r\n");
+	printf("  -f  Flash image file, keeps the device settings (default: %s)\r\n", SIM_DEFAULT_FLASH_FILE);
+	printf("  -u  Symbolic link to the data UART pty\r\n");
+	printf("  -n  No UART pacing: characters are transferred at the host speed, not at the baud rate\r\n");
+	printf("  -r  Log the socket RECV commands to stderr\r\n");
+}
+
+uint64_t sim_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+void sim_wake(void)
+{
+	uint8_t c = 0;
+
+	if(wake_pipe[1] >= 0) (void)!write(wake_pipe[1], &c, 1);
+}
+
+// NVIC_SystemReset(): the process image is replaced; the flash image and the UART pty are kept
+void sim_reboot(void)
+{
+	fflush(stdout);
+	sim_flash_sync();
+	execv("/proc/self/exe", sim_argv);
+	perror("sim: reboot failed");
+	_exit(1);
+}
+
+// Pseudo terminal in raw mode for a simulated UART; the slave is held open, the line stays up without a terminal
+int sim_pty_open(int * slave, char * name, int len)
+{
+	struct termios tio;
+	int master;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0) || (ptsname_r(master, name, len) != 0))
+	{
+		perror("sim: pty");
+		if(master >= 0) syscall(SYS_close, master); // close() is the ioLibrary socket API
+		return -1;
+	}
+
+	*slave = open(name, O_RDWR | O_NOCTTY);
+	if((*slave >= 0) && (tcgetattr(*slave, &tio) == 0))
+	{
+		cfmakeraw(&tio);
+		tcsetattr(*slave, TCSANOW, &tio);
+	}
+	return master;
+}
+
+static void periph_map(void)
+{
+	void * p;
+	int i;
+
+	p = mmap((void *)SIM_PERIPH_BASE, (SIM_PERIPH_END - SIM_PERIPH_BASE), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+	if(p != (void *)SIM_PERIPH_BASE)
+	{
+		fprintf(stderr, "sim: peripheral address range 0x%08lx mapping failed\r\n", SIM_PERIPH_BASE);
+		exit(1);
+	}
+
+	for(i = 0; i < 4; i++) SIM_GPIO_DATA(i) = 0xFFFF;
+}
+
+static void * hw_thread(void * arg)
+{
+	struct pollfd pfd[SIM_POLL_MAX];
+	struct timespec ts;
+	uint64_t now, next, t;
+	uint8_t buf[64];
+	int i, n, uart_base, uart_cnt, wz_base, wz_cnt;
+
+	(void)arg;
+	prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+	uart_cnt = wz_cnt = 0;
+	uart_base = wz_base = 1;
+
+	while(1)
+	{
+		now = sim_time_ns();
+		next = now + SIM_IDLE_NS;
+
+		t = sim_timer_service(now);
+		if(t < next) next = t;
+		t = sim_uart_service(now, &pfd[uart_base], uart_cnt);
+		if(t < next) next = t;
+		t = sim_wztoe_service(now, &pfd[wz_base], wz_cnt);
+		if(t < next) next = t;
+
+		n = 0;
+		pfd[n].fd = wake_pipe[0];
+		pfd[n].events = POLLIN;
+		n++;
+		uart_base = n;
+		uart_cnt = sim_uart_pollfds(&pfd[n]);
+		n += uart_cnt;
+		wz_base = n;
+		wz_cnt = sim_wztoe_pollfds(&pfd[n]);
+		n += wz_cnt;
+		for(i = 0; i < n; i++) pfd[i].revents = 0;
+
+		now = sim_time_ns();
+		t = (next > now) ? (next - now) : 0;
+		ts.tv_sec = t / 1000000000ULL;
+		ts.tv_nsec = t % 1000000000ULL;
+		if(ppoll(pfd, n, &ts, 0) > 0)
+		{
+			if(pfd[0].revents & POLLIN) while(read(wake_pipe[0], buf, sizeof(buf)) == sizeof(buf));
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char * argv[])
+{
+	pthread_t tid;
+	sigset_t block;
+	int opt;
+
+	sim_argv = argv;
+
+	inet_pton(AF_INET, "127.0.0.1", sim_opt.bind_ip);
+	sim_opt.port_offset = 0;
+	sim_opt.uart_pacing = 1;
+	sim_opt.flash_file = SIM_DEFAULT_FLASH_FILE;
+	sim_opt.uart_link = 0;
+	sim_opt.recv_log = 0;
+
+	while((opt = getopt(argc, argv, "a:p:f:u:nrh")) != -1)
+	{
+		switch(opt)
+		{
+			case 'a':
+				if(inet_pton(AF_INET, optarg, sim_opt.bind_ip) != 1) { usage(argv[0]); return 1; }
+				break;
+			case 'p':
+				sim_opt.port_offset = (uint16_t)atoi(optarg);
+				break;
+			case 'f':
+				sim_opt.flash_file = optarg;
+				break;
+			case 'u':
+				sim_opt.uart_link = optarg;
+				break;
+			case 'n':
+				sim_opt.uart_pacing = 0;
+				break;
+			case 'r':
+				sim_opt.recv_log = 1;
+				break;
+			default:
+				usage(argv[0]);
+				return (opt == 'h') ? 0 : 1;
+		}
+	}
+
+	setvbuf(stdout, 0, _IOLBF, 0); // Debug UART (UART2)
+
+	if(pipe2(wake_pipe, O_NONBLOCK | O_CLOEXEC) < 0) { perror("sim: pipe"); return 1; }
+
+	periph_map();
+	sim_flash_init();
+	sim_core_init();
+	sim_uart_init();
+	sim_wztoe_init();
+
+	// Interrupt signals are delivered to the main thread only
+	sigemptyset(&block);
+	sigaddset(&block, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &block, 0);
+	if(pthread_create(&tid, 0, hw_thread, 0) != 0) { perror("sim: pthread_create"); return 1; }
+	pthread_sigmask(SIG_UNBLOCK, &block, 0);
+
+	return s2e_app_main();
+}
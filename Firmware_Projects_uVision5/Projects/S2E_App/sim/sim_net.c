@@ -0,0 +1,205 @@
+/*
+ * sim_net.c
+ * W7500x S2E App - Linux host simulation build: host TCP/UDP sockets for the simulated WZTOE
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "sim.h"
+#include "sim_net.h"
+
+static long net_call(long nr, long a, long b, long c, long d, long e, long f)
+{
+	return syscall(nr, a, b, c, d, e, f);
+}
+
+static void net_addr(struct sockaddr_in * sa, const uint8_t * ip, uint16_t port)
+{
+	memset(sa, 0, sizeof(struct sockaddr_in));
+	sa->sin_family = AF_INET;
+	sa->sin_port = htons(port);
+	memcpy(&sa->sin_addr, ip, 4);
+}
+
+static int net_socket(int type, uint16_t port, int bind_fail_ok)
+{
+	struct sockaddr_in sa;
+	int fd, on = 1;
+
+	fd = (int)net_call(SYS_socket, AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, 0, 0, 0);
+	if(fd < 0) return SIM_NET_ERROR;
+
+	net_call(SYS_setsockopt, fd, SOL_SOCKET, SO_REUSEADDR, (long)&on, sizeof(on), 0);
+	if(type == SOCK_DGRAM)
+	{
+		net_call(SYS_setsockopt, fd, SOL_SOCKET, SO_REUSEPORT, (long)&on, sizeof(on), 0);
+		net_call(SYS_setsockopt, fd, SOL_SOCKET, SO_BROADCAST, (long)&on, sizeof(on), 0);
+	}
+	else
+	{
+		net_call(SYS_setsockopt, fd, IPPROTO_TCP, TCP_NODELAY, (long)&on, sizeof(on), 0);
+	}
+
+	net_addr(&sa, sim_opt.bind_ip, (port != 0) ? sim_net_host_port(port) : 0);
+	if(net_call(SYS_bind, fd, (long)&sa, sizeof(sa), 0, 0, 0) < 0)
+	{
+		if(!bind_fail_ok)
+		{
+			net_call(SYS_close, fd, 0, 0, 0, 0, 0);
+			return SIM_NET_ERROR;
+		}
+	}
+
+	return fd;
+}
+
+static int net_errno(void)
+{
+	if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) || (errno == EINPROGRESS)) return SIM_NET_AGAIN;
+	if((errno == ETIMEDOUT) || (errno == EHOSTUNREACH) || (errno == ENETUNREACH)) return SIM_NET_TIMEOUT;
+	return SIM_NET_ERROR;
+}
+
+uint16_t sim_net_host_port(uint16_t port)
+{
+	uint32_t hport = (uint32_t)port + sim_opt.port_offset;
+
+	if(hport < 1024) hport += 10000; // Privileged ports: DHCP / DNS / Modbus TCP 502 ...
+	return (uint16_t)hport;
+}
+
+int sim_net_tcp_listen(uint16_t port)
+{
+	int fd = net_socket(SOCK_STREAM, port, 0);
+
+	if(fd < 0) return fd;
+	if(net_call(SYS_listen, fd, 1, 0, 0, 0, 0) < 0)
+	{
+		net_call(SYS_close, fd, 0, 0, 0, 0, 0);
+		return SIM_NET_ERROR;
+	}
+	return fd;
+}
+
+int sim_net_tcp_accept(int lfd, uint8_t * ip, uint16_t * port)
+{
+	struct sockaddr_in sa;
+	socklen_t len = sizeof(sa);
+	int fd, on = 1;
+
+	fd = (int)net_call(SYS_accept4, lfd, (long)&sa, (long)&len, SOCK_NONBLOCK | SOCK_CLOEXEC, 0, 0);
+	if(fd < 0) return net_errno();
+
+	net_call(SYS_setsockopt, fd, IPPROTO_TCP, TCP_NODELAY, (long)&on, sizeof(on), 0);
+	memcpy(ip, &sa.sin_addr, 4);
+	*port = ntohs(sa.sin_port);
+	return fd;
+}
+
+// The local port is bound if it is free; the client mode uses a fixed or a random local port
+int sim_net_tcp_connect(uint16_t lport, const uint8_t * ip, uint16_t port)
+{
+	struct sockaddr_in sa;
+	int fd = net_socket(SOCK_STREAM, lport, 1);
+
+	if(fd < 0) return fd;
+
+	net_addr(&sa, ip, port);
+	if((net_call(SYS_connect, fd, (long)&sa, sizeof(sa), 0, 0, 0) < 0) && (errno != EINPROGRESS))
+	{
+		net_call(SYS_close, fd, 0, 0, 0, 0, 0);
+		return SIM_NET_ERROR;
+	}
+	return fd;
+}
+
+int sim_net_connect_result(int fd)
+{
+	struct sockaddr_in sa;
+	socklen_t len = sizeof(sa);
+	int err = 0;
+
+	if(net_call(SYS_getsockopt, fd, SOL_SOCKET, SO_ERROR, (long)&err, (long)&len, 0) < 0) return SIM_NET_ERROR;
+	if(err)
+	{
+		errno = err;
+		return net_errno();
+	}
+
+	len = sizeof(sa);
+	if(net_call(SYS_getpeername, fd, (long)&sa, (long)&len, 0, 0, 0) < 0) return SIM_NET_AGAIN;
+	return 0;
+}
+
+int sim_net_udp_open(uint16_t port)
+{
+	return net_socket(SOCK_DGRAM, port, 0);
+}
+
+int sim_net_send(int fd, const uint8_t * buf, int len)
+{
+	long ret = net_call(SYS_sendto, fd, (long)buf, len, MSG_NOSIGNAL | MSG_DONTWAIT, 0, 0);
+
+	return (ret < 0) ? net_errno() : (int)ret;
+}
+
+int sim_net_recv(int fd, uint8_t * buf, int len)
+{
+	long ret = net_call(SYS_recvfrom, fd, (long)buf, len, MSG_DONTWAIT, 0, 0);
+
+	return (ret < 0) ? net_errno() : (int)ret;
+}
+
+int sim_net_sendto(int fd, const uint8_t * buf, int len, const uint8_t * ip, uint16_t port)
+{
+	static const uint8_t bcast[4] = {255, 255, 255, 255};
+	static const uint8_t lo_bcast[4] = {127, 255, 255, 255};
+	struct sockaddr_in sa;
+	long ret;
+
+	// Limited broadcast from the loopback address: to the loopback network
+	if((sim_opt.bind_ip[0] == 127) && (memcmp(ip, bcast, 4) == 0)) ip = lo_bcast;
+
+	net_addr(&sa, ip, port);
+	ret = net_call(SYS_sendto, fd, (long)buf, len, MSG_NOSIGNAL | MSG_DONTWAIT, (long)&sa, sizeof(sa));
+
+	return (ret < 0) ? net_errno() : (int)ret;
+}
+
+int sim_net_recvfrom(int fd, uint8_t * buf, int len, uint8_t * ip, uint16_t * port)
+{
+	struct sockaddr_in sa;
+	socklen_t salen = sizeof(sa);
+	long ret;
+
+	ret = net_call(SYS_recvfrom, fd, (long)buf, len, MSG_DONTWAIT | MSG_TRUNC, (long)&sa, (long)&salen);
+	if(ret < 0) return net_errno();
+
+	memcpy(ip, &sa.sin_addr, 4);
+	*port = ntohs(sa.sin_port);
+	return (int)ret;
+}
+
+int sim_net_udp_next_len(int fd)
+{
+	uint8_t dummy;
+	long ret = net_call(SYS_recvfrom, fd, (long)&dummy, 1, MSG_DONTWAIT | MSG_PEEK | MSG_TRUNC, 0, 0);
+
+	return (ret < 0) ? net_errno() : (int)ret;
+}
+
+void sim_net_shutdown(int fd)
+{
+	net_call(SYS_shutdown, fd, SHUT_WR, 0, 0, 0, 0);
+}
+
+void sim_net_close(int fd)
+{
+	if(fd >= 0) net_call(SYS_close, fd, 0, 0, 0, 0, 0);
+}
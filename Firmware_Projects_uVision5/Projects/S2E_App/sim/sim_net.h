@@ -0,0 +1,35 @@
+/*
+ * sim_net.h
+ * W7500x S2E App - Linux host simulation build: host TCP/UDP sockets for the simulated WZTOE
+ *
+ * The application defines socket(), connect(), send(), close() ... (ioLibrary socket API), the host socket calls
+ * are made through syscall(). All the sockets are non-blocking.
+ * The local ports are mapped to the host ports: port + sim_opt.port_offset, ports below 1024 are moved up by 10000.
+ */
+
+#ifndef __SIM_NET_H__
+#define __SIM_NET_H__
+
+#include <stdint.h>
+
+#define SIM_NET_AGAIN			(-1)	// Would block / in progress
+#define SIM_NET_ERROR			(-2)	// Connection refused / reset, socket error
+#define SIM_NET_TIMEOUT			(-3)	// Connection attempt timed out / host unreachable
+
+uint16_t sim_net_host_port(uint16_t port);
+
+int sim_net_tcp_listen(uint16_t port);
+int sim_net_tcp_accept(int lfd, uint8_t * ip, uint16_t * port);
+int sim_net_tcp_connect(uint16_t lport, const uint8_t * ip, uint16_t port);
+int sim_net_connect_result(int fd);				// ret: 0 connected / SIM_NET_AGAIN / SIM_NET_ERROR / SIM_NET_TIMEOUT
+int sim_net_udp_open(uint16_t port);
+
+int sim_net_send(int fd, const uint8_t * buf, int len);	// ret: sent / SIM_NET_AGAIN / SIM_NET_ERROR
+int sim_net_recv(int fd, uint8_t * buf, int len);			// ret: received, 0: EOF / SIM_NET_AGAIN / SIM_NET_ERROR
+int sim_net_sendto(int fd, const uint8_t * buf, int len, const uint8_t * ip, uint16_t port);
+int sim_net_recvfrom(int fd, uint8_t * buf, int len, uint8_t * ip, uint16_t * port);
+int sim_net_udp_next_len(int fd);				// ret: length of the next datagram / SIM_NET_AGAIN / SIM_NET_ERROR
+void sim_net_shutdown(int fd);					// TCP FIN
+void sim_net_close(int fd);
+
+#endif /* __SIM_NET_H__ */
@@ -0,0 +1,350 @@
+/*
+ * sim_timer.c
+ * W7500x S2E App - Linux host simulation build: Dual timers (W7500x_dualtimer.c) and SysTick timing
+ *
+ * The counters run from the host monotonic clock at the system clock rate. Timer interrupts missed while the
+ * ISR was not served yet are kept (max. SIM_TIMER_OWED_MAX) and raised again after the interrupt is cleared,
+ * so the millisecond counters of the application do not lose time when the host is busy.
+ */
+
+#include <pthread.h>
+#include "W7500x_dualtimer.h"
+#include "sim.h"
+
+#define SIM_TIMER_NUM			4
+#define SIM_TIMER_OWED_MAX		1000
+#define SIM_TIMER_OWED_NS		20000ULL		// Re-check interval while interrupts are owed
+
+#define TIMER_CTRL(t)			((t)->TimerControl)
+#define TIMER_ENABLED(t)		((TIMER_CTRL(t) >> DUALTIMER_TimerControl_TimerEnable_Pos) & 0x01)
+#define TIMER_PERIODIC(t)		((TIMER_CTRL(t) >> DUALTIMER_TimerControl_TimerMode_Pos) & 0x01)
+#define TIMER_INT_ENABLED(t)	((TIMER_CTRL(t) >> DUALTIMER_TimerControl_IntEnable_Pos) & 0x01)
+#define TIMER_PRESCALE(t)		(1UL << (4 * ((TIMER_CTRL(t) >> DUALTIMER_TimerControl_Pre_Pos) & 0x03)))
+#define TIMER_MASK(t)			((((TIMER_CTRL(t) >> DUALTIMER_TimerControl_Size_Pos) & 0x01)) ? 0xFFFFFFFFUL : 0xFFFFUL)
+#define TIMER_ONESHOT(t)		(TIMER_CTRL(t) & 0x01)
+#define TIMER_RIS(t)			(*(volatile uint32_t *)&((t)->TimerRIS))
+#define TIMER_MIS(t)			(*(volatile uint32_t *)&((t)->TimerMIS))
+
+typedef struct {
+	volatile uint8_t running;
+	volatile uint64_t start_ns;
+	uint32_t irq_cnt;			// Interrupts raised since started
+	volatile uint32_t owed;
+} sim_timer_t;
+
+static DUALTIMER_TypeDef * const timer_reg[SIM_TIMER_NUM] = {DUALTIMER0_0, DUALTIMER0_1, DUALTIMER1_0, DUALTIMER1_1};
+static sim_timer_t timer[SIM_TIMER_NUM];
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t systick_next_ns = 0;
+static uint32_t systick_owed = 0;
+
+static int timer_index(DUALTIMER_TypeDef * DUALTIMERn)
+{
+	int i;
+
+	for(i = 0; i < SIM_TIMER_NUM; i++)
+	{
+		if(timer_reg[i] == DUALTIMERn) return i;
+	}
+	return 0;
+}
+
+static uint64_t ticks_to_ns(uint64_t ticks)
+{
+	uint32_t clk = GetSystemClock();
+
+	if(clk == 0) clk = 1;
+	return (uint64_t)(((unsigned __int128)ticks * 1000000000ULL) / clk);
+}
+
+static uint64_t ns_to_ticks(uint64_t ns)
+{
+	return (uint64_t)(((unsigned __int128)ns * GetSystemClock()) / 1000000000ULL);
+}
+
+// Elapsed counter ticks (after the prescaler) since the timer started
+static uint64_t timer_ticks(DUALTIMER_TypeDef * t, sim_timer_t * s)
+{
+	return (ns_to_ticks(sim_time_ns() - s->start_ns) / TIMER_PRESCALE(t));
+}
+
+// Host time of the n-th (1 ~) interrupt: the counter reaches zero after (load + 1) ticks, then every period
+static uint64_t timer_irq_ns(DUALTIMER_TypeDef * t, sim_timer_t * s, uint32_t n)
+{
+	uint64_t load = (t->TimerLoad & TIMER_MASK(t));
+	uint64_t period = TIMER_PERIODIC(t) ? (load + 1) : ((uint64_t)TIMER_MASK(t) + 1);
+	uint64_t ticks = (load + 1) + ((uint64_t)(n - 1) * period);
+
+	return s->start_ns + ticks_to_ns(ticks * TIMER_PRESCALE(t));
+}
+
+static void timer_update(int i)
+{
+	DUALTIMER_TypeDef * t = timer_reg[i];
+	sim_timer_t * s = &timer[i];
+
+	if(TIMER_ENABLED(t) && !s->running)
+	{
+		s->start_ns = sim_time_ns();
+		s->irq_cnt = 0;
+		s->owed = 0;
+		s->running = 1;
+		sim_wake();
+	}
+	else if(!TIMER_ENABLED(t) && s->running)
+	{
+		s->running = 0;
+	}
+}
+
+static void timer_control(DUALTIMER_TypeDef * DUALTIMERn, uint32_t set, uint32_t clear)
+{
+	uint32_t primask = sim_critical_enter();
+
+	pthread_mutex_lock(&timer_lock);
+	DUALTIMERn->TimerControl = ((DUALTIMERn->TimerControl & ~clear) | set);
+	timer_update(timer_index(DUALTIMERn));
+	pthread_mutex_unlock(&timer_lock);
+	sim_critical_exit(primask);
+}
+
+// Hardware thread: raises the timer and SysTick interrupts that are due; ret: next deadline
+uint64_t sim_timer_service(uint64_t now)
+{
+	DUALTIMER_TypeDef * t;
+	sim_timer_t * s;
+	uint64_t next = (uint64_t)-1;
+	uint64_t due, period;
+	int i;
+
+	pthread_mutex_lock(&timer_lock);
+	for(i = 0; i < SIM_TIMER_NUM; i++)
+	{
+		t = timer_reg[i];
+		s = &timer[i];
+		if(!s->running) continue;
+
+		while((due = timer_irq_ns(t, s, s->irq_cnt + 1)) <= now)
+		{
+			s->irq_cnt++;
+			if(TIMER_RIS(t))
+			{
+				if(s->owed < SIM_TIMER_OWED_MAX) s->owed++;
+			}
+			else
+			{
+				TIMER_RIS(t) = 1;
+			}
+
+			if(TIMER_ONESHOT(t))
+			{
+				t->TimerControl &= ~(DUALTIMER_TimerControl_TimerEnable << DUALTIMER_TimerControl_TimerEnable_Pos);
+				s->running = 0;
+				break;
+			}
+		}
+
+		if(!TIMER_RIS(t) && s->owed)
+		{
+			s->owed--;
+			TIMER_RIS(t) = 1;
+		}
+
+		if(s->running && (due < next)) next = due;
+		if(s->owed && ((now + SIM_TIMER_OWED_NS) < next)) next = now + SIM_TIMER_OWED_NS;
+
+		// Level sensitive: raised until the ISR clears the interrupt
+		if(TIMER_RIS(t) && TIMER_INT_ENABLED(t)) sim_irq_raise((i < 2) ? DUALTIMER0_IRQn : DUALTIMER1_IRQn);
+	}
+	pthread_mutex_unlock(&timer_lock);
+
+	period = sim_systick_period_ns();
+	if(period)
+	{
+		if(systick_next_ns == 0) systick_next_ns = now + period;
+		while(systick_next_ns <= now)
+		{
+			if(sim_irq_pending(SIM_IRQ_SYSTICK))
+			{
+				if(systick_owed < SIM_TIMER_OWED_MAX) systick_owed++;
+			}
+			else
+			{
+				sim_irq_raise(SIM_IRQ_SYSTICK);
+			}
+			systick_next_ns += period;
+		}
+
+		if(systick_owed && !sim_irq_pending(SIM_IRQ_SYSTICK))
+		{
+			systick_owed--;
+			sim_irq_raise(SIM_IRQ_SYSTICK);
+		}
+
+		if(systick_next_ns < next) next = systick_next_ns;
+		if(systick_owed && ((now + SIM_TIMER_OWED_NS) < next)) next = now + SIM_TIMER_OWED_NS;
+	}
+
+	return next;
+}
+
+/* W7500x_dualtimer.c */
+void DUALTIMER_ClockEnable(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	if(DUALTIMERn == DUALTIMER0_0)
+		TIMCLKEN0_0 = DUALTIMER_Clock_Enable;
+	else if(DUALTIMERn == DUALTIMER0_1)
+		TIMCLKEN0_1 = DUALTIMER_Clock_Enable;
+	else if(DUALTIMERn == DUALTIMER1_0)
+		TIMCLKEN1_0 = DUALTIMER_Clock_Enable;
+	else if(DUALTIMERn == DUALTIMER1_1)
+		TIMCLKEN1_1 = DUALTIMER_Clock_Enable;
+}
+
+void DUALTIMER_ClockDisable(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	if(DUALTIMERn == DUALTIMER0_0)
+		TIMCLKEN0_0 = DUALTIMER_Clock_Disable;
+	else if(DUALTIMERn == DUALTIMER0_1)
+		TIMCLKEN0_1 = DUALTIMER_Clock_Disable;
+	else if(DUALTIMERn == DUALTIMER1_0)
+		TIMCLKEN1_0 = DUALTIMER_Clock_Disable;
+	else if(DUALTIMERn == DUALTIMER1_1)
+		TIMCLKEN1_1 = DUALTIMER_Clock_Disable;
+}
+
+void DUALTIMER_DeInit(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	DUALTIMER_Stop(DUALTIMERn);
+	DUALTIMERn->TimerLoad = 0x0;
+	DUALTIMERn->TimerControl = 0x20;
+	DUALTIMERn->TimerBGLoad = 0x0;
+}
+
+void DUALTIMER_Init(DUALTIMER_TypeDef* DUALTIMERn, DUALTIMER_InitTypDef* DUALTIMER_InitStruct)
+{
+	uint32_t tmp = 0;
+
+	DUALTIMER_Stop(DUALTIMERn);
+
+	DUALTIMERn->TimerLoad = DUALTIMER_InitStruct->TimerLoad;
+
+	tmp = DUALTIMERn->TimerControl;
+	tmp |= (DUALTIMER_InitStruct->TimerControl_Mode << DUALTIMER_TimerControl_TimerMode_Pos);
+	tmp |= (DUALTIMER_InitStruct->TimerControl_Pre << DUALTIMER_TimerControl_Pre_Pos);
+	tmp |= (DUALTIMER_InitStruct->TimerControl_Size << DUALTIMER_TimerControl_Size_Pos);
+	tmp |= (DUALTIMER_InitStruct->TimerControl_OneShot << DUALTIMER_TimerControl_OneShot_Pos);
+	//Reset values not used
+	tmp &= 0xEF;
+
+	DUALTIMERn->TimerControl = tmp;
+}
+
+void DUALTIMER_IntConfig(DUALTIMER_TypeDef* DUALTIMERn, FunctionalState state)
+{
+	if(state == ENABLE)
+		timer_control(DUALTIMERn, (DUALTIMER_TimerControl_IntEnable << DUALTIMER_TimerControl_IntEnable_Pos), 0);
+	else
+		timer_control(DUALTIMERn, 0, (DUALTIMER_TimerControl_IntEnable << DUALTIMER_TimerControl_IntEnable_Pos));
+}
+
+void DUALTIMER_IntClear(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	sim_timer_t * s = &timer[timer_index(DUALTIMERn)];
+	uint32_t primask = sim_critical_enter();
+
+	pthread_mutex_lock(&timer_lock);
+	if(s->owed)
+	{
+		s->owed--; // The next owed interrupt is raised right away
+		sim_irq_raise((timer_index(DUALTIMERn) < 2) ? DUALTIMER0_IRQn : DUALTIMER1_IRQn);
+	}
+	else
+	{
+		TIMER_RIS(DUALTIMERn) = 0;
+	}
+	pthread_mutex_unlock(&timer_lock);
+	sim_critical_exit(primask);
+}
+
+ITStatus DUALTIMER_GetIntStatus(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	return (ITStatus)(TIMER_RIS(DUALTIMERn) && TIMER_INT_ENABLED(DUALTIMERn));
+}
+
+FlagStatus DUALTIMER_GetIntEnableStatus(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	return (FlagStatus)TIMER_INT_ENABLED(DUALTIMERn);
+}
+
+void DUALTIMER_Start(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	timer_control(DUALTIMERn, (DUALTIMER_TimerControl_TimerEnable << DUALTIMER_TimerControl_TimerEnable_Pos), 0);
+}
+
+void DUALTIMER_Stop(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	timer_control(DUALTIMERn, 0, (DUALTIMER_TimerControl_TimerEnable << DUALTIMER_TimerControl_TimerEnable_Pos));
+}
+
+uint32_t DUALTIMER_GetTimerLoad(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	return DUALTIMERn->TimerLoad;
+}
+
+// Writing the load register restarts the counter from the new value
+void DUALTIMER_SetTimerLoad(DUALTIMER_TypeDef* DUALTIMERn, uint32_t TimerLoad)
+{
+	uint32_t enable = (DUALTIMERn->TimerControl & (DUALTIMER_TimerControl_TimerEnable << DUALTIMER_TimerControl_TimerEnable_Pos));
+
+	timer_control(DUALTIMERn, 0, (DUALTIMER_TimerControl_TimerEnable << DUALTIMER_TimerControl_TimerEnable_Pos));
+	DUALTIMERn->TimerLoad = TimerLoad;
+	timer_control(DUALTIMERn, enable, 0);
+}
+
+uint32_t DUALTIMER_GetTimerValue(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	sim_timer_t * s = &timer[timer_index(DUALTIMERn)];
+	uint32_t mask = TIMER_MASK(DUALTIMERn);
+	uint64_t load = (DUALTIMERn->TimerLoad & mask);
+	uint64_t ticks;
+
+	if(!s->running) return (uint32_t)load;
+
+	ticks = timer_ticks(DUALTIMERn, s);
+	if(TIMER_PERIODIC(DUALTIMERn))	return (uint32_t)(load - (ticks % (load + 1)));
+	else if(TIMER_ONESHOT(DUALTIMERn))	return (ticks >= load) ? 0 : (uint32_t)(load - ticks);
+	return (uint32_t)((load - ticks) & mask); // Free-running: wraps around to the max. value
+}
+
+uint32_t DUALTIMER_GetTimerControl(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	return DUALTIMERn->TimerControl;
+}
+
+void DUALTIMER_SetTimerControl(DUALTIMER_TypeDef* DUALTIMERn, uint32_t TimerControl)
+{
+	timer_control(DUALTIMERn, TimerControl, 0xFFFFFFFF);
+}
+
+uint32_t DUALTIMER_GetTimerRIS(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	return TIMER_RIS(DUALTIMERn);
+}
+
+uint32_t DUALTIMER_GetTimerMIS(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	return (TIMER_RIS(DUALTIMERn) && TIMER_INT_ENABLED(DUALTIMERn));
+}
+
+uint32_t DUALTIMER_GetTimerBGLoad(DUALTIMER_TypeDef* DUALTIMERn)
+{
+	return DUALTIMERn->TimerBGLoad;
+}
+
+// Background load: not simulated, the counter keeps the load value until the next start
+void DUALTIMER_SetTimerBGLoad(DUALTIMER_TypeDef* DUALTIMERn, uint32_t TimerBGLoad)
+{
+	DUALTIMERn->TimerBGLoad = TimerBGLoad;
+}
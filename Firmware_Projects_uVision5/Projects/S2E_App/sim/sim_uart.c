@@ -0,0 +1,478 @@
+/*
+ * sim_uart.c
+ * W7500x S2E App - Linux host simulation build: UART0/1 (W7500x_uart.c replacement) and S_UART (UART2, debug)
+ *
+ * UART0/1 are connected to a pseudo terminal created at the first UART_Init(); the received characters are paced
+ * at the configured baud rate and frame format (sim_opt.uart_pacing), one character in the receive holding
+ * register at a time (RXI while the register is full). S_UART is the simulator console (stdin / stdout).
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include "W7500x.h"
+#include "W7500x_uart.h"
+#include "sim.h"
+
+#define SIM_UART_NUM			2
+#define SIM_UART_RXQ_SIZE		4096
+#define SIM_UART_RERAISE_NS		1000000ULL	// RXI re-raise interval while the character is left in the register
+
+#define SIM_UART_ENV			"S2E_SIM_UART%d"	// "master,slave" pty file descriptors kept over NVIC_SystemReset()
+
+typedef struct {
+	int master;							// pty master: the simulated serial line
+	int slave;							// pty slave held open, the line stays up while no terminal is attached
+	uint64_t char_ns;					// Character time at the configured baud rate, 0: no pacing
+
+	uint8_t rxq[SIM_UART_RXQ_SIZE];		// Characters received from the pty, not yet in the holding register
+	uint64_t rxq_ns[SIM_UART_RXQ_SIZE];	// Arrival time
+	uint16_t rxq_head;
+	uint16_t rxq_cnt;
+	uint64_t rx_last_ns;				// Release time of the last character into the holding register
+	uint64_t rx_raise_ns;				// Last RXI raised
+	volatile uint8_t rx_full;
+	uint8_t rx_data;
+
+	volatile uint64_t tx_free_ns;		// Transmitter busy until
+} sim_uart_t;
+
+static sim_uart_t sim_uart[SIM_UART_NUM];
+static pthread_mutex_t uart_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int uart_index(UART_TypeDef * UARTx)
+{
+	if(UARTx == UART0) return 0;
+	if(UARTx == UART1) return 1;
+	return -1;
+}
+
+static sim_uart_t * uart_get(UART_TypeDef * UARTx)
+{
+	int idx = uart_index(UARTx);
+
+	if((idx < 0) || (sim_uart[idx].master < 0)) return 0;
+	return &sim_uart[idx];
+}
+
+static void uart_pty_open(int idx)
+{
+	sim_uart_t * u = &sim_uart[idx];
+	char env[24], val[24];
+	char name[64];
+
+	u->master = sim_pty_open(&u->slave, name, sizeof(name));
+	if(u->master < 0) return;
+
+	sprintf(env, SIM_UART_ENV, idx);
+	sprintf(val, "%d,%d", u->master, u->slave);
+	setenv(env, val, 1);
+
+	printf("sim: UART%d is %s\r\n", idx, name);
+	if(sim_opt.uart_link && (idx == 0))
+	{
+		unlink(sim_opt.uart_link);
+		if(symlink(name, sim_opt.uart_link) < 0) perror("sim: UART link");
+		else printf("sim: UART%d linked as %s\r\n", idx, sim_opt.uart_link);
+	}
+}
+
+static uint64_t uart_char_ns(UART_TypeDef * UARTx, uint32_t baud)
+{
+	uint32_t lcr = UARTx->LCR_H;
+	uint32_t bits;
+
+	if(!sim_opt.uart_pacing || (baud == 0)) return 0;
+
+	bits = 1 + (5 + ((lcr >> 5) & 0x03)); // Start + data bits
+	if(lcr & UART_LCR_H_PEN) bits += 1;
+	bits += (lcr & UART_LCR_H_STP2) ? 2 : 1;
+
+	return (((uint64_t)bits * 1000000000ULL) + (baud - 1)) / baud;
+}
+
+// Moves the next due character into the holding register; ret: [1] loaded / [0] none, *next: release time
+static int uart_rx_load(sim_uart_t * u, uint64_t now, uint64_t * next)
+{
+	uint64_t rel;
+
+	if(u->rx_full || (u->rxq_cnt == 0)) return 0;
+
+	rel = u->rxq_ns[u->rxq_head];
+	if(u->char_ns && (rel < (u->rx_last_ns + u->char_ns))) rel = u->rx_last_ns + u->char_ns;
+	if(rel > now)
+	{
+		if(next && (rel < *next)) *next = rel;
+		return 0;
+	}
+
+	u->rx_data = u->rxq[u->rxq_head];
+	u->rxq_head = (u->rxq_head + 1) % SIM_UART_RXQ_SIZE;
+	u->rxq_cnt--;
+	u->rx_last_ns = rel;
+	u->rx_full = 1;
+	return 1;
+}
+
+void sim_uart_init(void)
+{
+	char env[24];
+	const char * val;
+	int i;
+
+	for(i = 0; i < SIM_UART_NUM; i++)
+	{
+		memset(&sim_uart[i], 0, sizeof(sim_uart_t));
+		sim_uart[i].master = sim_uart[i].slave = -1;
+
+		sprintf(env, SIM_UART_ENV, i);
+		if(((val = getenv(env)) != 0) && (sscanf(val, "%d,%d", &sim_uart[i].master, &sim_uart[i].slave) != 2))
+		{
+			sim_uart[i].master = sim_uart[i].slave = -1;
+		}
+		if(sim_uart[i].master >= 0) printf("sim: UART%d is %s\r\n", i, ptsname(sim_uart[i].master));
+	}
+}
+
+int sim_uart_pollfds(struct pollfd * pfd)
+{
+	int i, cnt = 0;
+
+	pthread_mutex_lock(&uart_lock);
+	for(i = 0; i < SIM_UART_NUM; i++)
+	{
+		if(sim_uart[i].master < 0) continue;
+		pfd[cnt].fd = sim_uart[i].master;
+		pfd[cnt].events = (sim_uart[i].rxq_cnt < SIM_UART_RXQ_SIZE) ? POLLIN : 0;
+		cnt++;
+	}
+	pthread_mutex_unlock(&uart_lock);
+
+	return cnt;
+}
+
+uint64_t sim_uart_service(uint64_t now, const struct pollfd * pfd, int cnt)
+{
+	uint8_t buf[256];
+	uint64_t next = (uint64_t)-1;
+	sim_uart_t * u;
+	UART_TypeDef * UARTx;
+	int i, j, k, len, raise;
+
+	for(i = 0; i < SIM_UART_NUM; i++)
+	{
+		u = &sim_uart[i];
+		UARTx = (i == 0) ? UART0 : UART1;
+		raise = 0;
+
+		pthread_mutex_lock(&uart_lock);
+		if(u->master >= 0)
+		{
+			for(j = 0; j < cnt; j++)
+			{
+				if((pfd[j].fd != u->master) || !(pfd[j].revents & POLLIN)) continue;
+
+				len = SIM_UART_RXQ_SIZE - u->rxq_cnt;
+				if(len > (int)sizeof(buf)) len = sizeof(buf);
+				len = read(u->master, buf, len);
+				for(k = 0; k < len; k++)
+				{
+					u->rxq[(u->rxq_head + u->rxq_cnt) % SIM_UART_RXQ_SIZE] = buf[k];
+					u->rxq_ns[(u->rxq_head + u->rxq_cnt) % SIM_UART_RXQ_SIZE] = now;
+					u->rxq_cnt++;
+				}
+			}
+
+			if(uart_rx_load(u, now, &next)) u->rx_raise_ns = 0;
+
+			// RXI is a level interrupt: raised again while the character is left in the register (RTS/CTS flow control)
+			if(u->rx_full && (UARTx->IMSC & UART_IT_FLAG_RXI) && (UARTx->CR & UART_CR_UARTEN))
+			{
+				if((u->rx_raise_ns == 0) || ((now - u->rx_raise_ns) >= SIM_UART_RERAISE_NS))
+				{
+					u->rx_raise_ns = now;
+					raise = 1;
+				}
+				if((u->rx_raise_ns + SIM_UART_RERAISE_NS) < next) next = u->rx_raise_ns + SIM_UART_RERAISE_NS;
+			}
+		}
+		pthread_mutex_unlock(&uart_lock);
+
+		if(raise) sim_irq_raise((i == 0) ? UART0_IRQn : UART1_IRQn);
+	}
+
+	return next;
+}
+
+/* W7500x_uart.c */
+void UART_StructInit(UART_InitTypeDef* UART_InitStruct)
+{
+	/* UART_InitStruct members default value */
+	UART_InitStruct->UART_BaudRate = 115200;
+	UART_InitStruct->UART_WordLength = UART_WordLength_8b ;
+	UART_InitStruct->UART_StopBits = UART_StopBits_1;
+	UART_InitStruct->UART_Parity = UART_Parity_No ;
+	UART_InitStruct->UART_Mode = UART_Mode_Rx | UART_Mode_Tx;
+	UART_InitStruct->UART_HardwareFlowControl = UART_HardwareFlowControl_None ;
+}
+
+void UART_DeInit(UART_TypeDef *UARTx)
+{
+	(void)UARTx;
+}
+
+uint32_t UART_Init(UART_TypeDef *UARTx, UART_InitTypeDef* UART_InitStruct)
+{
+	uint32_t tmpreg, primask;
+	int idx = uart_index(UARTx);
+
+	if(idx < 0) return 1;
+
+	UARTx->CR &= ~(UART_CR_UARTEN);
+
+	tmpreg = UARTx->LCR_H;
+	tmpreg &= ~(0x00EE);
+	tmpreg |= (UART_InitStruct->UART_WordLength | UART_InitStruct->UART_StopBits | UART_InitStruct->UART_Parity);
+	UARTx->LCR_H = tmpreg;
+
+	tmpreg = UARTx->CR;
+	tmpreg &= ~(UART_CR_CTSEn | UART_CR_RTSEn | UART_CR_RXE | UART_CR_TXE | UART_CR_UARTEN);
+	tmpreg |= (UART_InitStruct->UART_Mode | UART_InitStruct->UART_HardwareFlowControl);
+	UARTx->CR = tmpreg;
+
+	primask = sim_critical_enter();
+	pthread_mutex_lock(&uart_lock);
+	if(sim_uart[idx].master < 0) uart_pty_open(idx);
+	sim_uart[idx].char_ns = uart_char_ns(UARTx, UART_InitStruct->UART_BaudRate);
+	pthread_mutex_unlock(&uart_lock);
+	sim_critical_exit(primask);
+
+	UARTx->CR |= UART_CR_UARTEN;
+	sim_wake();
+
+	return 0;
+}
+
+// FIFO mode is not simulated: one character in the receive holding register
+void UART_FIFO_Enable(UART_TypeDef *UARTx, uint16_t rx_fifo_level, uint16_t tx_fifo_level)
+{
+	UARTx->LCR_H |= UART_LCR_H_FEN;
+	UARTx->IFLS = (UART_IFLS_RXIFLSEL(rx_fifo_level) | UART_IFLS_TXIFLSEL(tx_fifo_level));
+}
+
+void UART_FIFO_Disable(UART_TypeDef *UARTx)
+{
+	UARTx->LCR_H &= ~(UART_LCR_H_FEN);
+}
+
+void UART_SendData(UART_TypeDef* UARTx, uint16_t Data)
+{
+	sim_uart_t * u = uart_get(UARTx);
+	uint64_t now;
+	uint8_t ch = (uint8_t)Data;
+
+	if(!u) return;
+
+	now = sim_time_ns();
+	while(now < u->tx_free_ns) now = sim_time_ns(); // Transmit holding register full
+
+	(void)!write(u->master, &ch, 1); // Lost if no terminal reads the line
+	u->tx_free_ns = now + u->char_ns;
+}
+
+uint16_t UART_ReceiveData(UART_TypeDef* UARTx)
+{
+	sim_uart_t * u = uart_get(UARTx);
+	uint32_t primask;
+	uint16_t data;
+	int raise = 0, pending;
+
+	if(!u) return 0;
+
+	primask = sim_critical_enter();
+	pthread_mutex_lock(&uart_lock);
+	data = u->rx_data;
+	u->rx_full = 0;
+	if(uart_rx_load(u, sim_time_ns(), 0))
+	{
+		u->rx_raise_ns = sim_time_ns();
+		raise = ((UARTx->IMSC & UART_IT_FLAG_RXI) != 0);
+	}
+	pending = (u->rxq_cnt != 0);
+	pthread_mutex_unlock(&uart_lock);
+
+	if(raise) sim_irq_raise((u == &sim_uart[0]) ? UART0_IRQn : UART1_IRQn);
+	else if(pending) sim_wake();
+	sim_critical_exit(primask);
+
+	return data;
+}
+
+void UART_SendBreak(UART_TypeDef* UARTx)
+{
+	UARTx->LCR_H |= UART_LCR_H_BRK;
+}
+
+void UART_ClearRecvStatus(UART_TypeDef* UARTx, uint16_t UART_RECV_STATUS)
+{
+	(void)UARTx;
+	(void)UART_RECV_STATUS;
+}
+
+FlagStatus UART_GetRecvStatus(UART_TypeDef* UARTx, uint16_t UART_RECV_STATUS)
+{
+	(void)UARTx;
+	(void)UART_RECV_STATUS;
+	return RESET; // No framing / parity / break / overrun errors on the pty
+}
+
+FlagStatus UART_GetFlagStatus(UART_TypeDef* UARTx, uint16_t UART_FLAG)
+{
+	sim_uart_t * u = uart_get(UARTx);
+	uint32_t fr = (UART_FLAG_CTS | UART_FLAG_DSR | UART_FLAG_DCD); // Modem inputs asserted
+
+	if(u)
+	{
+		if(sim_time_ns() < u->tx_free_ns) fr |= (UART_FLAG_BUSY | UART_FLAG_TXFF);
+		else fr |= UART_FLAG_TXFE;
+		fr |= (u->rx_full ? UART_FLAG_RXFF : UART_FLAG_RXFE);
+	}
+	else
+	{
+		fr |= (UART_FLAG_TXFE | UART_FLAG_RXFE);
+	}
+
+	return ((fr & UART_FLAG) != 0) ? SET : RESET;
+}
+
+// As the driver, the DISABLE case writes the interrupt clear register and does not change the mask
+void UART_ITConfig(UART_TypeDef* UARTx, uint16_t UART_IT, FunctionalState NewState)
+{
+	if ( NewState != DISABLE )
+	{
+		UARTx->IMSC |= UART_IT;
+		sim_wake();
+	}
+	else
+	{
+		UARTx->ICR |= UART_IT;
+	}
+}
+
+ITStatus UART_GetITStatus(UART_TypeDef* UARTx, uint16_t UART_IT)
+{
+	sim_uart_t * u = uart_get(UARTx);
+	uint32_t ris = 0;
+
+	if(u && u->rx_full) ris |= UART_IT_FLAG_RXI;
+
+	return ((ris & UARTx->IMSC & UART_IT) != 0) ? SET : RESET;
+}
+
+void UART_ClearITPendingBit(UART_TypeDef* UARTx, uint16_t UART_IT)
+{
+	(void)UARTx;
+	(void)UART_IT; // RXI follows the receive holding register
+}
+
+uint8_t UartPutc(UART_TypeDef* UARTx, uint8_t ch)
+{
+	UART_SendData(UARTx, ch);
+
+	while(UART_GetFlagStatus(UARTx, UART_FLAG_BUSY) == SET);
+
+	return (ch);
+}
+
+void UartPuts(UART_TypeDef* UARTx, uint8_t *str)
+{
+	while(*str) UartPutc(UARTx, *str++);
+}
+
+uint8_t UartGetc(UART_TypeDef* UARTx)
+{
+	if(!uart_get(UARTx)) return 0;
+	while(UART_GetFlagStatus(UARTx, UART_FLAG_RXFE) == SET) usleep(100);
+
+	return (uint8_t)(UART_ReceiveData(UARTx) & 0xFF);
+}
+
+/* S_UART (UART2): the simulator console */
+void S_UART_DeInit(void)
+{
+}
+
+uint32_t S_UART_Init(uint32_t baud)
+{
+	S_UART_SetBaud(baud);
+	UART2->CTRL |= (S_UART_CTRL_RX_EN | S_UART_CTRL_TX_EN);
+
+	return 0;
+}
+
+void S_UART_SetBaud(uint32_t baud)
+{
+	if(baud) UART2->BAUDDIV = GetSystemClock() / baud;
+}
+
+void S_UART_SetCTRL(uint16_t S_UART_CTRL, FunctionalState NewState)
+{
+	if ( NewState != DISABLE ) UART2->CTRL |= S_UART_CTRL;
+	else UART2->CTRL &= ~(S_UART_CTRL);
+}
+
+void S_UART_SendData(uint16_t Data)
+{
+	putchar((uint8_t)Data);
+}
+
+uint16_t S_UART_ReceiveData(void)
+{
+	int ch = getchar();
+
+	return (ch == EOF) ? 0 : (uint16_t)ch;
+}
+
+uint8_t S_UartPutc(uint8_t ch)
+{
+	S_UART_SendData(ch);
+
+	return (ch);
+}
+
+void S_UartPuts(uint8_t *str)
+{
+	while(*str) S_UART_SendData(*str++);
+}
+
+uint8_t S_UartGetc(void)
+{
+	return (uint8_t)S_UART_ReceiveData();
+}
+
+FlagStatus S_UART_GetFlagStatus(uint16_t S_UART_STATE)
+{
+	(void)S_UART_STATE;
+	return RESET; // TX never full, RX interrupt not simulated
+}
+
+void S_UART_ITConfig(uint16_t S_UART_CTRL, FunctionalState NewState)
+{
+	S_UART_SetCTRL(S_UART_CTRL, NewState);
+}
+
+ITStatus S_UART_GetITStatus(uint16_t S_UART_INTSTATUS)
+{
+	(void)S_UART_INTSTATUS;
+	return RESET;
+}
+
+void S_UART_ClearITPendingBit(uint16_t S_UART_INTSTATUS)
+{
+	(void)S_UART_INTSTATUS;
+}
@@ -0,0 +1,659 @@
+/*
+ * sim_wztoe.c
+ * W7500x S2E App - Linux host simulation build: WZTOE (hardwired TCP/IP core), W7500x_wztoe.c replacement
+ *
+ * The socket registers and the TX/RX buffer memory are host memory at the W7500x addresses; the register bytes
+ * accessed through WIZCHIP_READ / WIZCHIP_WRITE (Sn_CR, Sn_ICR, SIR) run the socket model. TCP and UDP sockets
+ * are host sockets bound to sim_opt.bind_ip; MACRAW / IPRAW sockets are opened but do not send or receive.
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "W7500x.h"
+#include "W7500x_wztoe.h"
+#include "sim.h"
+#include "sim_net.h"
+
+#define SIM_WZ_SOCK_NUM			8
+
+#define SIM_WZ_REG8(addr)		(*(volatile uint8_t *)(uintptr_t)(addr))
+#define SIM_WZ_REG32(addr)		(*(volatile uint32_t *)(uintptr_t)(addr))
+
+#define SIM_WZ_SOCK_BASE		(W7500x_WZTOE_BASE + 0x00010000)
+#define SIM_WZ_SOCK_END			(SIM_WZ_SOCK_BASE + (SIM_WZ_SOCK_NUM << 18))
+#define SIM_WZ_TXMEM(sn)		((uint8_t *)(uintptr_t)(TXMEM_BASE | ((sn) << 18)))
+#define SIM_WZ_RXMEM(sn)		((uint8_t *)(uintptr_t)(RXMEM_BASE | ((sn) << 18)))
+
+#define SIM_WZ_RTR_DEFAULT		2000	// 200ms
+#define SIM_WZ_RTR_MAX			65535
+
+typedef struct {
+	int fd;						// TCP connection / UDP socket
+	int lfd;					// TCP listen socket
+	uint8_t sending;			// SEND command in progress: Sn_TX_RD ~ tx_end
+	uint16_t tx_end;
+	uint8_t discon;				// DISCON command: FIN after the data in progress
+	uint8_t rx_blocked;			// RX buffer full, waiting for the RECV command
+	uint8_t rx_eof;
+	uint64_t deadline_ns;		// CONNECT / DISCON retransmission timeout
+} sim_wz_sock_t;
+
+static sim_wz_sock_t wz_sock[SIM_WZ_SOCK_NUM];
+static pthread_mutex_t wz_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t wz_buf[65536];
+
+static uint16_t sn_txmax(uint8_t sn) { return (uint16_t)(SIM_WZ_REG8(WZTOE_Sn_TXBUF_SIZE(sn)) << 10); }
+static uint16_t sn_rxmax(uint8_t sn) { return (uint16_t)(SIM_WZ_REG8(WZTOE_Sn_RXBUF_SIZE(sn)) << 10); }
+
+static uint8_t sn_sr(uint8_t sn) { return SIM_WZ_REG8(WZTOE_Sn_SR(sn)); }
+static void sn_set_sr(uint8_t sn, uint8_t sr) { SIM_WZ_REG8(WZTOE_Sn_SR(sn)) = sr; }
+
+static uint16_t sn_reg16(uint32_t addr) { return (uint16_t)SIM_WZ_REG32(addr); }
+static void sn_set_reg16(uint32_t addr, uint16_t val) { SIM_WZ_REG32(addr) = val; }
+
+static void sn_dipr(uint8_t sn, uint8_t * ip)
+{
+	ip[0] = SIM_WZ_REG8(WZTOE_Sn_DIPR3(sn));
+	ip[1] = SIM_WZ_REG8(WZTOE_Sn_DIPR2(sn));
+	ip[2] = SIM_WZ_REG8(WZTOE_Sn_DIPR1(sn));
+	ip[3] = SIM_WZ_REG8(WZTOE_Sn_DIPR(sn));
+}
+
+static void sn_set_dipr(uint8_t sn, const uint8_t * ip)
+{
+	SIM_WZ_REG8(WZTOE_Sn_DIPR3(sn)) = ip[0];
+	SIM_WZ_REG8(WZTOE_Sn_DIPR2(sn)) = ip[1];
+	SIM_WZ_REG8(WZTOE_Sn_DIPR1(sn)) = ip[2];
+	SIM_WZ_REG8(WZTOE_Sn_DIPR(sn)) = ip[3];
+}
+
+// Sets the socket interrupt bits; ret: [1] the WZTOE interrupt is to be raised
+static int sn_set_ir(uint8_t sn, uint8_t ir)
+{
+	SIM_WZ_REG8(WZTOE_Sn_ISR(sn)) |= ir;
+
+	return ((ir & SIM_WZ_REG8(WZTOE_Sn_IMR(sn))) && (SIM_WZ_REG8(WZTOE_SIMR) & (1 << sn)));
+}
+
+static void sn_update_fsr(uint8_t sn)
+{
+	uint16_t used = (uint16_t)(sn_reg16(WZTOE_Sn_TX_WR(sn)) - sn_reg16(WZTOE_Sn_TX_RD(sn)));
+
+	sn_set_reg16(WZTOE_Sn_TX_FSR(sn), (used < sn_txmax(sn)) ? (sn_txmax(sn) - used) : 0);
+}
+
+static void sn_update_rsr(uint8_t sn)
+{
+	sn_set_reg16(WZTOE_Sn_RX_RSR(sn), (uint16_t)(sn_reg16(WZTOE_Sn_RX_WR(sn)) - sn_reg16(WZTOE_Sn_RX_RD(sn))));
+}
+
+static uint16_t sn_rx_free(uint8_t sn)
+{
+	uint16_t used = (uint16_t)(sn_reg16(WZTOE_Sn_RX_WR(sn)) - sn_reg16(WZTOE_Sn_RX_RD(sn)));
+
+	return (used < sn_rxmax(sn)) ? (sn_rxmax(sn) - used) : 0;
+}
+
+static void sn_rx_write(uint8_t sn, const uint8_t * buf, uint16_t len)
+{
+	uint16_t ptr = sn_reg16(WZTOE_Sn_RX_WR(sn));
+	uint8_t * mem = SIM_WZ_RXMEM(sn);
+	uint16_t i;
+
+	for(i = 0; i < len; i++) mem[(uint16_t)(ptr + i)] = buf[i];
+	sn_set_reg16(WZTOE_Sn_RX_WR(sn), (uint16_t)(ptr + len));
+	sn_update_rsr(sn);
+}
+
+// Retransmission timeout: RTR doubled at each retry up to 6.5535s, RCR retries
+static uint64_t wz_timeout_ns(void)
+{
+	uint32_t rtr = (uint16_t)SIM_WZ_REG32(WZTOE_RTR);
+	uint32_t rcr = SIM_WZ_REG8(WZTOE_RCR);
+	uint64_t total = 0;
+	uint32_t i;
+
+	if(rtr == 0) rtr = SIM_WZ_RTR_DEFAULT;
+	for(i = 0; i <= rcr; i++)
+	{
+		total += rtr;
+		rtr = ((rtr << 1) > SIM_WZ_RTR_MAX) ? SIM_WZ_RTR_MAX : (rtr << 1);
+	}
+
+	return total * 100000ULL; // 100us unit
+}
+
+static void sn_release(uint8_t sn)
+{
+	sim_wz_sock_t * s = &wz_sock[sn];
+
+	sim_net_close(s->fd);
+	sim_net_close(s->lfd);
+	s->fd = s->lfd = -1;
+	s->sending = s->discon = s->rx_blocked = s->rx_eof = 0;
+	s->deadline_ns = 0;
+}
+
+static int sn_closed(uint8_t sn, uint8_t ir)
+{
+	sn_release(sn);
+	sn_set_sr(sn, SOCK_CLOSED);
+	return (ir ? sn_set_ir(sn, ir) : 0);
+}
+
+// TCP: sends Sn_TX_RD ~ tx_end; ret: [1] raise
+static int sn_tcp_flush(uint8_t sn)
+{
+	sim_wz_sock_t * s = &wz_sock[sn];
+	uint16_t rd, len;
+	int sent, ret = 0;
+
+	while(s->sending)
+	{
+		rd = sn_reg16(WZTOE_Sn_TX_RD(sn));
+		if(rd == s->tx_end)
+		{
+			s->sending = 0;
+			ret = sn_set_ir(sn, Sn_IR_SENDOK);
+			break;
+		}
+
+		len = (uint16_t)(s->tx_end - rd);
+		if(len > (0x10000 - rd)) len = (uint16_t)(0x10000 - rd); // Up to the end of the 64kB buffer window
+
+		sent = sim_net_send(s->fd, &SIM_WZ_TXMEM(sn)[rd], len);
+		if(sent == SIM_NET_AGAIN) break;
+		if(sent < 0) return sn_closed(sn, Sn_IR_DISCON); // Reset by the peer
+
+		sn_set_reg16(WZTOE_Sn_TX_RD(sn), (uint16_t)(rd + sent));
+	}
+	sn_update_fsr(sn);
+
+	if(!s->sending && s->discon && (sn_sr(sn) == SOCK_FIN_WAIT))
+	{
+		s->discon = 0;
+		sim_net_shutdown(s->fd);
+		s->deadline_ns = sim_time_ns() + wz_timeout_ns();
+	}
+	return ret;
+}
+
+static int sn_udp_send(uint8_t sn)
+{
+	sim_wz_sock_t * s = &wz_sock[sn];
+	uint16_t rd = sn_reg16(WZTOE_Sn_TX_RD(sn));
+	uint16_t wr = sn_reg16(WZTOE_Sn_TX_WR(sn));
+	uint16_t len = (uint16_t)(wr - rd), i;
+	uint8_t ip[4];
+	int ret = 0;
+
+	for(i = 0; i < len; i++) wz_buf[i] = SIM_WZ_TXMEM(sn)[(uint16_t)(rd + i)];
+
+	sn_dipr(sn, ip);
+	if(s->fd >= 0) ret = sim_net_sendto(s->fd, wz_buf, len, ip, (uint16_t)SIM_WZ_REG32(WZTOE_Sn_DPORT(sn)));
+
+	sn_set_reg16(WZTOE_Sn_TX_RD(sn), wr);
+	sn_update_fsr(sn);
+
+	if(ret == SIM_NET_TIMEOUT) return sn_set_ir(sn, Sn_IR_TIMEOUT); // Destination unreachable (ARP timeout)
+	return sn_set_ir(sn, Sn_IR_SENDOK);
+}
+
+// Socket command; ret: [1] raise
+static int sn_command(uint8_t sn, uint8_t cr)
+{
+	sim_wz_sock_t * s = &wz_sock[sn];
+	uint8_t sr = sn_sr(sn);
+	uint8_t ip[4];
+	int ret = 0;
+
+	switch(cr)
+	{
+		case Sn_CR_OPEN:
+			sn_release(sn);
+			sn_set_reg16(WZTOE_Sn_TX_RD(sn), 0);
+			sn_set_reg16(WZTOE_Sn_TX_WR(sn), 0);
+			sn_set_reg16(WZTOE_Sn_RX_RD(sn), 0);
+			sn_set_reg16(WZTOE_Sn_RX_WR(sn), 0);
+			sn_update_fsr(sn);
+			sn_update_rsr(sn);
+			SIM_WZ_REG8(WZTOE_Sn_ISR(sn)) = 0;
+
+			switch(SIM_WZ_REG8(WZTOE_Sn_MR(sn)) & 0x0F)
+			{
+				case Sn_MR_TCP:
+					sn_set_sr(sn, SOCK_INIT);
+					break;
+				case Sn_MR_UDP:
+					s->fd = sim_net_udp_open((uint16_t)SIM_WZ_REG32(WZTOE_Sn_PORT(sn)));
+					if(s->fd < 0) printf("sim: socket %d, UDP port %d bind failed\r\n", sn, (uint16_t)SIM_WZ_REG32(WZTOE_Sn_PORT(sn)));
+					sn_set_sr(sn, SOCK_UDP);
+					break;
+				case Sn_MR_MACRAW:
+					sn_set_sr(sn, SOCK_MACRAW);
+					break;
+				case Sn_MR_IPRAW:
+					sn_set_sr(sn, SOCK_IPRAW);
+					break;
+				default:
+					sn_set_sr(sn, SOCK_CLOSED);
+					break;
+			}
+			break;
+
+		case Sn_CR_LISTEN:
+			if(sr != SOCK_INIT) break;
+			s->lfd = sim_net_tcp_listen((uint16_t)SIM_WZ_REG32(WZTOE_Sn_PORT(sn)));
+			if(s->lfd < 0)
+			{
+				printf("sim: socket %d, TCP port %d listen failed\r\n", sn, (uint16_t)SIM_WZ_REG32(WZTOE_Sn_PORT(sn)));
+				sn_closed(sn, 0);
+			}
+			else
+			{
+				sn_set_sr(sn, SOCK_LISTEN);
+			}
+			break;
+
+		case Sn_CR_CONNECT:
+			if(sr != SOCK_INIT) break;
+			sn_dipr(sn, ip);
+			s->fd = sim_net_tcp_connect((uint16_t)SIM_WZ_REG32(WZTOE_Sn_PORT(sn)), ip, (uint16_t)SIM_WZ_REG32(WZTOE_Sn_DPORT(sn)));
+			if(s->fd < 0)
+			{
+				ret = sn_closed(sn, Sn_IR_TIMEOUT);
+			}
+			else
+			{
+				s->deadline_ns = sim_time_ns() + wz_timeout_ns();
+				sn_set_sr(sn, SOCK_SYNSENT);
+			}
+			break;
+
+		case Sn_CR_DISCON:
+			if(sr == SOCK_ESTABLISHED)
+			{
+				sn_set_sr(sn, SOCK_FIN_WAIT);
+				s->discon = 1;
+				ret = sn_tcp_flush(sn); // FIN after the data in progress
+			}
+			else if(sr == SOCK_CLOSE_WAIT)
+			{
+				ret = sn_closed(sn, Sn_IR_DISCON);
+			}
+			else if((sr == SOCK_SYNSENT) || (sr == SOCK_LISTEN))
+			{
+				sn_closed(sn, 0);
+			}
+			break;
+
+		case Sn_CR_CLOSE:
+			sn_closed(sn, 0);
+			break;
+
+		case Sn_CR_SEND:
+		case Sn_CR_SEND_MAC:
+			if((sr == SOCK_ESTABLISHED) || (sr == SOCK_CLOSE_WAIT))
+			{
+				s->tx_end = sn_reg16(WZTOE_Sn_TX_WR(sn));
+				s->sending = 1;
+				ret = sn_tcp_flush(sn);
+			}
+			else if(sr == SOCK_UDP)
+			{
+				ret = sn_udp_send(sn);
+			}
+			else if((sr == SOCK_MACRAW) || (sr == SOCK_IPRAW))
+			{
+				sn_set_reg16(WZTOE_Sn_TX_RD(sn), sn_reg16(WZTOE_Sn_TX_WR(sn))); // Dropped
+				sn_update_fsr(sn);
+				ret = sn_set_ir(sn, Sn_IR_SENDOK);
+			}
+			break;
+
+		case Sn_CR_SEND_KEEP: // The host TCP keeps the connection
+			break;
+
+		case Sn_CR_RECV:
+			sn_update_rsr(sn);
+			s->rx_blocked = 0;
+			if(sim_opt.recv_log) fprintf(stderr, "sim: socket %d RECV, %u bytes left\r\n", sn, sn_reg16(WZTOE_Sn_RX_RSR(sn)));
+			break;
+
+		default:
+			break;
+	}
+
+	sim_wake();
+	return ret;
+}
+
+/* W7500x_wztoe.c */
+uint8_t WIZCHIP_READ(uint32_t Addr)
+{
+	uint8_t ret;
+	int i;
+
+	if(Addr == WZTOE_SIR)
+	{
+		for(i = 0, ret = 0; i < SIM_WZ_SOCK_NUM; i++)
+		{
+			if(SIM_WZ_REG8(WZTOE_Sn_ISR(i)) & SIM_WZ_REG8(WZTOE_Sn_IMR(i))) ret |= (1 << i);
+		}
+		return ret;
+	}
+
+	return SIM_WZ_REG8(Addr);
+}
+
+void WIZCHIP_WRITE(uint32_t Addr, uint8_t Data)
+{
+	uint32_t primask, off;
+	uint8_t sn;
+	int raise = 0;
+
+	if((Addr < SIM_WZ_SOCK_BASE) || (Addr >= SIM_WZ_SOCK_END))
+	{
+		if(Addr == WZTOE_ICR) SIM_WZ_REG8(WZTOE_IR) &= ~Data;
+		else SIM_WZ_REG8(Addr) = Data;
+		return;
+	}
+
+	sn = (uint8_t)((Addr - SIM_WZ_SOCK_BASE) >> 18);
+	off = Addr - WZTOE_Sn_MR(sn);
+
+	primask = sim_critical_enter();
+	pthread_mutex_lock(&wz_lock);
+	if(off == (WZTOE_Sn_CR(0) - WZTOE_Sn_MR(0)))
+	{
+		raise = sn_command(sn, Data);
+		SIM_WZ_REG8(Addr) = 0; // Command accepted
+	}
+	else if(off == (WZTOE_Sn_ICR(0) - WZTOE_Sn_MR(0)))
+	{
+		SIM_WZ_REG8(WZTOE_Sn_ISR(sn)) &= ~Data;
+	}
+	else
+	{
+		SIM_WZ_REG8(Addr) = Data;
+	}
+	pthread_mutex_unlock(&wz_lock);
+
+	if(raise) sim_irq_raise(WZTOE_IRQn);
+	sim_critical_exit(primask);
+}
+
+void WIZCHIP_READ_BUF (uint32_t BaseAddr, uint32_t ptr, uint8_t* pBuf, uint16_t len)
+{
+	uint16_t i = 0;
+
+	for(i = 0; i < len; i++)
+		pBuf[i] = SIM_WZ_REG8(BaseAddr + ((ptr + i) & 0xFFFF));
+}
+
+void WIZCHIP_WRITE_BUF(uint32_t BaseAddr, uint32_t ptr, uint8_t* pBuf, uint16_t len)
+{
+	uint16_t i = 0;
+
+	for(i = 0; i < len; i++)
+		SIM_WZ_REG8(BaseAddr + ((ptr + i) & 0xFFFF)) = pBuf[i];
+}
+
+void wiz_send_data(uint8_t sn, uint8_t *wizdata, uint16_t len)
+{
+	uint32_t ptr = 0;
+	uint32_t sn_tx_base = 0;
+
+	if(len == 0)  return;
+	ptr = getSn_TX_WR(sn);
+	sn_tx_base = (TXMEM_BASE) | ((sn&0x7)<<18);
+	WIZCHIP_WRITE_BUF(sn_tx_base, ptr, wizdata, len);
+	ptr += len;
+	setSn_TX_WR(sn,ptr);
+}
+
+void wiz_recv_data(uint8_t sn, uint8_t *wizdata, uint16_t len)
+{
+	uint32_t ptr = 0;
+	uint32_t sn_rx_base = 0;
+
+	if(len == 0) return;
+	ptr = getSn_RX_RD(sn);
+	sn_rx_base = (RXMEM_BASE) | ((sn&0x7)<<18);
+	WIZCHIP_READ_BUF(sn_rx_base, ptr, wizdata, len);
+	ptr += len;
+	setSn_RX_RD(sn,ptr);
+}
+
+void wiz_recv_ignore(uint8_t sn, uint16_t len)
+{
+	uint32_t ptr = 0;
+
+	if(len == 0) return;
+	ptr = getSn_RX_RD(sn);
+	setSn_RX_RD(sn, (uint16_t)(ptr + len));
+}
+
+void wiz_recv_peek(uint8_t sn, uint16_t offset, uint8_t *wizdata, uint16_t len)
+{
+	uint32_t ptr = 0;
+	uint32_t sn_rx_base = 0;
+
+	if(len == 0) return;
+	ptr = getSn_RX_RD(sn) + offset;
+	sn_rx_base = (RXMEM_BASE) | ((sn&0x7)<<18);
+	WIZCHIP_READ_BUF(sn_rx_base, ptr, wizdata, len);
+}
+
+/* Hardware thread */
+void sim_wztoe_init(void)
+{
+	int i;
+
+	for(i = 0; i < SIM_WZ_SOCK_NUM; i++)
+	{
+		memset(&wz_sock[i], 0, sizeof(sim_wz_sock_t));
+		wz_sock[i].fd = wz_sock[i].lfd = -1;
+		sn_set_sr(i, SOCK_CLOSED);
+	}
+}
+
+int sim_wztoe_pollfds(struct pollfd * pfd)
+{
+	sim_wz_sock_t * s;
+	int i, cnt = 0;
+
+	pthread_mutex_lock(&wz_lock);
+	for(i = 0; i < SIM_WZ_SOCK_NUM; i++)
+	{
+		s = &wz_sock[i];
+		switch(sn_sr(i))
+		{
+			case SOCK_LISTEN:
+				pfd[cnt].fd = s->lfd;
+				pfd[cnt].events = POLLIN;
+				cnt++;
+				break;
+			case SOCK_SYNSENT:
+				pfd[cnt].fd = s->fd;
+				pfd[cnt].events = POLLOUT;
+				cnt++;
+				break;
+			case SOCK_ESTABLISHED:
+			case SOCK_CLOSE_WAIT:
+			case SOCK_FIN_WAIT:
+				pfd[cnt].fd = s->fd;
+				pfd[cnt].events = (s->sending ? POLLOUT : 0) | ((!s->rx_eof && !s->rx_blocked) ? POLLIN : 0);
+				if(pfd[cnt].events) cnt++;
+				break;
+			case SOCK_UDP:
+				if((s->fd < 0) || s->rx_blocked) break;
+				pfd[cnt].fd = s->fd;
+				pfd[cnt].events = POLLIN;
+				cnt++;
+				break;
+			default:
+				break;
+		}
+	}
+	pthread_mutex_unlock(&wz_lock);
+
+	return cnt;
+}
+
+static short wz_revents(int fd, const struct pollfd * pfd, int cnt)
+{
+	int i;
+
+	if(fd < 0) return 0;
+	for(i = 0; i < cnt; i++)
+	{
+		if(pfd[i].fd == fd) return pfd[i].revents;
+	}
+	return 0;
+}
+
+static int sn_tcp_recv(uint8_t sn)
+{
+	sim_wz_sock_t * s = &wz_sock[sn];
+	uint16_t len = sn_rx_free(sn);
+	int ret;
+
+	if(len == 0)
+	{
+		s->rx_blocked = 1;
+		return 0;
+	}
+	if(len > sizeof(wz_buf)) len = sizeof(wz_buf);
+
+	ret = sim_net_recv(s->fd, wz_buf, len);
+	if(ret > 0)
+	{
+		sn_rx_write(sn, wz_buf, (uint16_t)ret);
+		return sn_set_ir(sn, Sn_IR_RECV);
+	}
+	if(ret == SIM_NET_AGAIN) return 0;
+	if((ret == 0) && (sn_sr(sn) != SOCK_FIN_WAIT))
+	{
+		s->rx_eof = 1; // FIN received
+		sn_set_sr(sn, SOCK_CLOSE_WAIT);
+		return sn_set_ir(sn, Sn_IR_DISCON);
+	}
+	return sn_closed(sn, Sn_IR_DISCON); // FIN_WAIT done / reset
+}
+
+static int sn_udp_recv(uint8_t sn)
+{
+	sim_wz_sock_t * s = &wz_sock[sn];
+	uint8_t head[8];
+	uint16_t port;
+	int len, ret = 0;
+
+	while((len = sim_net_udp_next_len(s->fd)) != SIM_NET_AGAIN)
+	{
+		if((len >= 0) && ((len + 8) <= sn_rxmax(sn)) && ((len + 8) > sn_rx_free(sn)))
+		{
+			s->rx_blocked = 1;
+			break;
+		}
+
+		len = sim_net_recvfrom(s->fd, wz_buf, sizeof(wz_buf), head, &port);
+		if((len < 0) || ((len + 8) > sn_rxmax(sn))) continue; // Socket error / larger than the buffer: dropped
+
+		head[4] = (uint8_t)(port >> 8);
+		head[5] = (uint8_t)(port & 0xFF);
+		head[6] = (uint8_t)(len >> 8);
+		head[7] = (uint8_t)(len & 0xFF);
+		sn_rx_write(sn, head, 8);
+		sn_rx_write(sn, wz_buf, (uint16_t)len);
+		ret |= sn_set_ir(sn, Sn_IR_RECV);
+	}
+	return ret;
+}
+
+uint64_t sim_wztoe_service(uint64_t now, const struct pollfd * pfd, int cnt)
+{
+	sim_wz_sock_t * s;
+	uint64_t next = (uint64_t)-1;
+	uint8_t ip[4];
+	uint16_t port;
+	short ev;
+	int i, fd, raise = 0;
+
+	pthread_mutex_lock(&wz_lock);
+	for(i = 0; i < SIM_WZ_SOCK_NUM; i++)
+	{
+		s = &wz_sock[i];
+		switch(sn_sr(i))
+		{
+			case SOCK_LISTEN:
+				if(!(wz_revents(s->lfd, pfd, cnt) & POLLIN)) break;
+				fd = sim_net_tcp_accept(s->lfd, ip, &port);
+				if(fd < 0) break;
+
+				sim_net_close(s->lfd); // One connection per socket: the next ones are refused
+				s->lfd = -1;
+				s->fd = fd;
+				sn_set_dipr(i, ip);
+				SIM_WZ_REG32(WZTOE_Sn_DPORT(i)) = port;
+				sn_set_sr(i, SOCK_ESTABLISHED);
+				raise |= sn_set_ir(i, Sn_IR_CON);
+				break;
+
+			case SOCK_SYNSENT:
+				if(wz_revents(s->fd, pfd, cnt))
+				{
+					switch(sim_net_connect_result(s->fd))
+					{
+						case 0:
+							s->deadline_ns = 0;
+							sn_set_sr(i, SOCK_ESTABLISHED);
+							raise |= sn_set_ir(i, Sn_IR_CON);
+							break;
+						case SIM_NET_AGAIN:
+							break;
+						case SIM_NET_TIMEOUT:
+							raise |= sn_closed(i, Sn_IR_TIMEOUT);
+							break;
+						default:
+							raise |= sn_closed(i, Sn_IR_DISCON); // Refused
+							break;
+					}
+				}
+				if((sn_sr(i) == SOCK_SYNSENT) && (now >= s->deadline_ns)) raise |= sn_closed(i, Sn_IR_TIMEOUT);
+				break;
+
+			case SOCK_ESTABLISHED:
+			case SOCK_CLOSE_WAIT:
+			case SOCK_FIN_WAIT:
+				ev = wz_revents(s->fd, pfd, cnt);
+				if(s->sending && (ev & (POLLOUT | POLLERR | POLLHUP))) raise |= sn_tcp_flush(i);
+				if((s->fd >= 0) && !s->rx_eof && (s->rx_blocked ? (sn_rx_free(i) != 0) : (ev & (POLLIN | POLLERR | POLLHUP))))
+				{
+					s->rx_blocked = 0;
+					raise |= sn_tcp_recv(i);
+				}
+				if((sn_sr(i) == SOCK_FIN_WAIT) && s->deadline_ns && (now >= s->deadline_ns)) raise |= sn_closed(i, Sn_IR_TIMEOUT);
+				break;
+
+			case SOCK_UDP:
+				if((s->fd >= 0) && (s->rx_blocked || (wz_revents(s->fd, pfd, cnt) & POLLIN)))
+				{
+					s->rx_blocked = 0;
+					raise |= sn_udp_recv(i);
+				}
+				break;
+
+			default:
+				break;
+		}
+
+		if(s->deadline_ns && (s->deadline_ns < next)) next = s->deadline_ns;
+	}
+	pthread_mutex_unlock(&wz_lock);
+
+	if(raise) sim_irq_raise(WZTOE_IRQn);
+
+	return next;
+}
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+#
+# W7500x S2E App - Linux host simulation: UDP_MODE datagram drain test
+#
+# A burst of datagrams is sent to the data socket faster than the UART drains it, so several datagrams are queued in the
+# socket Rx buffer and drained in one pass (recv_udp_datagrams). One of them is larger than the user's buffer (DATA_BUF_SIZE)
+# and is split across the passes. The UART output must be the payloads in order, with no byte lost or inserted.
+#
+# Drain time: bursts of small datagrams are sent back to back; the time from the first datagram to the last byte at the UART
+# and the drain passes (socket RECV commands, sim -r) are measured. With the reference build (one datagram per pass,
+# SEG_UDP_DRAIN_BUDGET 1) the same bursts are measured for comparison. A pass must not take more than
+# SEG_UDP_DRAIN_BUDGET datagrams, and the drain must take fewer passes than the reference.
+#
+#   python3 test_udp_drain.py [path to s2e_sim] [path to the reference s2e_sim]       (make test)
+#
+# The simulation runs on a new flash image (factory settings); UDP_MODE is set by the serial AT commands.
+
+import os
+import re
+import select
+import shutil
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+import tty
+
+PORT_OFFSET = 23000
+LOCAL_PORT = 5000			# Factory setting
+DATA_BUF_SIZE = 2048
+SEG_UDP_DRAIN_BUDGET = 16	# seg.h
+DRAIN_DATAGRAMS = 64		# Drain time: datagrams per burst
+DRAIN_SIZE = 16				# bytes
+DRAIN_BURSTS = 20
+
+
+def uart_read(fd, timeout, until=None):
+    out = b''
+    end = time.time() + timeout
+    while time.time() < end:
+        r, _, _ = select.select([fd], [], [], 0.05)
+        if r:
+            out += os.read(fd, 4096)
+            if until is not None and until(out):
+                break
+    return out
+
+
+def at_command(fd, cmd):
+    os.write(fd, cmd + b'\r\n')
+    return uart_read(fd, 0.5)
+
+
+class Sim:
+    """s2e_sim on a new flash image, set to UDP_MODE"""
+
+    def __init__(self, path, port_offset):
+        self.tmp = tempfile.mkdtemp(prefix='s2e_sim_')
+        self.port = LOCAL_PORT + port_offset
+        link = os.path.join(self.tmp, 'uart')
+        self.proc = subprocess.Popen([path, '-p', str(port_offset), '-f', os.path.join(self.tmp, 'flash.bin'), '-u', link, '-n', '-r'],
+                                     stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        self.fd = -1
+        os.set_blocking(self.proc.stderr.fileno(), False)
+        for _ in range(50):
+            if os.path.exists(link):
+                break
+            time.sleep(0.1)
+        self.fd = os.open(link, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        time.sleep(1.5)
+
+        # Serial command mode: '+++' with the guard time, UDP_MODE, back to the gateway mode
+        uart_read(self.fd, 0.2)
+        os.write(self.fd, b'+++')
+        if b'AT Mode' not in uart_read(self.fd, 1.5, lambda o: b'AT Mode' in o):
+            raise RuntimeError('AT mode not entered')
+        at_command(self.fd, b'OP3')
+        os.write(self.fd, b'EX\r\n')
+        if b'GW Mode' not in uart_read(self.fd, 2.0, lambda o: b'GW Mode' in o):
+            raise RuntimeError('AT mode not exited')
+        uart_read(self.fd, 1.0)		# Data socket opened in UDP_MODE
+        self.recv_passes()
+
+    def recv_passes(self):
+        """Data socket RECV commands logged since the last call"""
+        log = b''
+        while True:
+            try:
+                data = os.read(self.proc.stderr.fileno(), 65536)
+            except BlockingIOError:
+                break
+            if not data:
+                break
+            log += data
+        return len(re.findall(rb'socket 0 RECV', log))
+
+    def close(self):
+        if self.fd >= 0:
+            os.close(self.fd)
+        self.proc.terminate()
+        self.proc.wait()
+        shutil.rmtree(self.tmp, ignore_errors=True)
+
+
+def check_stream(sim):
+    """Datagrams of various sizes and one larger than the user's buffer: the UART output must be the payloads in order"""
+    sizes = [1, 7, 64, 300, 1000, 1472, 3, DATA_BUF_SIZE + 952, 512, 1, 1200, 90] * 3
+    payloads = []
+    for i, size in enumerate(sizes):
+        p = bytearray((i * 31 + j) & 0xFF for j in range(size))
+        if size > DATA_BUF_SIZE:
+            # The rest of the datagram starts with a valid-looking header ([IP][Port][Length 16]): must not be parsed as one
+            p[DATA_BUF_SIZE:DATA_BUF_SIZE + 8] = b'\x7f\x00\x00\x01\x13\x88\x00\x10'
+        payloads.append(bytes(p))
+    expected = b''.join(payloads)
+
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    dest = ('127.0.0.1', sim.port)
+    got = b''
+    for p in payloads:
+        s.sendto(p, dest)
+        got += uart_read(sim.fd, 0.002)
+    got += uart_read(sim.fd, 5.0, lambda o: len(got) + len(o) >= len(expected))
+    s.close()
+
+    if got != expected:
+        for i in range(min(len(got), len(expected))):
+            if got[i] != expected[i]:
+                break
+        else:
+            i = min(len(got), len(expected))
+        print('FAIL: %d of %d bytes received, first difference at %d' % (len(got), len(expected), i))
+        return False
+
+    print('PASS: %d datagrams, %d bytes' % (len(payloads), len(expected)))
+    return True
+
+
+def measure_drain(sim):
+    """Bursts of small datagrams: median drain time (usec), datagrams and passes in total; None if a byte is missing"""
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    dest = ('127.0.0.1', sim.port)
+    payloads = [bytes([(i * 7 + j) & 0xFF for j in range(DRAIN_SIZE)]) for i in range(DRAIN_DATAGRAMS)]
+    expected = b''.join(payloads)
+    times = []
+    passes = 0
+
+    uart_read(sim.fd, 0.1)
+    sim.recv_passes()
+    for _ in range(DRAIN_BURSTS):
+        start = time.perf_counter()
+        for p in payloads:
+            s.sendto(p, dest)
+        got = uart_read(sim.fd, 2.0, lambda o: len(o) >= len(expected))
+        times.append((time.perf_counter() - start) * 1e6)
+        if got != expected:
+            s.close()
+            return None
+        time.sleep(0.02)
+        passes += sim.recv_passes()
+    s.close()
+    return statistics.median(times), DRAIN_DATAGRAMS * DRAIN_BURSTS, passes
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    paths = [sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, 'build', 's2e_sim'),
+             sys.argv[2] if len(sys.argv) > 2 else os.path.join(here, 'build', 's2e_sim_drain1')]
+    results = []
+
+    for i, path in enumerate(paths):
+        sim = Sim(path, PORT_OFFSET + i * 100)
+        try:
+            if i == 0 and not check_stream(sim):
+                return 1
+            result = measure_drain(sim)
+        finally:
+            sim.close()
+        if result is None:
+            print('FAIL: %s: drain burst not received whole' % os.path.basename(path))
+            return 1
+        results.append(result)
+        print('%-16s %8.0f usec/burst (median), %d datagrams in %d passes' % (os.path.basename(path), result[0], result[1], result[2]))
+
+    (_, datagrams, passes), (_, _, ref_passes) = results
+    if passes * SEG_UDP_DRAIN_BUDGET < datagrams:
+        print('FAIL: %d datagrams in %d passes, more than %d per pass' % (datagrams, passes, SEG_UDP_DRAIN_BUDGET))
+        return 1
+    if passes >= ref_passes:
+        print('FAIL: %d passes, the reference (one datagram per pass) took %d' % (passes, ref_passes))
+        return 1
+    print('PASS: drain in %d passes, reference %d' % (passes, ref_passes))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
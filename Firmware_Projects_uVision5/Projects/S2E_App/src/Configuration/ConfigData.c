@@ -3,6 +3,7 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include "common.h"
 #include "W7500x_wztoe.h"
@@ -12,9 +13,31 @@
 #include "deviceHandler.h"
 #include "segcp.h"
 #include "uartHandler.h"
+#include "eventHandler.h"
 
 static DevConfig dev_config;
 
+// Sections of DevConfig: end offsets, the unit of the change check and the partial write
+static const uint16_t config_section_end[] = {
+	offsetof(DevConfig, network_info_common),
+	offsetof(DevConfig, network_info),
+	offsetof(DevConfig, serial_info),
+	offsetof(DevConfig, options),
+	offsetof(DevConfig, user_io_info),
+	offsetof(DevConfig, firmware_update),
+	offsetof(DevConfig, firmware_update_extend),
+	offsetof(DevConfig, network_option),
+	sizeof(DevConfig)
+};
+#define CONFIG_SECTION_NUM		(sizeof(config_section_end) / sizeof(config_section_end[0]))
+#define CONFIG_COMPARE_CHUNK	16
+
+// Deferred save: housekeeping ticks left, 0: none pending
+static uint8_t config_save_countdown = 0;
+
+static void set_DevConfig_option_to_factory_value(void);
+static uint16_t get_DevConfig_changed_sections(void);
+
 DevConfig* get_DevConfig_pointer(void)
 {
 	return &dev_config;
@@ -128,6 +151,17 @@ void set_DevConfig_to_factory_value(void)
 	memcpy(dev_config.firmware_update_extend.fwup_server_domain, FWUP_SERVER_DOMAIN, sizeof(FWUP_SERVER_DOMAIN));
 	memset(dev_config.firmware_update_extend.fwup_server_binpath, 0x00, sizeof(dev_config.firmware_update_extend.fwup_server_binpath));
 	memcpy(dev_config.firmware_update_extend.fwup_server_binpath, FWUP_SERVER_BINPATH, sizeof(FWUP_SERVER_BINPATH));
+	
+	set_DevConfig_option_to_factory_value();
+}
+
+// Extended Fields: appended to the end of DevConfig, not included in the configuration data saved by older firmware
+static void set_DevConfig_option_to_factory_value(void)
+{
+	dev_config.network_option.reconnect_backoff_max = 10;	// sec, default: 10 sec
+	dev_config.network_option.option_flags = 0;
+	dev_config.network_option.frame_mode = FRAME_MODE_NONE;
+	memset(dev_config.network_option.telemetry_ip, 0x00, sizeof(dev_config.network_option.telemetry_ip)); // Telemetry push disabled
 }
 
 void load_DevConfig_from_storage(void)
@@ -140,6 +174,18 @@ void load_DevConfig_from_storage(void)
 		set_DevConfig_to_factory_value();
 		write_storage(STORAGE_CONFIG, 0, &dev_config, sizeof(DevConfig));
 	}
+	else if(dev_config.packet_size < sizeof(DevConfig)) // Configuration data saved by older firmware: the extended fields are left erased (0xFF)
+	{
+		// Only the extended fields beyond the saved size are set to the factory values
+		struct __network_option saved_option = dev_config.network_option;
+		
+		set_DevConfig_option_to_factory_value();
+		if(dev_config.packet_size > offsetof(DevConfig, network_option))
+		{
+			memcpy(&dev_config.network_option, &saved_option, dev_config.packet_size - offsetof(DevConfig, network_option));
+		}
+		dev_config.packet_size = sizeof(DevConfig);
+	}
 	
 	dev_config.network_info[0].state = ST_OPEN;
 	
@@ -152,7 +198,76 @@ void load_DevConfig_from_storage(void)
 
 void save_DevConfig_to_storage(void)
 {
+	uint16_t changed = get_DevConfig_changed_sections();
+#ifdef __USE_EXT_EEPROM__
+	uint16_t start = 0;
+	uint8_t i;
+#endif
+	
+	config_save_countdown = 0;
+	if(changed == 0) return; // Same as the stored data: the write is skipped
+	
+	CALL_PROBE_ENTER(PROFILE_CONFIG_SAVE);
+#ifdef __USE_EXT_EEPROM__
+	for(i = 0; i < CONFIG_SECTION_NUM; i++)
+	{
+		if(changed & (1 << i)) write_storage(STORAGE_CONFIG, start, (uint8_t *)&dev_config + start, config_section_end[i] - start);
+		start = config_section_end[i];
+	}
+#else
+	// The data flash is erased by the sector: the whole configuration data is written
 	write_storage(STORAGE_CONFIG, 0, &dev_config, sizeof(DevConfig));
+#endif
+	CALL_PROBE_EXIT(PROFILE_CONFIG_SAVE);
+}
+
+void request_save_DevConfig(void)
+{
+	config_save_countdown = CONFIG_SAVE_DELAY_SEC + 1; // The first tick may come at once
+}
+
+void do_save_DevConfig(void)
+{
+	if(config_save_countdown && (--config_save_countdown == 0)) save_DevConfig_to_storage();
+}
+
+void flush_save_DevConfig(void)
+{
+	if(config_save_countdown) save_DevConfig_to_storage();
+}
+
+void cancel_save_DevConfig(void)
+{
+	config_save_countdown = 0;
+}
+
+// ret: bit n: section n differs from the stored data
+static uint16_t get_DevConfig_changed_sections(void)
+{
+	uint8_t buf[CONFIG_COMPARE_CHUNK];
+	uint16_t changed = 0;
+	uint16_t offset = 0;
+	uint16_t len;
+	uint8_t i;
+	
+	for(i = 0; i < CONFIG_SECTION_NUM; i++)
+	{
+		while(offset < config_section_end[i])
+		{
+			len = config_section_end[i] - offset;
+			if(len > CONFIG_COMPARE_CHUNK) len = CONFIG_COMPARE_CHUNK;
+			
+			read_storage(STORAGE_CONFIG, offset, buf, len);
+			if(memcmp(buf, (uint8_t *)&dev_config + offset, len))
+			{
+				changed |= (1 << i);
+				offset = config_section_end[i]; // Next section
+				break;
+			}
+			offset += len;
+		}
+	}
+	return changed;
 }
 
 void get_DevConfig_value(void *dest, const void *src, uint16_t size)
@@ -26,7 +26,7 @@ struct __network_info_common {
 } __attribute__((packed));
 
 struct __network_info {
-	uint8_t working_mode;			// TCP_CLIENT_MODE (0), TCP_SERVER_MODE (1), TCP_MIXED_MODE (2), UDP_MODE (3)
+	uint8_t working_mode;			// TCP_CLIENT_MODE (0), TCP_SERVER_MODE (1), TCP_MIXED_MODE (2), UDP_MODE (3), L2_TUNNEL_MODE (4), MODBUS_GATEWAY_MODE (5)
 	uint8_t state;					// WIZ107SR: BOOT(0), OPEN (1), CONNECT (2), UPGARDE (3), ATMODE (4) // WIZ550S2E: 소켓의 상태 TCP의 경우 Not Connected, Connected, UDP의 경우 UDP
 	uint8_t remote_ip[4];			// Must Be 4byte Alignment
 	uint16_t local_port;
@@ -95,6 +95,29 @@ struct __firmware_update_extend {
 	uint8_t fwup_server_binpath[FWUP_BINPATH_SIZE];
 } __attribute__((packed));
 
+// Field added for extended S2E functions
+// Notice: sizeof(DevConfig) must not exceed the config data sector (SECT_SIZE, 256 bytes)
+struct __network_option {
+	uint8_t reconnect_backoff_max;	// TCP client reconnection backoff cap (sec), 0: fixed interval (reconnection) only
+	uint8_t option_flags;			// NET_OPTION_* bit flags
+	uint8_t frame_mode;				// TCP data socket encapsulation: FRAME_MODE_*
+	uint8_t telemetry_ip[4];		// UDP telemetry push collector (DEVICE_TELEMETRY_PORT), 0.0.0.0: disabled
+} __attribute__((packed));
+
+// network_option.option_flags
+#define NET_OPTION_KEEPALIVE_AUTO		0x01	// TCP keep-alive: [0] S2E keep-alive timer / [1] WZTOE auto keep-alive timer (Sn_KPALVTR)
+#define NET_OPTION_TELNET_COM_PORT		0x02	// TCP data socket: [0] Raw / [1] Telnet with COM port control (RFC 2217)
+#define NET_OPTION_STORE_FORWARD		0x04	// TCP modes: Serial data is kept during the disconnection and sent after connected
+#define NET_OPTION_TELEMETRY_INTERVAL	0x70	// UDP telemetry push interval code (3 bits), see TELEMETRY_INTERVAL_TABLE (segtelemetry.h)
+#define NET_OPTION_TELEMETRY_SHIFT		4
+
+// network_option.frame_mode
+#define FRAME_MODE_NONE					0		// Byte stream (serial data packing only)
+#define FRAME_MODE_LENGTH				1		// [Length 2, big-endian][Data]
+#define FRAME_MODE_SLIP					2		// SLIP (RFC 1055): [END][Escaped data][END]
+#define FRAME_MODE_COBS					3		// COBS: [Encoded data][0x00]
+#define FRAME_MODE_TIMESTAMP			4		// [Sequence 2][Length 2][Arrival usec 4][Sent usec 4][Data], Device -> Peer only
+
 typedef struct __DevConfig {
 	uint16_t packet_size;
 	uint8_t module_type[3];		// 모듈의 종류별로 코드를 부여하고 이를 사용한다.
@@ -107,12 +130,21 @@ typedef struct __DevConfig {
 	struct __user_io_info user_io_info;		// Enable / Type / Direction
 	struct __firmware_update firmware_update;					// ## Eric, Field added for compatibility with WIZ107SR
 	struct __firmware_update_extend firmware_update_extend;		// ## Eric, Field added for Extended function: Firmware update by HTTP (Remote) Server
+	struct __network_option network_option;						// Field added for extended S2E functions
 } __attribute__((packed)) DevConfig;
 
+// Configuration data save: only the sections changed from the stored data are written, nothing if unchanged.
+// External EEPROM: the changed sections only / Internal data flash: the whole sector (erased before the write)
+#define CONFIG_SAVE_DELAY_SEC		1		// Deferred save: written this time after the last request (1 ~ 2 sec)
+
 DevConfig* get_DevConfig_pointer(void);
 void set_DevConfig_to_factory_value(void);
 void load_DevConfig_from_storage(void);
-void save_DevConfig_to_storage(void);
+void save_DevConfig_to_storage(void);		// Now
+void request_save_DevConfig(void);			// Deferred; the requests within the delay are coalesced
+void do_save_DevConfig(void);				// Called every second by the housekeeping event (main loop)
+void flush_save_DevConfig(void);			// Pending deferred save is written now, e.g., before the reboot
+void cancel_save_DevConfig(void);			// Pending deferred save is dropped, e.g., the storage is erased
 void get_DevConfig_value(void *dest, const void *src, uint16_t size);
 void set_DevConfig_value(void *dest, const void *value, const uint16_t size);
 void set_DevConfig(wiz_NetInfo *net);
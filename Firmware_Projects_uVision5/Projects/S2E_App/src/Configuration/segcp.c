@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
@@ -14,35 +15,102 @@
 
 #include "seg.h"
 #include "segcp.h"
+#include "segcptlv.h"
+#include "segmodbus.h"
+#include "segtelemetry.h"
+#include "segbench.h"
 #include "util.h"
 #include "uartHandler.h"
 #include "gpioHandler.h"
 #include "timerHandler.h"
+#include "eventHandler.h"
+#include "profileHandler.h"
+#include "traceHandler.h"
+#include "memoryHandler.h"
 
 /* Private define ------------------------------------------------------------*/
 // Ring Buffer declaration
 BUFFER_DECLARATION(data_rx);
 
+// Command lookup key: the 2 characters, switch case labels of find_SEGCP_cmd()
+#define SEGCP_CMD_KEY(c0, c1)		((uint16_t)(((uint16_t)(uint8_t)(c0) << 8) | (uint8_t)(c1)))
+
+// Command lookup of parse_SEGCP(); the host simulation benchmark (sim/bench_segcp.c) replaces it with the linear search
+#ifndef SEGCP_FIND_CMD
+	#define SEGCP_FIND_CMD(pmsg)	find_SEGCP_cmd(pmsg)
+#endif
+
+// Serial settings applied live: the characters left in the UART Tx FIFO (16) and the shift register are waited for;
+// bounded, the FIFO is not drained while the CTS is inactive (RTS/CTS flow control)
+#define SEGCP_UART_TX_WAIT_CHARS	17
+
+/* Private typedef -----------------------------------------------------------*/
+// UDP search options of a request (Q* lines)
+struct __segcp_search {
+	uint8_t match;				// [0] Filtered out: no reply
+	uint8_t unicast;			// [1] Reply to the requester
+	uint16_t delay_window;		// msec
+};
+
+// Snapshot of the settings a request may write: rolled back as a whole on an error, compared to apply the changes live.
+// DevConfig without the fields no command writes: size, module type, firmware version, firmware update server domain / path
+struct __segcp_settings_bak {
+	uint8_t module_name[15];
+	struct __network_info_common network_info_common;
+	struct __network_info network_info;
+	struct __serial_info serial_info;
+	struct __options options;
+	struct __user_io_info user_io_info;
+	struct __firmware_update firmware_update;
+	uint8_t fwup_server_flag;
+	uint16_t fwup_server_port;
+	uint8_t fwup_server_use_default;
+	struct __network_option network_option;
+};
+
 /* Private functions ---------------------------------------------------------*/
-uint16_t uart_get_commandline(uint8_t uartNum, uint8_t* buf, uint16_t maxSize);
+static uint16_t get_SEGCP_uart_line(uint8_t uartNum);
+static uint8_t find_SEGCP_cmd(uint8_t * pmsg);
+static uint8_t * parse_SEGCP_search(uint8_t * req, struct __segcp_search * search);
+static void send_SEGCP_udp(uint8_t * rep, uint16_t len, uint8_t * destip, uint16_t destport, uint16_t delay_window);
+static void send_SEGCP_udp_delayed(void);
+static void backup_SEGCP_settings(struct __segcp_settings_bak * bak);
+static void restore_SEGCP_settings(struct __segcp_settings_bak * bak);
+static uint16_t apply_SEGCP_settings(struct __segcp_settings_bak * bak, uint16_t segcp_ret);
+static uint8_t is_segcp_timer_event(void);
 
 /* Private variables ---------------------------------------------------------*/
 static uint8_t gSEGCPREQ[CONFIG_BUF_SIZE];
 static uint8_t gSEGCPREP[CONFIG_BUF_SIZE];
 
-uint8_t * strDEVSTATUS[]  = {"BOOT", "OPEN", "CONNECT", "UPGARDE", "ATMODE", "UDP", 0};
+// Delayed UDP search reply: kept in the socket Tx buffer until sent, the requests received meanwhile wait in the Rx buffer
+static uint8_t flag_segcp_reply_pending = SEGCP_DISABLE;
+static volatile uint16_t segcp_reply_delay = 0; // msec, counted down by the timer
+
+// Serial AT command line being assembled, kept across the calls
+static uint8_t segcp_uart_line[SEGCP_PARAM_MAX*2];
+static uint16_t segcp_uart_len = 0;
+static uint8_t flag_segcp_uart_line = SEGCP_DISABLE; // A command line is processed by the last proc_SEGCP_uart()
+
+// Event trace dump cursor (TD): ring, sequence number of the next record
+static uint8_t trace_dump_ring = 0;
+static uint32_t trace_dump_seq = 0;
+
+uint8_t * const strDEVSTATUS[]  = {"BOOT", "OPEN", "CONNECT", "UPGARDE", "ATMODE", "UDP", 0};
 
 // [K!]: Hidden command, Erase the MAC address and configuration data
-uint8_t * tbSEGCPCMD[] = {"MC", "VR", "MN", "IM", "OP", "DD", "CP", "PO", "DG", "KA", 
+uint8_t * const tbSEGCPCMD[] = {"MC", "VR", "MN", "IM", "OP", "DD", "CP", "PO", "DG", "KA", 
 							"KI", "KE", "RI", "LI", "SM", "GW", "DS", "PI", "PP", "DX",
 							"DP", "DI", "DW", "DH", "LP", "RP", "RH", "BR", "DB", "PR",
 							"SB", "FL", "IT", "PT", "PS", "PD", "TE", "SS", "NP", "SP",
 							"LG", "ER", "FW", "MA", "PW", "SV", "EX", "RT", "UN", "ST",
 							"FR", "EC", "K!", "UE", "GA", "GB", "GC", "GD", "CA", "CB", 
 							"CC", "CD", "SC", "S0", "S1", "RX", "FS", "FC", "FP", "FD",
-							"FH", "UI", 0};
+							"FH", "UI", "EV", "RB", "RC",
+							"KM", "LT", "FM", "MG", "SF", "BS", "LH", "PF", "TS",
+							"TI", "TN", "LM", "LB", "BT", "TD", "RM", 0};
 
-uint8_t * tbSEGCPERR[] = {"ERNULL", "ERNOTAVAIL", "ERNOPARAM", "ERIGNORED", "ERNOCOMMAND", "ERINVALIDPARAM", "ERNOPRIVILEGE"};
+uint8_t * const tbSEGCPERR[] = {"ERNULL", "ERNOTAVAIL", "ERNOPARAM", "ERIGNORED", "ERNOCOMMAND", "ERINVALIDPARAM", "ERNOPRIVILEGE"};
 
 uint8_t gSEGCPPRIVILEGE = SEGCP_PRIVILEGE_CLR;
 
@@ -59,16 +127,30 @@ void do_segcp(void)
 
 	uint8_t ret = 0;
 	uint16_t segcp_ret = 0;
+	uint16_t uart_ret = 0;
 	//uint8_t ConfigErasePW[10];
 	teDEVSTATUS status_bak;
+	struct __segcp_settings_bak settings_bak; // On the stack, only while do_segcp() runs; no room in the static RAM
 	
-	segcp_ret  = proc_SEGCP_udp(gSEGCPREQ, gSEGCPREP);
-	segcp_ret |= proc_SEGCP_tcp(gSEGCPREQ, gSEGCPREP);
+	// Each request is applied live or rolled back as a whole: every setting a command may write is in the snapshot
+	backup_SEGCP_settings(&settings_bak);
+	
+	segcp_ret  = apply_SEGCP_settings(&settings_bak, proc_SEGCP_udp(gSEGCPREQ, gSEGCPREP));
+	segcp_ret |= apply_SEGCP_settings(&settings_bak, proc_SEGCP_tcp(gSEGCPREQ, gSEGCPREP));
 
-	// Process the serial AT command mode
+	// Process the serial AT command mode: the command lines received are processed in a pass, each as a request;
+	// a line with the flags (e.g., save, reboot, mode switch) or an error ends the pass to be handled below
 	if(opmode == DEVICE_AT_MODE)
 	{
-		segcp_ret |= proc_SEGCP_uart(gSEGCPREP);
+		do {
+			uart_ret = apply_SEGCP_settings(&settings_bak, proc_SEGCP_uart(gSEGCPREP));
+		} while(flag_segcp_uart_line && (uart_ret == 0));
+		
+		segcp_ret |= uart_ret;
+	}
+	else
+	{
+		segcp_uart_len = 0; // A partial command line is discarded with the serial data by the mode switch
 	}
 	
 	
@@ -91,7 +173,7 @@ void do_segcp(void)
 		}
 		else if(segcp_ret & SEGCP_RET_SAVE)
 		{
-			save_DevConfig_to_storage();
+			request_save_DevConfig(); // Deferred: the saves of a configuration session are coalesced
 		}
 		else if(segcp_ret & SEGCP_RET_ERASE_EEPROM)
 		{
@@ -105,6 +187,7 @@ void do_segcp(void)
 #endif
 				printf("\r\n");
 				
+				cancel_save_DevConfig(); // The pending save would write the erased data back (e.g., flushed before the reboot)
 				erase_storage(STORAGE_MAC);
 				erase_storage(STORAGE_CONFIG);
 			//}
@@ -211,18 +294,14 @@ void do_segcp(void)
 
 uint8_t parse_SEGCP(uint8_t * pmsg, uint8_t * param)
 {
-	uint8_t** pcmd;
 	uint8_t cmdnum = 0;
 	uint8_t i;
 
 	*param = 0;
 
-	for(pcmd = tbSEGCPCMD; *pcmd != 0; pcmd++)
-	{
-		if(!strncmp((char *)pmsg, *pcmd, strlen(*pcmd))) break;
-	}
+	cmdnum = SEGCP_FIND_CMD(pmsg);
 	
-	if(*pcmd == 0) 
+	if(cmdnum == SEGCP_UNKNOWN) 
 	{
 #ifdef _SEGCP_DEBUG_   
 		printf("SEGCP[UNKNOWN]:%s\r\n", pmsg);
@@ -230,8 +309,6 @@ uint8_t parse_SEGCP(uint8_t * pmsg, uint8_t * param)
 		return SEGCP_UNKNOWN;
 	}
 	
-	cmdnum = (uint8_t)(pcmd - tbSEGCPCMD);
-	
 	if(cmdnum == (uint8_t)SEGCP_MA) 
 	{
 		if((pmsg[8] == '\r') && (pmsg[9] == '\n'))
@@ -265,7 +342,7 @@ uint8_t parse_SEGCP(uint8_t * pmsg, uint8_t * param)
 	}
 
 #ifdef _SEGCP_DEBUG_
-	printf("SEGCP[%d:%s:", cmdnum, *pcmd);
+	printf("SEGCP[%d:%s:", cmdnum, tbSEGCPCMD[cmdnum]);
 	if(cmdnum == SEGCP_MA)
 	{
 		for(i = 0; i < 6; i++) printf("%.2x", param[i]);
@@ -280,6 +357,112 @@ uint8_t parse_SEGCP(uint8_t * pmsg, uint8_t * param)
 	return cmdnum;
 }
 
+// ret: command number / SEGCP_UNKNOWN; the characters following the command are not checked
+// The switch is compiled into a search / jump table in flash, no RAM is used. A new command is added to tbSEGCPCMD,
+// teSEGCPCMDNUM and here; sim/bench_segcp.c checks the cases against tbSEGCPCMD.
+static uint8_t find_SEGCP_cmd(uint8_t * pmsg)
+{
+	if(pmsg[0] == 0) return SEGCP_UNKNOWN;
+	
+	switch(SEGCP_CMD_KEY(pmsg[0], pmsg[1]))
+	{
+		case SEGCP_CMD_KEY('M', 'C'): return SEGCP_MC;
+		case SEGCP_CMD_KEY('V', 'R'): return SEGCP_VR;
+		case SEGCP_CMD_KEY('M', 'N'): return SEGCP_MN;
+		case SEGCP_CMD_KEY('I', 'M'): return SEGCP_IM;
+		case SEGCP_CMD_KEY('O', 'P'): return SEGCP_OP;
+		case SEGCP_CMD_KEY('D', 'D'): return SEGCP_DD;
+		case SEGCP_CMD_KEY('C', 'P'): return SEGCP_CP;
+		case SEGCP_CMD_KEY('P', 'O'): return SEGCP_PO;
+		case SEGCP_CMD_KEY('D', 'G'): return SEGCP_DG;
+		case SEGCP_CMD_KEY('K', 'A'): return SEGCP_KA;
+		case SEGCP_CMD_KEY('K', 'I'): return SEGCP_KI;
+		case SEGCP_CMD_KEY('K', 'E'): return SEGCP_KE;
+		case SEGCP_CMD_KEY('R', 'I'): return SEGCP_RI;
+		case SEGCP_CMD_KEY('L', 'I'): return SEGCP_LI;
+		case SEGCP_CMD_KEY('S', 'M'): return SEGCP_SM;
+		case SEGCP_CMD_KEY('G', 'W'): return SEGCP_GW;
+		case SEGCP_CMD_KEY('D', 'S'): return SEGCP_DS;
+		case SEGCP_CMD_KEY('P', 'I'): return SEGCP_PI;
+		case SEGCP_CMD_KEY('P', 'P'): return SEGCP_PP;
+		case SEGCP_CMD_KEY('D', 'X'): return SEGCP_DX;
+		case SEGCP_CMD_KEY('D', 'P'): return SEGCP_DP;
+		case SEGCP_CMD_KEY('D', 'I'): return SEGCP_DI;
+		case SEGCP_CMD_KEY('D', 'W'): return SEGCP_DW;
+		case SEGCP_CMD_KEY('D', 'H'): return SEGCP_DH;
+		case SEGCP_CMD_KEY('L', 'P'): return SEGCP_LP;
+		case SEGCP_CMD_KEY('R', 'P'): return SEGCP_RP;
+		case SEGCP_CMD_KEY('R', 'H'): return SEGCP_RH;
+		case SEGCP_CMD_KEY('B', 'R'): return SEGCP_BR;
+		case SEGCP_CMD_KEY('D', 'B'): return SEGCP_DB;
+		case SEGCP_CMD_KEY('P', 'R'): return SEGCP_PR;
+		case SEGCP_CMD_KEY('S', 'B'): return SEGCP_SB;
+		case SEGCP_CMD_KEY('F', 'L'): return SEGCP_FL;
+		case SEGCP_CMD_KEY('I', 'T'): return SEGCP_IT;
+		case SEGCP_CMD_KEY('P', 'T'): return SEGCP_PT;
+		case SEGCP_CMD_KEY('P', 'S'): return SEGCP_PS;
+		case SEGCP_CMD_KEY('P', 'D'): return SEGCP_PD;
+		case SEGCP_CMD_KEY('T', 'E'): return SEGCP_TE;
+		case SEGCP_CMD_KEY('S', 'S'): return SEGCP_SS;
+		case SEGCP_CMD_KEY('N', 'P'): return SEGCP_NP;
+		case SEGCP_CMD_KEY('S', 'P'): return SEGCP_SP;
+		case SEGCP_CMD_KEY('L', 'G'): return SEGCP_LG;
+		case SEGCP_CMD_KEY('E', 'R'): return SEGCP_ER;
+		case SEGCP_CMD_KEY('F', 'W'): return SEGCP_FW;
+		case SEGCP_CMD_KEY('M', 'A'): return SEGCP_MA;
+		case SEGCP_CMD_KEY('P', 'W'): return SEGCP_PW;
+		case SEGCP_CMD_KEY('S', 'V'): return SEGCP_SV;
+		case SEGCP_CMD_KEY('E', 'X'): return SEGCP_EX;
+		case SEGCP_CMD_KEY('R', 'T'): return SEGCP_RT;
+		case SEGCP_CMD_KEY('U', 'N'): return SEGCP_UN;
+		case SEGCP_CMD_KEY('S', 'T'): return SEGCP_ST;
+		case SEGCP_CMD_KEY('F', 'R'): return SEGCP_FR;
+		case SEGCP_CMD_KEY('E', 'C'): return SEGCP_EC;
+		case SEGCP_CMD_KEY('K', '!'): return SEGCP_K1;
+		case SEGCP_CMD_KEY('U', 'E'): return SEGCP_UE;
+		case SEGCP_CMD_KEY('G', 'A'): return SEGCP_GA;
+		case SEGCP_CMD_KEY('G', 'B'): return SEGCP_GB;
+		case SEGCP_CMD_KEY('G', 'C'): return SEGCP_GC;
+		case SEGCP_CMD_KEY('G', 'D'): return SEGCP_GD;
+		case SEGCP_CMD_KEY('C', 'A'): return SEGCP_CA;
+		case SEGCP_CMD_KEY('C', 'B'): return SEGCP_CB;
+		case SEGCP_CMD_KEY('C', 'C'): return SEGCP_CC;
+		case SEGCP_CMD_KEY('C', 'D'): return SEGCP_CD;
+		case SEGCP_CMD_KEY('S', 'C'): return SEGCP_SC;
+		case SEGCP_CMD_KEY('S', '0'): return SEGCP_S0;
+		case SEGCP_CMD_KEY('S', '1'): return SEGCP_S1;
+		case SEGCP_CMD_KEY('R', 'X'): return SEGCP_RX;
+		case SEGCP_CMD_KEY('F', 'S'): return SEGCP_FS;
+		case SEGCP_CMD_KEY('F', 'C'): return SEGCP_FC;
+		case SEGCP_CMD_KEY('F', 'P'): return SEGCP_FP;
+		case SEGCP_CMD_KEY('F', 'D'): return SEGCP_FD;
+		case SEGCP_CMD_KEY('F', 'H'): return SEGCP_FH;
+		case SEGCP_CMD_KEY('U', 'I'): return SEGCP_UI;
+		case SEGCP_CMD_KEY('E', 'V'): return SEGCP_EV;
+		case SEGCP_CMD_KEY('R', 'B'): return SEGCP_RB;
+		case SEGCP_CMD_KEY('R', 'C'): return SEGCP_RC;
+		case SEGCP_CMD_KEY('K', 'M'): return SEGCP_KM;
+		case SEGCP_CMD_KEY('L', 'T'): return SEGCP_LT;
+		case SEGCP_CMD_KEY('F', 'M'): return SEGCP_FM;
+		case SEGCP_CMD_KEY('M', 'G'): return SEGCP_MG;
+		case SEGCP_CMD_KEY('S', 'F'): return SEGCP_SF;
+		case SEGCP_CMD_KEY('B', 'S'): return SEGCP_BS;
+		case SEGCP_CMD_KEY('L', 'H'): return SEGCP_LH;
+		case SEGCP_CMD_KEY('P', 'F'): return SEGCP_PF;
+		case SEGCP_CMD_KEY('T', 'S'): return SEGCP_TS;
+		case SEGCP_CMD_KEY('T', 'I'): return SEGCP_TI;
+		case SEGCP_CMD_KEY('T', 'N'): return SEGCP_TN;
+		case SEGCP_CMD_KEY('L', 'M'): return SEGCP_LM;
+		case SEGCP_CMD_KEY('L', 'B'): return SEGCP_LB;
+		case SEGCP_CMD_KEY('B', 'T'): return SEGCP_BT;
+		case SEGCP_CMD_KEY('T', 'D'): return SEGCP_TD;
+		case SEGCP_CMD_KEY('R', 'M'): return SEGCP_RM;
+		default: break;
+	}
+	
+	return SEGCP_UNKNOWN;
+}
+
 uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 {
 	DevConfig *dev_config = get_DevConfig_pointer();
@@ -298,13 +481,30 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 	
 	uint8_t  tmp_byte = 0;
 	uint16_t tmp_int = 0;
-	uint32_t tmp_long = 0;
+	unsigned long tmp_long = 0; // sscanf "%lu"
 	
 	uint8_t tmp_ip[4];
+	struct __event_stat event_stat;
+	struct __reconnect_stat reconnect_stat;
+	struct __l2tunnel_stat l2tunnel_stat;
+	struct __modbus_stat modbus_stat;
+	struct __store_forward_stat store_forward_stat;
+	struct __latency_hist latency_hist;
+	struct __transfer_stat transfer_stat;
+	struct __loop_stat loop_stat;
+	struct __bench_stat bench_stat;
+	struct __trace_record trace_rec;
+	uint32_t trace_seq;
+	struct __ram_map ram_map;
+#ifdef _PROFILE_
+	struct __profile_stat profile_stat;
+#endif
 	
 
 	uint8_t param[SEGCP_PARAM_MAX*2];
 	
+	CALL_PROBE_ENTER(PROFILE_PROC_SEGCP);
+	
 #ifdef _SEGCP_DEBUG_   
 	printf("SEGCP_REQ : %s\r\n",segcp_req);
 #endif
@@ -351,8 +551,7 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 					//case SEGCP_DD: sprintf(trep,"%d", tsvDEVCONFnew.ddns_en);
 					case SEGCP_DD: sprintf(trep,"%d", 0);
 						break;
-					//case SEGCP_PO: sprintf(trep,"%d", tsvDEVCONFnew.telnet_en[0]);
-					case SEGCP_PO: sprintf(trep,"%d", 0);
+					case SEGCP_PO: sprintf(trep,"%d", (dev_config->network_option.option_flags & NET_OPTION_TELNET_COM_PORT)?SEGCP_TELNET:SEGCP_RAW); // [0] Raw / [1] Telnet, RFC 2217
 						break;
 					case SEGCP_CP: sprintf(trep,"%d", dev_config->options.pw_connect_en);
 						break;
@@ -364,6 +563,18 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						break;
 					case SEGCP_KE: sprintf(trep,"%d", dev_config->network_info[0].keepalive_retry_time);
 						break;
+					case SEGCP_KM: sprintf(trep,"%d", (dev_config->network_option.option_flags & NET_OPTION_KEEPALIVE_AUTO)?1:0); // [0] S2E timer / [1] WZTOE auto
+						break;
+					case SEGCP_FM: sprintf(trep,"%d", dev_config->network_option.frame_mode); // [0] None / [1] Length-prefix / [2] SLIP / [3] COBS / [4] Timestamp
+						break;
+					case SEGCP_SF: sprintf(trep,"%d", (dev_config->network_option.option_flags & NET_OPTION_STORE_FORWARD)?1:0); // Store-and-forward [0] Disable / [1] Enable
+						break;
+					case SEGCP_TI: // Telemetry collector IP, 0.0.0.0: Disabled
+						sprintf(trep,"%d.%d.%d.%d", dev_config->network_option.telemetry_ip[0], dev_config->network_option.telemetry_ip[1],
+													dev_config->network_option.telemetry_ip[2], dev_config->network_option.telemetry_ip[3]);
+						break;
+					case SEGCP_TN: sprintf(trep,"%d", get_telemetry_interval()); // Telemetry push interval (sec)
+						break;
 					case SEGCP_RI: sprintf(trep,"%d", dev_config->network_info[0].reconnection);
 						break;
 					case SEGCP_LI:
@@ -587,6 +798,145 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 					case SEGCP_UE: // User echo, not used.
 						sprintf(trep, "%d", 0);
 						break;
+					case SEGCP_EV: // Main loop event statistics; [dispatch count],[avg],[max] wake-to-dispatch latency (usec) per event
+						for(tmp_byte = 0; tmp_byte < EVENT_MAX; tmp_byte++)
+						{
+							get_event_stat((teEVENT)tmp_byte, &event_stat);
+							sprintf(trep, "%s%u,%u,%u", (tmp_byte == 0)?"":"/", event_stat.dispatch_cnt, event_stat.latency_avg, event_stat.latency_max);
+							trep += strlen(trep);
+						}
+						break;
+					case SEGCP_RB: // TCP client reconnection backoff cap (sec)
+						sprintf(trep, "%d", dev_config->network_option.reconnect_backoff_max);
+						break;
+					case SEGCP_RC: // TCP client reconnection statistics; [reconnect count]/[connection attempts]/[last]/[max] time-to-reconnect (msec)
+						get_reconnect_stat(&reconnect_stat);
+						sprintf(trep, "%u/%u/%u/%u", reconnect_stat.reconnect_cnt, reconnect_stat.attempt_cnt, reconnect_stat.last_time, reconnect_stat.max_time);
+						break;
+					case SEGCP_LT: // L2 tunnel frame statistics; [tx]/[rx]/[lost]/[dropped] frames
+						get_l2tunnel_stat(&l2tunnel_stat);
+						sprintf(trep, "%u/%u/%u/%u", l2tunnel_stat.tx_cnt, l2tunnel_stat.rx_cnt, l2tunnel_stat.lost_cnt, l2tunnel_stat.drop_cnt);
+						break;
+					case SEGCP_MG: // Modbus gateway statistics; [requests]/[responses]/[timeouts]/[errors]/[last],[avg],[max] turnaround (usec)
+						get_modbus_stat(&modbus_stat);
+						sprintf(trep, "%u/%u/%u/%u/%u,%u,%u", modbus_stat.req_cnt, modbus_stat.resp_cnt, modbus_stat.timeout_cnt, modbus_stat.error_cnt,
+								modbus_stat.turnaround_last, modbus_stat.turnaround_avg, modbus_stat.turnaround_max);
+						break;
+					case SEGCP_BS: // Store-and-forward statistics; [buffered]/[peak buffered]/[replays]/[replayed] bytes/[last replay throughput] (bytes/sec)
+						get_store_forward_stat(&store_forward_stat);
+						sprintf(trep, "%u/%u/%u/%u/%u", store_forward_stat.buffered, store_forward_stat.buffered_max, store_forward_stat.replay_cnt,
+								store_forward_stat.replay_bytes, store_forward_stat.replay_rate);
+						break;
+					case SEGCP_LH: // Data path latency histograms; [U2E]/[E2U]: [max],[bucket 0],[bucket 1],...,[bucket 23] (usec, log2 buckets)
+						for(tmp_byte = 0; tmp_byte < LATENCY_PATH_MAX; tmp_byte++)
+						{
+							get_latency_hist((teLATENCYPATH)tmp_byte, &latency_hist);
+							sprintf(trep, "%s%u", (tmp_byte == 0)?"":"/", latency_hist.max);
+							trep += strlen(trep);
+							for(tmp_int = 0; tmp_int < LATENCY_HIST_BUCKETS; tmp_int++)
+							{
+								sprintf(trep, ",%u", latency_hist.bucket[tmp_int]);
+								trep += strlen(trep);
+							}
+						}
+						break;
+					case SEGCP_TS: // Data transfer statistics; [UART rx]/[UART -> network]/[network rx]/[network -> UART]:
+					               // [bytes],[packets],[bytes/sec 1s],[10s],[60s],[packets/sec 1s],[10s],[60s]
+						for(tmp_byte = 0; tmp_byte < SEG_ALL; tmp_byte++)
+						{
+							get_transfer_stat((teDATADIR)tmp_byte, &transfer_stat);
+							sprintf(trep, "%s%llu,%llu,%u,%u,%u,%u,%u,%u", (tmp_byte == 0)?"":"/",
+									(unsigned long long)transfer_stat.bytes, (unsigned long long)transfer_stat.packets,
+									transfer_stat.byte_rate[0], transfer_stat.byte_rate[1], transfer_stat.byte_rate[2],
+									transfer_stat.packet_rate[0], transfer_stat.packet_rate[1], transfer_stat.packet_rate[2]);
+							trep += strlen(trep);
+						}
+						break;
+					case SEGCP_PF: // Hot-path profiler; [count],[min],[max],[avg] (cycles),[total] (usec) per probe, the order of tePROFILE
+#ifdef _PROFILE_
+						for(tmp_byte = 0; tmp_byte < PROFILE_MAX; tmp_byte++)
+						{
+							get_profile_stat((tePROFILE)tmp_byte, &profile_stat);
+							sprintf(trep, "%s%u,%u,%u,%u,%u", (tmp_byte == 0)?"":"/", profile_stat.count, profile_stat.min, profile_stat.max,
+									profile_stat.count ? (uint32_t)(profile_stat.total / profile_stat.count) : 0,
+									(uint32_t)(profile_stat.total / (GetSystemClock() / 1000000)));
+							trep += strlen(trep);
+						}
+#else
+						ret |= SEGCP_RET_ERR_NOTAVAIL; // Profiler compiled out (_PROFILE_)
+#endif
+						break;
+					case SEGCP_LM: // Main loop iteration time (usec); [iterations],[last],[avg],[max],[worst event],[over threshold]/
+					               // [worst call probe],[time],[last over threshold call probe],[time] (tePROFILE, PROFILE_MAX: none)/
+					               // [handler max per event, the order of teEVENT]/[bucket 0],[bucket 1],...,[bucket 19] (log2 buckets)
+						get_loop_stat(&loop_stat);
+						sprintf(trep, "%u,%u,%u,%u,%u,%u/%u,%u,%u,%u/", loop_stat.iteration_cnt, loop_stat.time_last, loop_stat.time_avg, loop_stat.time_max,
+								loop_stat.worst_event, loop_stat.over_cnt,
+								loop_stat.worst_probe, loop_stat.worst_probe_time, loop_stat.over_probe, loop_stat.over_probe_time);
+						trep += strlen(trep);
+						for(tmp_byte = 0; tmp_byte < EVENT_MAX; tmp_byte++)
+						{
+							sprintf(trep, "%s%u", (tmp_byte == 0)?"":",", loop_stat.handler_max[tmp_byte]);
+							trep += strlen(trep);
+						}
+						for(tmp_byte = 0; tmp_byte < LOOP_HIST_BUCKETS; tmp_byte++)
+						{
+							sprintf(trep, "%c%u", (tmp_byte == 0)?'/':',', loop_stat.bucket[tmp_byte]);
+							trep += strlen(trep);
+						}
+						break;
+					case SEGCP_LB: // Main loop iteration time threshold (usec), not saved
+						get_loop_stat(&loop_stat);
+						sprintf(trep, "%u", loop_stat.threshold);
+						break;
+					case SEGCP_BT: // Line-rate self-test; [state],[paths],[elapsed msec]/[UART]/[Network]:
+					               // [tx bytes],[rx bytes],[bit errors],[rx bytes/sec],[rtt min],[avg],[max] (usec)
+						sprintf(trep, "%d,%d,%u", get_bench_state(), get_bench_paths(), get_bench_elapsed_msec());
+						trep += strlen(trep);
+						for(tmp_byte = 0; tmp_byte < BENCH_PATH_MAX; tmp_byte++)
+						{
+							get_bench_stat(tmp_byte, &bench_stat);
+							sprintf(trep, "/%llu,%llu,%u,%u,%u,%u,%u", (unsigned long long)bench_stat.tx_bytes, (unsigned long long)bench_stat.rx_bytes,
+									bench_stat.bit_errors, bench_stat.rate, bench_stat.rtt_min, bench_stat.rtt_avg, bench_stat.rtt_max);
+							trep += strlen(trep);
+						}
+						break;
+					case SEGCP_TD: // Event trace dump, the next page from the cursor (TD0 rewinds); [ring],[first sequence number],[now usec]/
+					               // [record],[record],... up to TRACE_DUMP_RECORDS; record: [time usec 8][event 2][arg8 2][arg16 4] (hex)
+					               // The rings are dumped in order, the oldest record first; no record: the end of the dump
+						for(tmp_byte = 0; (trace_dump_ring < TRACE_RING_NUM) && (tmp_byte < TRACE_DUMP_RECORDS); )
+						{
+							if(get_trace_records(trace_dump_ring, trace_dump_seq, &trace_rec, 1, &trace_seq) == 0)
+							{
+								if(tmp_byte) break; // A page holds the records of one ring
+								trace_dump_ring++;
+								trace_dump_seq = 0;
+								continue;
+							}
+							
+							if(tmp_byte == 0)
+							{
+								sprintf(trep, "%d,%u,%u/", trace_dump_ring, trace_seq, get_timer_usec(get_timer_tick()));
+								trep += strlen(trep);
+							}
+							else if(trace_seq != trace_dump_seq) break; // Records overwritten during the dump: the next page starts from the gap
+							
+							sprintf(trep, "%s%08X%02X%02X%04X", (tmp_byte == 0)?"":",", trace_rec.time, trace_rec.event, trace_rec.arg8, trace_rec.arg16);
+							trep += strlen(trep);
+							trace_dump_seq = trace_seq + 1;
+							tmp_byte++;
+						}
+						if(tmp_byte == 0) sprintf(trep, "%d,%u,%u/", TRACE_RING_NUM, 0, get_timer_usec(get_timer_tick()));
+						break;
+					case SEGCP_RM: // RAM map (bytes); [total],[static RW data],[static ZI data],[heap],[stack],[free]/[stack high-water],[stack headroom]
+						if(!get_ram_map(&ram_map))
+						{
+							ret |= SEGCP_RET_ERR_NOTAVAIL;
+							break;
+						}
+						sprintf(trep, "%u,%u,%u,%u,%u,%u/%u,%u", ram_map.total, ram_map.data, ram_map.bss, ram_map.heap, ram_map.stack, ram_map.free,
+								ram_map.stack_used, ram_map.stack - ram_map.stack_used);
+						break;
 					default:
 						ret |= SEGCP_RET_ERR_NOCOMMAND;
 						sprintf(trep,"%s", strDEVSTATUS[dev_config->network_info[0].state]);
@@ -623,7 +973,7 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						break;
 					case SEGCP_OP: 
 						tmp_byte = is_hex(*param);
-						if(param_len != 1 || tmp_byte > UDP_MODE)
+						if(param_len != 1 || tmp_byte > MODBUS_GATEWAY_MODE)
 						{
 							ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						}
@@ -639,11 +989,11 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						tmp_byte = is_hex(*param);
 						if(param_len != 1 || tmp_byte > SEGCP_ENABLE) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						break;               
-					case SEGCP_PO: // ## Does nothing
-						//if(param_len != 1 || tmp_byte > SEGCP_TELNET) ret |= SEGCP_RET_ERR_INVALIDPARAM;
-						//else tsvDEVCONFnew.telnet_en[0] = tmp_byte;
+					case SEGCP_PO:
 						tmp_byte = is_hex(*param);
 						if(param_len != 1 || tmp_byte > SEGCP_TELNET) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else if(tmp_byte == SEGCP_TELNET) dev_config->network_option.option_flags |= NET_OPTION_TELNET_COM_PORT;
+						else dev_config->network_option.option_flags &= ~NET_OPTION_TELNET_COM_PORT;
 						break;
 					case SEGCP_CP:
 						tmp_byte = is_hex(*param);
@@ -661,17 +1011,48 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						else dev_config->network_info[0].keepalive_en = tmp_byte;
 						break;
 					case SEGCP_KI:
-						sscanf(param,"%ld", &tmp_long);
+						sscanf(param,"%lu", &tmp_long);
 						if(tmp_long > 0xFFFF) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else dev_config->network_info[0].keepalive_wait_time = (uint16_t) tmp_long;
 						break;
 					case SEGCP_KE:
-						sscanf(param,"%ld", &tmp_long);
+						sscanf(param,"%lu", &tmp_long);
 						if(tmp_long > 0xFFFF) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else dev_config->network_info[0].keepalive_retry_time = (uint16_t) tmp_long;
 						break;
+					case SEGCP_KM:
+						tmp_byte = is_hex(*param);
+						if(param_len != 1 || tmp_byte > SEGCP_ENABLE) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else if(tmp_byte == SEGCP_ENABLE) dev_config->network_option.option_flags |= NET_OPTION_KEEPALIVE_AUTO;
+						else dev_config->network_option.option_flags &= ~NET_OPTION_KEEPALIVE_AUTO;
+						break;
+					case SEGCP_FM:
+						tmp_byte = is_hex(*param);
+						if(param_len != 1 || tmp_byte > FRAME_MODE_TIMESTAMP) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else dev_config->network_option.frame_mode = tmp_byte;
+						break;
+					case SEGCP_SF:
+						tmp_byte = is_hex(*param);
+						if(param_len != 1 || tmp_byte > SEGCP_ENABLE) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else if(tmp_byte == SEGCP_ENABLE) dev_config->network_option.option_flags |= NET_OPTION_STORE_FORWARD;
+						else dev_config->network_option.option_flags &= ~NET_OPTION_STORE_FORWARD;
+						break;
+					case SEGCP_TI:
+						if(is_ipaddr(param, tmp_ip))
+						{
+							dev_config->network_option.telemetry_ip[0] = tmp_ip[0];
+							dev_config->network_option.telemetry_ip[1] = tmp_ip[1];
+							dev_config->network_option.telemetry_ip[2] = tmp_ip[2];
+							dev_config->network_option.telemetry_ip[3] = tmp_ip[3];
+						}
+						else ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						break;
+					case SEGCP_TN: // [1] / [2] / [5] / [10] / [30] / [60] / [300] / [600] sec
+						sscanf(param,"%lu", &tmp_long);
+						if(!set_telemetry_interval((tmp_long > 0xFFFF) ? 0 : (uint16_t)tmp_long)) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						break;
 					case SEGCP_RI:
-						sscanf(param,"%ld", &tmp_long);
+						sscanf(param,"%lu", &tmp_long);
 						if(tmp_long > 0xFFFF) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else dev_config->network_info[0].reconnection = (uint16_t) tmp_long;
 						break;
@@ -774,17 +1155,17 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 							}
 							else
 							{
-								sscanf(param, "%s", &dev_config->module_name);
+								sscanf(param, "%s", dev_config->module_name);
 							}
 						}
 						break;
 					case SEGCP_LP:
-						sscanf(param,"%ld", &tmp_long);
+						sscanf(param,"%lu", &tmp_long);
 						if(tmp_long > 0xFFFF) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else dev_config->network_info[0].local_port = (uint16_t)tmp_long;
 						break;
 					case SEGCP_RP:
-						sscanf(param,"%ld", &tmp_long);
+						sscanf(param,"%lu", &tmp_long);
 						if(tmp_long > 0xFFFF) ret |= SEGCP_RET_ERR_INVALIDPARAM;                  
 						else dev_config->network_info[0].remote_port = (uint16_t)tmp_long;
 						break;
@@ -806,7 +1187,7 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						
 						break;
 					case SEGCP_BR:
-						sscanf(param, "%d", &tmp_int);
+						sscanf(param, "%hu", &tmp_int);
 						if(param_len > 2 || tmp_int > baud_230400) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else dev_config->serial_info[0].baud_rate = (uint8_t)tmp_int;
 						break;
@@ -844,17 +1225,17 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						}
 						break;
 					case SEGCP_IT:
-						sscanf(param, "%ld", &tmp_long);
+						sscanf(param, "%lu", &tmp_long);
 						if(tmp_long > 0xFFFF) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else dev_config->network_info[0].inactivity = (uint16_t)tmp_long;
 						break;
 					case SEGCP_PT:
-						sscanf(param, "%ld", &tmp_long);
+						sscanf(param, "%lu", &tmp_long);
 						if(tmp_long > 0xFFFF) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else dev_config->network_info[0].packing_time = (uint16_t)tmp_long;
 						break;
 					case SEGCP_PS:
-						sscanf(param, "%d", &tmp_int);
+						sscanf(param, "%hu", &tmp_int);
 						if(param_len > 3 || tmp_int > 0xFF) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else dev_config->network_info[0].packing_size = (uint8_t)tmp_int;
 						break;
@@ -865,7 +1246,7 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						}
 						else
 						{
-							sscanf(param,"%x", &tmp_int);
+							sscanf(param,"%hx", &tmp_int);
 							dev_config->network_info[0].packing_delimiter[0] = (uint8_t)tmp_int;
 							
 							if(dev_config->network_info[0].packing_delimiter[0] == 0x00) 
@@ -906,11 +1287,11 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						else
 						{
 							if(param[0] == SEGCP_NULL) dev_config->options.pw_search[0] = 0;
-							else sscanf(param,"%s", &dev_config->options.pw_search);
+							else sscanf(param,"%s", dev_config->options.pw_search);
 						}
 						break;
 					case SEGCP_FW:
-						sscanf(param, "%ld", &tmp_long);
+						sscanf(param, "%lu", &tmp_long);
 #ifdef __USE_APPBACKUP_AREA__
 						if(tmp_long > (((uint32_t)DEVICE_FWUP_SIZE) & 0x0FFFF)) // 64KByte
 #else
@@ -963,7 +1344,7 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 					case SEGCP_CC:
 					case SEGCP_CD:
 						io_num = (teSEGCPCMDNUM)cmdnum - SEGCP_CA;
-						sscanf(param, "%x", &tmp_int);
+						sscanf(param, "%hx", &tmp_int);
 						
 						io_type = (uint8_t)(tmp_int >> 1);
 						io_dir = (uint8_t)(tmp_int & 0x01);
@@ -991,7 +1372,7 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 // Status Pins
 					// SET status pin mode selector
 					case SEGCP_SC:
-						sscanf(param, "%x", &tmp_int);
+						sscanf(param, "%hx", &tmp_int);
 						
 						tmp_byte = (uint8_t)((tmp_int & 0xF0) >> 4); // [0] PHY link / [1] DTR
 						tmp_int = (tmp_int & 0x0F); // [0] TCP connection / [1] DSR
@@ -1034,9 +1415,9 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						break;
 					
 					case SEGCP_FP: // Firmware update HTTP Server Port
-						sscanf(param, "%d", &tmp_int);
-						if(tmp_int > 0xffff) ret |= SEGCP_RET_ERR_INVALIDPARAM;
-						else dev_config->firmware_update_extend.fwup_server_port = tmp_int;
+						sscanf(param, "%lu", &tmp_long);
+						if(tmp_long > 0xffff) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else dev_config->firmware_update_extend.fwup_server_port = (uint16_t)tmp_long;
 						break;
 					
 					// Planned to apply
@@ -1063,10 +1444,75 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 						if(param_len != 1 || tmp_byte > SEGCP_ENABLE) ret |= SEGCP_RET_ERR_INVALIDPARAM;
 						else ; 
 						break;
+					case SEGCP_EV: // Main loop event statistics clear: EV0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_event_stat();
+						break;
+					case SEGCP_RB:
+						sscanf(param, "%lu", &tmp_long); // tmp_int is 16-bit: "%d" would write past it
+						if((param_len > 2) || (tmp_long > (RECONNECTION_BACKOFF_LIMIT / 1000))) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else dev_config->network_option.reconnect_backoff_max = (uint8_t)tmp_long;
+						break;
+					case SEGCP_RC: // TCP client reconnection statistics clear: RC0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_reconnect_stat();
+						break;
+					case SEGCP_LT: // L2 tunnel frame statistics clear: LT0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_l2tunnel_stat();
+						break;
+					case SEGCP_MG: // Modbus gateway statistics clear: MG0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_modbus_stat();
+						break;
+					case SEGCP_BS: // Store-and-forward statistics clear: BS0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_store_forward_stat();
+						break;
+					case SEGCP_LH: // Data path latency histograms clear: LH0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_latency_hist();
+						break;
+					case SEGCP_TS: // Data transfer statistics clear: TS0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_data_transfer_bytecount(SEG_ALL);
+						break;
+					case SEGCP_PF: // Hot-path profiler clear: PF0
+#ifdef _PROFILE_
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_profile_stat();
+#else
+						ret |= SEGCP_RET_ERR_NOTAVAIL;
+#endif
+						break;
+					case SEGCP_LM: // Main loop iteration statistics clear: LM0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else clear_loop_stat();
+						break;
+					case SEGCP_LB:
+						sscanf(param,"%lu", &tmp_long);
+						if((param_len > 7) || (tmp_long == 0)) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else set_loop_threshold((uint32_t)tmp_long);
+						break;
+					case SEGCP_BT: // Line-rate self-test: [0] Stop / [1] UART / [2] Network / [3] UART and Network
+						tmp_byte = is_hex(*param);
+						if(param_len != 1 || tmp_byte > (BENCH_PATH_UART | BENCH_PATH_NET)) ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else if(tmp_byte == 0) stop_bench();
+						else if(!start_bench(tmp_byte)) ret |= SEGCP_RET_ERR_NOTAVAIL;
+						break;
+					case SEGCP_TD: // Event trace dump rewind: TD0
+						if(param_len != 1 || param[0] != '0') ret |= SEGCP_RET_ERR_INVALIDPARAM;
+						else
+						{
+							trace_dump_ring = 0;
+							trace_dump_seq = 0;
+						}
+						break;
 
 					case SEGCP_UN:
 					case SEGCP_UI:
 					case SEGCP_ST:
+					case SEGCP_RM:
 					case SEGCP_LG:
 					case SEGCP_ER: 
 					case SEGCP_MA:
@@ -1100,6 +1546,7 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 			printf("ERROR : %s\r\n",trep);
 #endif
 			uart_rx_flush(SEG_DATA_UART);
+			CALL_PROBE_EXIT(PROFILE_PROC_SEGCP);
 			return ret;
 		}
 		
@@ -1113,14 +1560,221 @@ uint16_t proc_SEGCP(uint8_t* segcp_req, uint8_t* segcp_rep)
 	printf("\r\nEND of [proc_SEGCP] function - RET[0x%.4x]\r\n\r\n", ret);
 #endif
 	
+	CALL_PROBE_EXIT(PROFILE_PROC_SEGCP);
 	return ret;
 }
 
+// Search option lines (Q*) at req; ret: the position of the commands
+static uint8_t * parse_SEGCP_search(uint8_t * req, struct __segcp_search * search)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	uint8_t * mac = dev_config->network_info_common.mac;
+	uint8_t * param;
+	uint8_t * next;
+	uint8_t macstr[13];
+	uint16_t param_len;
+	uint16_t page;
+	uint16_t pages;
+	uint16_t i;
+
+	search->match = 1;
+	search->unicast = SEGCP_DISABLE;
+
+	while((req[0] == 'Q') && (req[1] != 0) && strchr("MNPDU", req[1]))
+	{
+		// The last line of the request has no '\n'; replaced by 0 after received
+		param = &req[2];
+		next = (uint8_t *)strchr((char *)param, '\r');
+		if(next == 0) next = param + strlen((char *)param);
+		param_len = (uint16_t)(next - param);
+		if(*next) *next++ = 0;
+		if(*next == '\n') next++;
+
+		switch(req[1])
+		{
+			case 'M':
+				sprintf(macstr, "%02X%02X%02X%02X%02X%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+				for(i = 0; i < param_len; i++) param[i] = toupper(param[i]);
+				if(param_len > 12 || !is_hexstr(param) || memcmp(macstr, param, param_len)) search->match = 0;
+				break;
+			case 'N':
+				if(param_len > strlen(dev_config->module_name) || memcmp(dev_config->module_name, param, param_len)) search->match = 0;
+				break;
+			case 'P':
+				if((sscanf(param, "%hu,%hu", &page, &pages) != 2) || (pages == 0) || (pages > SEGCP_SEARCH_PAGES_MAX) ||
+				   (((((uint16_t)mac[4] << 8) | mac[5]) % pages) != page)) search->match = 0;
+				break;
+			case 'D':
+				if(sscanf(param, "%hu", &search->delay_window) != 1) search->match = 0;
+				else if(search->delay_window > SEGCP_SEARCH_DELAY_MAX) search->delay_window = SEGCP_SEARCH_DELAY_MAX;
+				break;
+			case 'U':
+				if(param_len != 1 || param[0] > '1' || param[0] < '0') search->match = 0;
+				else search->unicast = param[0] - '0';
+				break;
+		}
+		req = next;
+	}
+	return req;
+}
+
+// delay_window 0: sent now / otherwise: written to the socket Tx buffer, sent by the main loop after a random delay in the window
+static void send_SEGCP_udp(uint8_t * rep, uint16_t len, uint8_t * destip, uint16_t destport, uint16_t delay_window)
+{
+	uint8_t * mac = get_DevConfig_pointer()->network_info_common.mac;
+	uint32_t r;
+
+	if(delay_window == 0)
+	{
+		CALL_PROBE_ENTER(PROFILE_SOCK_SEND);
+		sendto(SEGCP_UDP_SOCK, rep, len, destip, destport);
+		CALL_PROBE_EXIT(PROFILE_SOCK_SEND);
+		return;
+	}
+
+	// The devices booted together may have the same rand() sequence: the MAC address and the timer are mixed in
+	r = (uint32_t)rand() + get_timer_usec(get_timer_tick()) + ((((uint32_t)mac[4] << 8) | mac[5]) * 40503UL);
+
+	setSn_DIPR(SEGCP_UDP_SOCK, destip);
+	setSn_DPORT(SEGCP_UDP_SOCK, destport);
+	wiz_send_data(SEGCP_UDP_SOCK, rep, len);
+
+	segcp_reply_delay = (uint16_t)(r % delay_window);
+	flag_segcp_reply_pending = SEGCP_ENABLE;
+}
+
+// Completion is waited as sendto()
+static void send_SEGCP_udp_delayed(void)
+{
+	uint8_t ir;
+
+	setSn_CR(SEGCP_UDP_SOCK, Sn_CR_SEND);
+	while(getSn_CR(SEGCP_UDP_SOCK));
+
+	do {
+		ir = getSn_IR(SEGCP_UDP_SOCK);
+	} while(!(ir & (Sn_IR_SENDOK | Sn_IR_TIMEOUT)));
+	setSn_IR(SEGCP_UDP_SOCK, ir & (Sn_IR_SENDOK | Sn_IR_TIMEOUT));
+
+	flag_segcp_reply_pending = SEGCP_DISABLE;
+}
+
+static void backup_SEGCP_settings(struct __segcp_settings_bak * bak)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	
+	memcpy(bak->module_name, dev_config->module_name, sizeof(bak->module_name));
+	bak->network_info_common = dev_config->network_info_common;
+	bak->network_info = dev_config->network_info[0];
+	bak->serial_info = dev_config->serial_info[0];
+	bak->options = dev_config->options;
+	bak->user_io_info = dev_config->user_io_info;
+	bak->firmware_update = dev_config->firmware_update;
+	bak->fwup_server_flag = dev_config->firmware_update_extend.fwup_server_flag;
+	bak->fwup_server_port = dev_config->firmware_update_extend.fwup_server_port;
+	bak->fwup_server_use_default = dev_config->firmware_update_extend.fwup_server_use_default;
+	bak->network_option = dev_config->network_option;
+}
+
+// The connection state (run-time) is kept
+static void restore_SEGCP_settings(struct __segcp_settings_bak * bak)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	uint8_t state = dev_config->network_info[0].state;
+	
+	memcpy(dev_config->module_name, bak->module_name, sizeof(bak->module_name));
+	dev_config->network_info_common = bak->network_info_common;
+	dev_config->network_info[0] = bak->network_info;
+	dev_config->network_info[0].state = state;
+	dev_config->serial_info[0] = bak->serial_info;
+	dev_config->options = bak->options;
+	dev_config->user_io_info = bak->user_io_info;
+	dev_config->firmware_update = bak->firmware_update;
+	dev_config->firmware_update_extend.fwup_server_flag = bak->fwup_server_flag;
+	dev_config->firmware_update_extend.fwup_server_port = bak->fwup_server_port;
+	dev_config->firmware_update_extend.fwup_server_use_default = bak->fwup_server_use_default;
+	dev_config->network_option = bak->network_option;
+}
+
+// Applies the settings changed by a request without the reboot; a request with an error is rolled back (read-only commands excepted).
+// UART: re-initialized after the last character is transmitted (the reply included)
+// Data socket: closed by the previous mode, reopened by the S2E state machine with the new mode / ports (and the Modbus socket)
+// The packing, inactivity and reconnection options are read by the S2E loop; the new values take effect at the next iteration.
+// The IP address, DHCP and DNS settings are applied after the reboot.
+static uint16_t apply_SEGCP_settings(struct __segcp_settings_bak * bak, uint16_t segcp_ret)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	struct __serial_info *serial = &dev_config->serial_info[0];
+	struct __network_info *net = &dev_config->network_info[0];
+	struct __network_option *netopt = &dev_config->network_option;
+	struct __serial_info *serial_bak = &bak->serial_info;
+	struct __network_info *net_bak = &bak->network_info;
+	struct __network_option *netopt_bak = &bak->network_option;
+	uint32_t tick;
+	uint32_t wait_usec;
+	uint8_t working_mode;
+	uint8_t apply_serial;
+	uint8_t apply_socket;
+	
+	if((segcp_ret & SEGCP_RET_ERR) && ((segcp_ret & 0x7F00) != (SEGCP_ER_IGNORED << 8)))
+	{
+		restore_SEGCP_settings(bak);
+		return segcp_ret;
+	}
+	
+	// Applied by the reboot / firmware update
+	if(segcp_ret & (SEGCP_RET_REBOOT | SEGCP_RET_FWUP | SEGCP_RET_FACTORY))
+	{
+		backup_SEGCP_settings(bak);
+		return segcp_ret;
+	}
+	
+	apply_serial = ((serial->baud_rate != serial_bak->baud_rate) || (serial->data_bits != serial_bak->data_bits) ||
+					(serial->parity != serial_bak->parity) || (serial->stop_bits != serial_bak->stop_bits) ||
+					(serial->flow_control != serial_bak->flow_control));
+	
+	apply_socket = ((net->working_mode != net_bak->working_mode) || (memcmp(net->remote_ip, net_bak->remote_ip, 4) != 0) ||
+					(net->local_port != net_bak->local_port) || (net->remote_port != net_bak->remote_port) ||
+					(net->keepalive_en != net_bak->keepalive_en) || (net->keepalive_wait_time != net_bak->keepalive_wait_time) ||
+					(net->keepalive_retry_time != net_bak->keepalive_retry_time) ||
+					(netopt->frame_mode != netopt_bak->frame_mode) ||
+					((netopt->option_flags ^ netopt_bak->option_flags) & (NET_OPTION_KEEPALIVE_AUTO | NET_OPTION_TELNET_COM_PORT)));
+	
+	if(apply_serial)
+	{
+		// Wait for the last character transmitted at the previous settings
+		tick = get_timer_tick();
+		wait_usec = get_uart_char_time(serial_bak) * SEGCP_UART_TX_WAIT_CHARS;
+		while((UART_GetFlagStatus(UART_data, UART_FLAG_BUSY) == SET) && (timer_tick_to_usec(get_timer_tick() - tick) < wait_usec));
+		serial_info_init(UART_data, serial);
+	}
+	
+	if(apply_socket)
+	{
+		// Closed as the previous mode opened it (e.g., TCP disconnect, Modbus gateway master socket)
+		working_mode = net->working_mode;
+		net->working_mode = net_bak->working_mode;
+		process_socket_termination(SEG_SOCK);
+		net->working_mode = working_mode;
+		
+		if(opmode == DEVICE_GW_MODE) set_device_status(ST_OPEN); // Not a connection lost: no reconnection outage
+	}
+	
+	if((apply_serial || apply_socket) && (serial->serial_debug_en == SEGCP_ENABLE))
+	{
+		printf(" > SEGCP:APPLY:%s%s\r\n", apply_serial ? " SERIAL" : "", apply_socket ? " SOCKET" : "");
+	}
+	
+	backup_SEGCP_settings(bak); // serial_info_init() may correct the invalid values
+	
+	return segcp_ret;
+}
+
 uint16_t proc_SEGCP_udp(uint8_t* segcp_req, uint8_t* segcp_rep)
 {
 	DevConfig *dev_config = get_DevConfig_pointer();
 	
-	uint8_t ret = 0;
+	uint16_t ret = 0;
 	uint16_t len = 0;
 	//uint16_t i = 0;
 	
@@ -1131,15 +1785,35 @@ uint16_t proc_SEGCP_udp(uint8_t* segcp_req, uint8_t* segcp_rep)
 	uint8_t* treq;
 	uint8_t* trep;
 	
+	struct __segcp_search search;
+	
 	gSEGCPPRIVILEGE = SEGCP_PRIVILEGE_CLR;
 	switch(getSn_SR(SEGCP_UDP_SOCK))
 	{
 		case SOCK_UDP:
+			if(flag_segcp_reply_pending)
+			{
+				if(segcp_reply_delay) break;
+				send_SEGCP_udp_delayed();
+			}
+			
 			if((len = getSn_RX_RSR(SEGCP_UDP_SOCK)) > 0)
 			{
 				treq = segcp_req;
 				trep = segcp_rep;
 				len = recvfrom(SEGCP_UDP_SOCK, treq, len, destip, &destport);
+				
+				// Binary TLV request (segcptlv.h)
+				if(is_SEGCP_tlv(treq, len))
+				{
+					// The device MAC: replied to the requester without the search delay, as the write privilege of the ASCII requests
+					search.unicast = (memcmp(&treq[6], "\xFF\xFF\xFF\xFF\xFF\xFF", 6) != 0) || (treq[3] & SEGCP_TLV_FLAG_UNICAST);
+					search.delay_window = memcmp(&treq[6], "\xFF\xFF\xFF\xFF\xFF\xFF", 6) ? 0 : SEGCP_SEARCH_DELAY_DEFAULT;
+					ret = proc_SEGCP_tlv(treq, len, trep, &len);
+					if(len) send_SEGCP_udp(trep, len, search.unicast ? destip : (uint8_t *)"\xFF\xFF\xFF\xFF", destport, search.delay_window);
+					break;
+				}
+				
 				treq[len-1] = 0;
 
 				if(SEGCP_MA == parse_SEGCP(treq, tpar))
@@ -1168,9 +1842,13 @@ uint16_t proc_SEGCP_udp(uint8_t* segcp_req, uint8_t* segcp_rep)
 								//printf(" >> treq: [%s]\r\n", treq);
 								//printf(" >> trep: [%s]\r\n", trep);
 								
+								// Search options; the search by the broadcast MAC is delayed by default
+								search.delay_window = (gSEGCPPRIVILEGE & SEGCP_PRIVILEGE_WRITE) ? 0 : SEGCP_SEARCH_DELAY_DEFAULT;
+								treq = parse_SEGCP_search(treq, &search);
+								if(!search.match) return 0;
+								
 								ret = proc_SEGCP(treq,trep);
-								sendto(SEGCP_UDP_SOCK, segcp_rep, 14+strlen(tpar)+strlen(trep), "\xFF\xFF\xFF\xFF", destport);
-								//sendto(SEGCP_UDP_SOCK, segcp_rep, 14+strlen(tpar)+strlen(trep), destip, destport);
+								send_SEGCP_udp(segcp_rep, 14+strlen(tpar)+strlen(trep), search.unicast ? destip : (uint8_t *)"\xFF\xFF\xFF\xFF", destport, search.delay_window);
 							}
 						}
 						
@@ -1190,6 +1868,7 @@ uint16_t proc_SEGCP_udp(uint8_t* segcp_req, uint8_t* segcp_rep)
 			}
 			break;
 		case SOCK_CLOSED:
+			flag_segcp_reply_pending = SEGCP_DISABLE;
 			if(socket(SEGCP_UDP_SOCK, Sn_MR_UDP, DEVICE_SEGCP_PORT, 0x00) == SEGCP_UDP_SOCK)
 			{
 				;//if(dev_config->serial_info[0].serial_debug_en == SEGCP_ENABLE) printf(" > SEGCP:UDP:STARTED\r\n");
@@ -1245,6 +1924,20 @@ uint16_t proc_SEGCP_tcp(uint8_t* segcp_req, uint8_t* segcp_rep)
 				treq = segcp_req;
 				trep = segcp_rep;
 				len = recv(SEGCP_TCP_SOCK,treq,len);
+				
+				// Binary TLV request (segcptlv.h)
+				if(is_SEGCP_tlv(treq, len))
+				{
+					ret = proc_SEGCP_tlv(treq, len, trep, &len);
+					if(len)
+					{
+						CALL_PROBE_ENTER(PROFILE_SOCK_SEND);
+						send(SEGCP_TCP_SOCK, trep, len);
+						CALL_PROBE_EXIT(PROFILE_SOCK_SEND);
+					}
+					break;
+				}
+				
 				treq[len-1] = 0x00;
 
 				if(SEGCP_MA == parse_SEGCP(treq,tpar))
@@ -1270,7 +1963,9 @@ uint16_t proc_SEGCP_tcp(uint8_t* segcp_req, uint8_t* segcp_rep)
 								treq += (strlen(tpar) + 4);
 								trep += (strlen(tpar) + 4);
 								ret = proc_SEGCP(treq,trep);
+								CALL_PROBE_ENTER(PROFILE_SOCK_SEND);
 								send(SEGCP_TCP_SOCK, segcp_rep, 14+strlen(tpar)+strlen(trep));
+								CALL_PROBE_EXIT(PROFILE_SOCK_SEND);
 							}
 						}
 					}
@@ -1312,18 +2007,17 @@ uint16_t proc_SEGCP_uart(uint8_t * segcp_rep)
 {
 	DevConfig *dev_config = get_DevConfig_pointer();
 	
-	uint16_t len = 0;
 	uint16_t ret = 0;
-	uint8_t segcp_req[SEGCP_PARAM_MAX*2];
+	
+	flag_segcp_uart_line = SEGCP_DISABLE;
 	
 	if(BUFFER_USED_SIZE(data_rx))
 	{
-		len = uart_get_commandline(SEG_DATA_UART, segcp_req, (sizeof(segcp_req) - 1));
-		
-		if(len != 0)
+		if(get_SEGCP_uart_line(SEG_DATA_UART) != 0)
 		{
+			flag_segcp_uart_line = SEGCP_ENABLE;
 			gSEGCPPRIVILEGE = SEGCP_PRIVILEGE_SET | SEGCP_PRIVILEGE_WRITE;
-			ret = proc_SEGCP(segcp_req, segcp_rep);
+			ret = proc_SEGCP(segcp_uart_line, segcp_rep);
 			if(segcp_rep[0])
 			{
 				if(dev_config->serial_info[0].serial_debug_en == SEGCP_ENABLE)
@@ -1331,7 +2025,9 @@ uint16_t proc_SEGCP_uart(uint8_t * segcp_rep)
 					printf("%s",segcp_rep);
 				}
 				
+				CALL_PROBE_ENTER(PROFILE_UART_PUTS);
 				uart_puts(SEG_DATA_UART, segcp_rep, strlen(segcp_rep));
+				CALL_PROBE_EXIT(PROFILE_UART_PUTS);
 				
 			}
 		}
@@ -1339,44 +2035,36 @@ uint16_t proc_SEGCP_uart(uint8_t * segcp_rep)
 	return ret;
 }
 
-uint16_t uart_get_commandline(uint8_t uartNum, uint8_t* buf, uint16_t maxSize)
+// Incremental command line assembly: the received bytes are consumed up to the end of a line without waiting for the rest
+// ret: string length of the completed line (segcp_uart_line), [0] not completed yet
+static uint16_t get_SEGCP_uart_line(uint8_t uartNum)
 {
 	DevConfig *dev_config = get_DevConfig_pointer();
 	
-	uint16_t i;
-	//uint16_t j;
-	uint16_t len = BUFFER_USED_SIZE(data_rx);
+	int32_t ch;
+	uint16_t len;
 	
-	if(len >= 4) // Minimum of command: 4-bytes, e.g., MC\r\n (MC$0d$0a)
+	while((ch = uart_getc_nonblk(uartNum)) != RET_NOK)
 	{
-		for(i = 0; i < maxSize; i++)
-		{
-			buf[i] = uart_getc(uartNum);
-			//if(buf[i] == '\n') break;	// [\n]: end of command
-			if(buf[i] == 0x0a) break;	// [0x0a]: end of command (Line feed)
-		}
-		buf[i+1] = 0x00; // end of string
-		//buf[i] = 0x00; // end of string
-		
-		/*
-		// for debugging
-		printf("==>> [%d] ", strlen(buf));
-		for(i = 0; i < strlen(buf); i++) printf("%c [0x%.2x] ", buf[i], buf[i]); //printf("%c ", buf[i]);
-		printf("\r\n");
-		*/
+		segcp_uart_line[segcp_uart_len++] = (uint8_t)ch;
 		
-		if(dev_config->options.serial_command_echo == SEGCP_ENABLE)
+		// [0x0a]: end of command (Line feed); a line longer than the buffer is cut and processed as it is
+		if((ch == 0x0a) || (segcp_uart_len >= (sizeof(segcp_uart_line) - 1)))
 		{
-			//for(j = 0; j < i; j++) uart_putc(uartNum, buf[j]);
-			uart_puts(uartNum, buf, i);
+			segcp_uart_line[segcp_uart_len] = 0x00; // end of string
+			len = (ch == 0x0a) ? (segcp_uart_len - 1) : segcp_uart_len;
+			segcp_uart_len = 0;
+			
+			if(dev_config->options.serial_command_echo == SEGCP_ENABLE)
+			{
+				uart_puts(uartNum, segcp_uart_line, len);
+			}
+			
+			return strlen(segcp_uart_line);
 		}
 	}
-	else
-	{
-		return 0;
-	}
 	
-	return strlen(buf);
+	return 0;
 }
 
 void send_keepalive_packet_configtool(uint8_t sock)
@@ -1389,8 +2077,10 @@ void send_keepalive_packet_configtool(uint8_t sock)
 }
 
 // Function for Timer
-void segcp_timer_msec(void)
+uint8_t segcp_timer_msec(void)
 {
+	if(segcp_reply_delay) segcp_reply_delay--;
+	
 	if(enable_configtool_keepalive_timer)
 	{
 		if(configtool_keepalive_time < 0xFFFF) 	configtool_keepalive_time++;
@@ -1402,5 +2092,41 @@ void segcp_timer_msec(void)
 			configtool_keepalive_time = 0;
 		}
 	}
+	
+	return is_segcp_timer_event();
+}
+
+// Timed jobs of SEGCP, checked every millisecond by the timer interrupt; the requests are started by the socket / UART interrupts.
+// The TCP connection (Sn_IR_CON) and the socket re-open are polled: a socket in transition is serviced every millisecond.
+static uint8_t is_segcp_timer_event(void)
+{
+	uint8_t sock_status;
+	
+	// Delayed search reply; the requests received meanwhile wait in the Rx buffer, the requests left by a pass are taken at once
+	if(flag_segcp_reply_pending)
+	{
+		if(segcp_reply_delay == 0) return SEGCP_ENABLE;
+	}
+	else if(getSn_RX_RSR(SEGCP_UDP_SOCK))
+	{
+		return SEGCP_ENABLE;
+	}
+	
+	if(flag_send_configtool_keepalive) return SEGCP_ENABLE;
+	if((opmode == DEVICE_AT_MODE) && !IS_BUFFER_EMPTY(data_rx)) return SEGCP_ENABLE; // Command lines left by a pass
+	
+	if(getSn_SR(SEGCP_UDP_SOCK) != SOCK_UDP) return SEGCP_ENABLE;
+	
+	sock_status = getSn_SR(SEGCP_TCP_SOCK);
+	if(sock_status == SOCK_ESTABLISHED)
+	{
+		if((getSn_IR(SEGCP_TCP_SOCK) & Sn_IR_CON) || getSn_RX_RSR(SEGCP_TCP_SOCK)) return SEGCP_ENABLE;
+	}
+	else if(sock_status != SOCK_LISTEN)
+	{
+		return SEGCP_ENABLE;
+	}
+	
+	return SEGCP_DISABLE;
 }
 
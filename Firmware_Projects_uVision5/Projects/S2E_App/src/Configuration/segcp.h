@@ -24,7 +24,9 @@ typedef enum {SEGCP_MC, SEGCP_VR, SEGCP_MN, SEGCP_IM, SEGCP_OP, SEGCP_DD, SEGCP_
               SEGCP_LG, SEGCP_ER, SEGCP_FW, SEGCP_MA, SEGCP_PW, SEGCP_SV, SEGCP_EX, SEGCP_RT, SEGCP_UN, SEGCP_ST, 
               SEGCP_FR, SEGCP_EC, SEGCP_K1, SEGCP_UE, SEGCP_GA, SEGCP_GB, SEGCP_GC, SEGCP_GD, SEGCP_CA, SEGCP_CB,
               SEGCP_CC, SEGCP_CD, SEGCP_SC, SEGCP_S0, SEGCP_S1, SEGCP_RX, SEGCP_FS, SEGCP_FC, SEGCP_FP, SEGCP_FD,
-              SEGCP_FH, SEGCP_UI, SEGCP_UNKNOWN=255
+              SEGCP_FH, SEGCP_UI, SEGCP_EV, SEGCP_RB, SEGCP_RC,
+              SEGCP_KM, SEGCP_LT, SEGCP_FM, SEGCP_MG, SEGCP_SF, SEGCP_BS, SEGCP_LH, SEGCP_PF, SEGCP_TS,
+              SEGCP_TI, SEGCP_TN, SEGCP_LM, SEGCP_LB, SEGCP_BT, SEGCP_TD, SEGCP_RM, SEGCP_UNKNOWN=255
 } teSEGCPCMDNUM;
 
 /*
@@ -113,6 +115,17 @@ typedef enum {SEGCP_MC, SEGCP_VR, SEGCP_MN, SEGCP_IM, SEGCP_OP, SEGCP_DD, SEGCP_
 #define SEGCP_PRIVILEGE_WRITE 0x08
 
 #define CONFIGTOOL_KEEPALIVE_TIME_MS	15000 // unit:ms, used by TCP unicast search function only.
+
+// UDP search (broadcast MAC): the reply is sent after a random delay in the window, the replies of the devices are spread out.
+// Search options: the lines between the PW line and the commands, UDP only; not included in the reply
+//   QM<MAC address prefix>    Replies only if the MAC address starts with the hex digits, e.g., QM0008DC1
+//   QN<name prefix>           Replies only if the device name (DH, without the MAC suffix) starts with the prefix
+//   QP<page>,<pages>          Replies only if (MAC address low 16 bits % pages) == page; a large fleet is searched page by page
+//   QD<msec>                  Reply delay window; 0: no delay
+//   QU<0|1>                   Reply to: [0] broadcast (default) / [1] the requester (unicast)
+#define SEGCP_SEARCH_DELAY_DEFAULT		200		// msec
+#define SEGCP_SEARCH_DELAY_MAX			10000	// msec
+#define SEGCP_SEARCH_PAGES_MAX			256
 #define PW_ERASE_CONFIG_DATA			"wiznet"
 
 
@@ -130,5 +143,5 @@ uint16_t proc_SEGCP_uart(uint8_t * segcp_rep);
 
 void send_keepalive_packet_configtool(uint8_t sock);
 
-void segcp_timer_msec(void); // for timer
+uint8_t segcp_timer_msec(void); // for timer; ret: [SEGCP_ENABLE] SEGCP job due
 #endif
@@ -0,0 +1,312 @@
+#include <stddef.h>
+#include <string.h>
+#include "common.h"
+#include "ConfigData.h"
+#include "seg.h"
+#include "segcp.h"
+#include "segcptlv.h"
+#include "segmodbus.h"
+#include "uartHandler.h"
+
+/* Private typedef -----------------------------------------------------------*/
+// Value type of a field
+#define TLV_TYPE_U8				0
+#define TLV_TYPE_U16			1		// Big-endian on the wire
+#define TLV_TYPE_BYTES			2		// Fixed size
+#define TLV_TYPE_STR			3		// Null-terminated in DevConfig; the characters only on the wire
+#define TLV_TYPE_BITS			4		// 1 byte bit flags
+#define TLV_TYPE_MASK			0x0F
+#define TLV_RO					0x80
+
+struct __tlv_field {
+	uint8_t id;						// teSEGCPTLV
+	uint8_t type;					// TLV_TYPE_* | TLV_RO
+	uint8_t size;					// Size in DevConfig
+	uint8_t max;					// TLV_TYPE_U8: maximum value / TLV_TYPE_BITS: valid bits
+	uint16_t offset;				// Offset in DevConfig
+};
+
+#define CFG_OFS(m)				offsetof(DevConfig, m)
+#define NET_OFS(m)				(offsetof(DevConfig, network_info) + offsetof(struct __network_info, m))
+#define SER_OFS(m)				(offsetof(DevConfig, serial_info) + offsetof(struct __serial_info, m))
+#define CFG_SIZE(s, m)			sizeof(((s *)0)->m)
+
+#define TLV_U8(id, ofs, max)	{id, TLV_TYPE_U8, 1, max, ofs}
+#define TLV_U16(id, ofs)		{id, TLV_TYPE_U16, 2, 0, ofs}
+
+/* Private variables ---------------------------------------------------------*/
+static const struct __tlv_field tlv_field_table[] = {
+	{TLV_MAC,            TLV_TYPE_BYTES | TLV_RO, 6, 0, CFG_OFS(network_info_common.mac)},
+	{TLV_FW_VER,         TLV_TYPE_BYTES | TLV_RO, 3, 0, CFG_OFS(fw_ver)},
+	{TLV_MODULE_TYPE,    TLV_TYPE_BYTES | TLV_RO, 3, 0, CFG_OFS(module_type)},
+	{TLV_MODULE_NAME,    TLV_TYPE_STR, CFG_SIZE(DevConfig, module_name), 0, CFG_OFS(module_name)},
+	{TLV_UART_INTERFACE, TLV_TYPE_U8 | TLV_RO, 1, 0xFF, SER_OFS(uart_interface)},
+
+	{TLV_LOCAL_IP,       TLV_TYPE_BYTES, 4, 0, CFG_OFS(network_info_common.local_ip)},
+	{TLV_GATEWAY,        TLV_TYPE_BYTES, 4, 0, CFG_OFS(network_info_common.gateway)},
+	{TLV_SUBNET,         TLV_TYPE_BYTES, 4, 0, CFG_OFS(network_info_common.subnet)},
+	TLV_U8(TLV_DHCP_USE, CFG_OFS(options.dhcp_use), SEGCP_DHCP),
+	{TLV_DNS_SERVER_IP,  TLV_TYPE_BYTES, 4, 0, CFG_OFS(options.dns_server_ip)},
+	TLV_U8(TLV_DNS_USE,  CFG_OFS(options.dns_use), SEGCP_ENABLE),
+	{TLV_DNS_DOMAIN_NAME, TLV_TYPE_STR, CFG_SIZE(DevConfig, options.dns_domain_name), 0, CFG_OFS(options.dns_domain_name)},
+
+	TLV_U8(TLV_WORKING_MODE, NET_OFS(working_mode), MODBUS_GATEWAY_MODE),
+	{TLV_REMOTE_IP,      TLV_TYPE_BYTES, 4, 0, NET_OFS(remote_ip)},
+	TLV_U16(TLV_LOCAL_PORT, NET_OFS(local_port)),
+	TLV_U16(TLV_REMOTE_PORT, NET_OFS(remote_port)),
+	TLV_U16(TLV_INACTIVITY, NET_OFS(inactivity)),
+	TLV_U16(TLV_RECONNECTION, NET_OFS(reconnection)),
+	TLV_U16(TLV_PACKING_TIME, NET_OFS(packing_time)),
+	TLV_U8(TLV_PACKING_SIZE, NET_OFS(packing_size), 0xFF),
+	{TLV_PACKING_DELIMITER, TLV_TYPE_BYTES, 4, 0, NET_OFS(packing_delimiter)},
+	TLV_U8(TLV_PACKING_DELIMITER_LEN, NET_OFS(packing_delimiter_length), 4),
+	TLV_U8(TLV_PACKING_APPENDIX, NET_OFS(packing_data_appendix), 2),
+	TLV_U8(TLV_KEEPALIVE_EN, NET_OFS(keepalive_en), SEGCP_ENABLE),
+	TLV_U16(TLV_KEEPALIVE_WAIT, NET_OFS(keepalive_wait_time)),
+	TLV_U16(TLV_KEEPALIVE_RETRY, NET_OFS(keepalive_retry_time)),
+
+	TLV_U8(TLV_BAUD_RATE, SER_OFS(baud_rate), baud_230400),
+	TLV_U8(TLV_DATA_BITS, SER_OFS(data_bits), word_len8),
+	TLV_U8(TLV_PARITY, SER_OFS(parity), parity_even),
+	TLV_U8(TLV_STOP_BITS, SER_OFS(stop_bits), stop_bit2),
+	TLV_U8(TLV_FLOW_CONTROL, SER_OFS(flow_control), flow_rts_cts),
+	TLV_U8(TLV_DTR_EN, SER_OFS(dtr_en), SEGCP_ENABLE),
+	TLV_U8(TLV_DSR_EN, SER_OFS(dsr_en), SEGCP_ENABLE),
+	TLV_U8(TLV_SERIAL_DEBUG, SER_OFS(serial_debug_en), SEGCP_ENABLE),
+
+	{TLV_PW_CONNECT,     TLV_TYPE_STR, CFG_SIZE(DevConfig, options.pw_connect), 0, CFG_OFS(options.pw_connect)},
+	{TLV_PW_SEARCH,      TLV_TYPE_STR, CFG_SIZE(DevConfig, options.pw_search), 0, CFG_OFS(options.pw_search)},
+	TLV_U8(TLV_PW_CONNECT_EN, CFG_OFS(options.pw_connect_en), SEGCP_ENABLE),
+	TLV_U8(TLV_SERIAL_COMMAND, CFG_OFS(options.serial_command), SEGCP_ENABLE),
+	TLV_U8(TLV_SERIAL_COMMAND_ECHO, CFG_OFS(options.serial_command_echo), SEGCP_ENABLE),
+	{TLV_SERIAL_TRIGGER, TLV_TYPE_BYTES, 3, 0, CFG_OFS(options.serial_trigger)},
+
+	TLV_U8(TLV_RECONNECT_BACKOFF_MAX, CFG_OFS(network_option.reconnect_backoff_max), 0xFF),
+	{TLV_OPTION_FLAGS,   TLV_TYPE_BITS, 1,
+		NET_OPTION_KEEPALIVE_AUTO | NET_OPTION_TELNET_COM_PORT | NET_OPTION_STORE_FORWARD | NET_OPTION_TELEMETRY_INTERVAL,
+		CFG_OFS(network_option.option_flags)},
+	TLV_U8(TLV_FRAME_MODE, CFG_OFS(network_option.frame_mode), FRAME_MODE_TIMESTAMP),
+	{TLV_TELEMETRY_IP,   TLV_TYPE_BYTES, 4, 0, CFG_OFS(network_option.telemetry_ip)}
+};
+
+#define TLV_FIELD_NUM			(sizeof(tlv_field_table) / sizeof(tlv_field_table[0]))
+
+/* Private functions prototypes ----------------------------------------------*/
+static const struct __tlv_field * find_tlv_field(uint8_t id);
+static uint8_t * put_tlv_field(uint8_t * p, uint8_t * end, const struct __tlv_field * f);
+static uint8_t check_tlv_value(const struct __tlv_field * f, const uint8_t * val, uint8_t len);
+static void set_tlv_value(const struct __tlv_field * f, const uint8_t * val, uint8_t len);
+
+/* Public functions ----------------------------------------------------------*/
+uint8_t is_SEGCP_tlv(uint8_t * req, uint16_t len)
+{
+	return ((len >= 2) && (req[0] == SEGCP_TLV_MAGIC_0) && (req[1] == SEGCP_TLV_MAGIC_1));
+}
+
+uint16_t proc_SEGCP_tlv(uint8_t * req, uint16_t len, uint8_t * rep, uint16_t * rep_len)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	const struct __tlv_field * f;
+	uint8_t privilege;
+	uint8_t pw_len;
+	uint8_t op;
+	uint8_t * tlv;
+	uint16_t tlv_len;
+	uint16_t i;
+	uint8_t * p = rep + SEGCP_TLV_REP_HEADER_LEN;
+	uint8_t * end = rep + CONFIG_BUF_SIZE - SEGCP_TLV_CRC_LEN;
+	uint8_t status = SEGCP_ER_NULL;
+	uint8_t err_id = 0;
+	uint16_t ret = 0;
+	uint16_t crc;
+
+	*rep_len = 0;
+
+	// Packet check; discarded without a reply, as the ASCII requests with a wrong MAC address or password
+	if(len < (SEGCP_TLV_REQ_HEADER_LEN + SEGCP_TLV_CRC_LEN) || req[2] != SEGCP_TLV_VERSION) return 0;
+	crc = crc16_modbus(req, len - SEGCP_TLV_CRC_LEN);
+	if(req[len - 2] != (uint8_t)crc || req[len - 1] != (uint8_t)(crc >> 8)) return 0;
+
+	if(!memcmp(&req[6], "\xFF\xFF\xFF\xFF\xFF\xFF", 6)) privilege = SEGCP_PRIVILEGE_READ;
+	else if(!memcmp(&req[6], dev_config->network_info_common.mac, 6)) privilege = SEGCP_PRIVILEGE_WRITE;
+	else return 0;
+
+	pw_len = req[SEGCP_TLV_REQ_HEADER_LEN - 1];
+	if((SEGCP_TLV_REQ_HEADER_LEN + pw_len + SEGCP_TLV_CRC_LEN) > len) return 0;
+	if(pw_len != strlen(dev_config->options.pw_search) || memcmp(&req[SEGCP_TLV_REQ_HEADER_LEN], dev_config->options.pw_search, pw_len)) return 0;
+
+	op = req[3];
+	tlv = &req[SEGCP_TLV_REQ_HEADER_LEN + pw_len];
+	tlv_len = len - SEGCP_TLV_REQ_HEADER_LEN - pw_len - SEGCP_TLV_CRC_LEN;
+
+	// TLV list check: the value must be in the packet
+	for(i = 0; i < tlv_len; i += (2 + tlv[i + 1]))
+	{
+		if((i + 2) > tlv_len || (i + 2 + tlv[i + 1]) > tlv_len)
+		{
+			status = SEGCP_ER_INVALIDPARAM;
+			err_id = tlv[i];
+			break;
+		}
+	}
+
+	if(status == SEGCP_ER_NULL)
+	{
+		switch(op & SEGCP_TLV_OP_MASK)
+		{
+			case SEGCP_TLV_OP_GET:
+				if(tlv_len == 0)
+				{
+					for(i = 0; (i < TLV_FIELD_NUM) && p; i++) p = put_tlv_field(p, end, &tlv_field_table[i]);
+					if(!p) status = SEGCP_ER_IGNORED;
+				}
+				for(i = 0; (i < tlv_len) && (status == SEGCP_ER_NULL); i += (2 + tlv[i + 1]))
+				{
+					if((f = find_tlv_field(tlv[i])) == 0) status = SEGCP_ER_NOCOMMAND;
+					else if((p = put_tlv_field(p, end, f)) == 0) status = SEGCP_ER_IGNORED; // Reply buffer full
+					if(status != SEGCP_ER_NULL) err_id = tlv[i];
+				}
+				break;
+
+			case SEGCP_TLV_OP_SET:
+				if(privilege != SEGCP_PRIVILEGE_WRITE)
+				{
+					status = SEGCP_ER_NOPRIVILEGE;
+					break;
+				}
+
+				// All or nothing: checked before any field is written
+				for(i = 0; (i < tlv_len) && (status == SEGCP_ER_NULL); i += (2 + tlv[i + 1]))
+				{
+					if((f = find_tlv_field(tlv[i])) == 0) status = SEGCP_ER_NOCOMMAND;
+					else status = check_tlv_value(f, &tlv[i + 2], tlv[i + 1]);
+					if(status != SEGCP_ER_NULL) err_id = tlv[i];
+				}
+				if(status != SEGCP_ER_NULL) break;
+
+				for(i = 0; i < tlv_len; i += (2 + tlv[i + 1])) set_tlv_value(find_tlv_field(tlv[i]), &tlv[i + 2], tlv[i + 1]);
+
+				if(op & SEGCP_TLV_FLAG_SAVE) ret |= SEGCP_RET_SAVE;
+				if(op & SEGCP_TLV_FLAG_REBOOT) ret |= SEGCP_RET_REBOOT;
+				break;
+
+			default:
+				status = SEGCP_ER_NOCOMMAND;
+				break;
+		}
+	}
+
+	if(status != SEGCP_ER_NULL)
+	{
+		p = rep + SEGCP_TLV_REP_HEADER_LEN; // No values with an error
+		ret = SEGCP_RET_ERR | ((uint16_t)status << 8);
+	}
+
+	rep[0] = SEGCP_TLV_MAGIC_0;
+	rep[1] = SEGCP_TLV_MAGIC_1;
+	rep[2] = SEGCP_TLV_VERSION;
+	rep[3] = op | SEGCP_TLV_OP_REPLY;
+	rep[4] = req[4]; // Sequence
+	rep[5] = req[5];
+	memcpy(&rep[6], dev_config->network_info_common.mac, 6);
+	rep[12] = status;
+	rep[13] = err_id;
+
+	crc = crc16_modbus(rep, (uint16_t)(p - rep));
+	*p++ = (uint8_t)crc;
+	*p++ = (uint8_t)(crc >> 8);
+
+	*rep_len = (uint16_t)(p - rep);
+	return ret;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static const struct __tlv_field * find_tlv_field(uint8_t id)
+{
+	uint8_t i;
+
+	for(i = 0; i < TLV_FIELD_NUM; i++)
+	{
+		if(tlv_field_table[i].id == id) return &tlv_field_table[i];
+	}
+	return 0;
+}
+
+// ret: next position, 0 if the field does not fit before end
+static uint8_t * put_tlv_field(uint8_t * p, uint8_t * end, const struct __tlv_field * f)
+{
+	uint8_t * src = (uint8_t *)get_DevConfig_pointer() + f->offset;
+	uint16_t val;
+	uint8_t len = f->size;
+
+	if((f->type & TLV_TYPE_MASK) == TLV_TYPE_STR)
+	{
+		for(len = 0; (len < f->size) && src[len]; len++);
+	}
+	if((p + 2 + len) > end) return 0;
+
+	*p++ = f->id;
+	*p++ = len;
+
+	if((f->type & TLV_TYPE_MASK) == TLV_TYPE_U16)
+	{
+		memcpy(&val, src, 2); // DevConfig is packed: the member may not be aligned
+		*p++ = (uint8_t)(val >> 8);
+		*p++ = (uint8_t)val;
+	}
+	else
+	{
+		memcpy(p, src, len);
+		p += len;
+	}
+	return p;
+}
+
+// ret: SEGCP_ER_*
+static uint8_t check_tlv_value(const struct __tlv_field * f, const uint8_t * val, uint8_t len)
+{
+	if(f->type & TLV_RO) return SEGCP_ER_IGNORED;
+
+	switch(f->type & TLV_TYPE_MASK)
+	{
+		case TLV_TYPE_U8:
+			if(len != 1 || val[0] > f->max) return SEGCP_ER_INVALIDPARAM;
+			break;
+		case TLV_TYPE_BITS:
+			if(len != 1 || (val[0] & ~f->max)) return SEGCP_ER_INVALIDPARAM;
+			break;
+		case TLV_TYPE_STR:
+			if(len > (f->size - 1) || memchr(val, 0, len)) return SEGCP_ER_INVALIDPARAM;
+			break;
+		default:
+			if(len != f->size) return SEGCP_ER_INVALIDPARAM;
+			break;
+	}
+	return SEGCP_ER_NULL;
+}
+
+static void set_tlv_value(const struct __tlv_field * f, const uint8_t * val, uint8_t len)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	uint8_t * dst = (uint8_t *)dev_config + f->offset;
+	uint16_t tmp;
+
+	switch(f->type & TLV_TYPE_MASK)
+	{
+		case TLV_TYPE_U16:
+			tmp = ((uint16_t)val[0] << 8) | val[1];
+			memcpy(dst, &tmp, 2);
+			break;
+		case TLV_TYPE_STR:
+			memset(dst, 0, f->size);
+			memcpy(dst, val, len);
+			break;
+		default:
+			memcpy(dst, val, len);
+			break;
+	}
+
+	// The flow control is not used with RS-422/485, as the FL command
+	if(f->id == TLV_FLOW_CONTROL && dev_config->serial_info[0].uart_interface == UART_IF_RS422_485)
+		dev_config->serial_info[0].flow_control = flow_none;
+}
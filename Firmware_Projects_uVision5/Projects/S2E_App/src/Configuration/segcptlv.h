@@ -0,0 +1,108 @@
+#ifndef SEGCPTLV_H_
+#define SEGCPTLV_H_
+
+#include <stdint.h>
+
+// Binary TLV configuration protocol; served on the SEGCP UDP / TCP ports along with the ASCII commands.
+// The fields are read and written as the binary values of DevConfig, a batch of fields in a packet.
+// The privilege is of the ASCII protocol: broadcast MAC (FF:FF:FF:FF:FF:FF) read, device MAC read / write;
+// the search password is required for both.
+//
+// Packet, all multi-byte fields big-endian except the CRC
+//  Request: [Magic 'W' 'C'][Version 1][Opcode 1][Sequence 2][MAC 6][Password length 1][Password][TLVs][CRC-16 2]
+//  Reply:   [Magic 'W' 'C'][Version 1][Opcode | 0x80][Sequence 2][Device MAC 6][Status 1][Error field ID 1][TLVs][CRC-16 2]
+//  TLV:     [Field ID 1][Length 1][Value]
+//  CRC-16/MODBUS of the whole packet before the CRC, low byte first
+//
+// GET: TLVs of length 0 list the fields to read, none reads all the fields; the reply has the values in the order.
+// SET: All the TLVs are checked first; the fields are written only if none has an error (Status: SEGCP_ER_*,
+//      Error field ID: the first TLV with the error). The reply has no TLVs.
+//      The serial and data socket settings are applied live, the IP settings after the reboot, as the ASCII commands.
+// The UDP reply is broadcast after the search delay, or sent to the requester with the device MAC or SEGCP_TLV_FLAG_UNICAST.
+// A packet with a wrong magic, version, length or CRC is discarded without a reply.
+
+#define SEGCP_TLV_MAGIC_0			'W'
+#define SEGCP_TLV_MAGIC_1			'C'
+#define SEGCP_TLV_VERSION			1
+
+#define SEGCP_TLV_REQ_HEADER_LEN	13		// Up to the password length
+#define SEGCP_TLV_REP_HEADER_LEN	14
+#define SEGCP_TLV_CRC_LEN			2
+
+// Opcode: operation | flags
+#define SEGCP_TLV_OP_GET			0x01
+#define SEGCP_TLV_OP_SET			0x02
+#define SEGCP_TLV_OP_MASK			0x0F
+#define SEGCP_TLV_FLAG_SAVE			0x10	// SET: save to the storage (SV)
+#define SEGCP_TLV_FLAG_REBOOT		0x20	// SET: reboot after the reply (RT)
+#define SEGCP_TLV_FLAG_UNICAST		0x40	// Reply to the requester (QU1); always with the device MAC
+#define SEGCP_TLV_OP_REPLY			0x80
+
+// Field ID; the value type and range are of the field table (segcptlv.c)
+typedef enum {
+	// Device, read only
+	TLV_MAC = 0x01,					// 6 bytes
+	TLV_FW_VER = 0x02,				// 3 bytes: major, minor, maintenance
+	TLV_MODULE_TYPE = 0x03,			// 3 bytes
+	TLV_MODULE_NAME = 0x04,			// String (DH)
+	TLV_UART_INTERFACE = 0x05,		// [0] RS-232/TTL / [1] RS-422/485
+
+	// Network
+	TLV_LOCAL_IP = 0x10,			// 4 bytes
+	TLV_GATEWAY = 0x11,
+	TLV_SUBNET = 0x12,
+	TLV_DHCP_USE = 0x13,			// [0] Static / [1] DHCP
+	TLV_DNS_SERVER_IP = 0x14,
+	TLV_DNS_USE = 0x15,				// Remote host: [0] IP address / [1] Domain name
+	TLV_DNS_DOMAIN_NAME = 0x16,		// String
+
+	// Data socket
+	TLV_WORKING_MODE = 0x20,		// OP
+	TLV_REMOTE_IP = 0x21,
+	TLV_LOCAL_PORT = 0x22,			// 2 bytes
+	TLV_REMOTE_PORT = 0x23,
+	TLV_INACTIVITY = 0x24,			// sec
+	TLV_RECONNECTION = 0x25,		// msec
+	TLV_PACKING_TIME = 0x26,		// msec
+	TLV_PACKING_SIZE = 0x27,		// 1 byte
+	TLV_PACKING_DELIMITER = 0x28,	// 4 bytes
+	TLV_PACKING_DELIMITER_LEN = 0x29,
+	TLV_PACKING_APPENDIX = 0x2A,
+	TLV_KEEPALIVE_EN = 0x2B,
+	TLV_KEEPALIVE_WAIT = 0x2C,		// msec
+	TLV_KEEPALIVE_RETRY = 0x2D,		// msec
+
+	// Serial
+	TLV_BAUD_RATE = 0x30,			// Baud rate index of uartHandler.h
+	TLV_DATA_BITS = 0x31,
+	TLV_PARITY = 0x32,
+	TLV_STOP_BITS = 0x33,
+	TLV_FLOW_CONTROL = 0x34,		// Always none for RS-422/485
+	TLV_DTR_EN = 0x35,
+	TLV_DSR_EN = 0x36,
+	TLV_SERIAL_DEBUG = 0x37,
+
+	// Options
+	TLV_PW_CONNECT = 0x40,			// String
+	TLV_PW_SEARCH = 0x41,			// String
+	TLV_PW_CONNECT_EN = 0x42,
+	TLV_SERIAL_COMMAND = 0x43,
+	TLV_SERIAL_COMMAND_ECHO = 0x44,
+	TLV_SERIAL_TRIGGER = 0x45,		// 3 bytes
+
+	// Extended S2E functions (network_option)
+	TLV_RECONNECT_BACKOFF_MAX = 0x50,
+	TLV_OPTION_FLAGS = 0x51,		// NET_OPTION_*
+	TLV_FRAME_MODE = 0x52,			// FRAME_MODE_*
+	TLV_TELEMETRY_IP = 0x53
+} teSEGCPTLV;
+
+// Called by the SEGCP UDP / TCP handlers for each received packet
+// ret: [1] binary TLV packet (the magic)
+uint8_t is_SEGCP_tlv(uint8_t * req, uint16_t len);
+
+// Processes the request and makes the reply in rep (CONFIG_BUF_SIZE); *rep_len: 0 if no reply
+// ret: SEGCP_RET_* of proc_SEGCP
+uint16_t proc_SEGCP_tlv(uint8_t * req, uint16_t len, uint8_t * rep, uint16_t * rep_len);
+
+#endif /* SEGCPTLV_H_ */
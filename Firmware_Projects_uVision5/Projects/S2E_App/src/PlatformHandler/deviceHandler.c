@@ -61,6 +61,8 @@ void device_socket_termination(void)
 
 void device_reboot(void)
 {
+	flush_save_DevConfig();
+	
 	device_socket_termination();
 	
 	clear_data_transfer_bytecount(SEG_ALL);
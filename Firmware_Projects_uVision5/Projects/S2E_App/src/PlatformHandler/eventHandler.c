@@ -0,0 +1,255 @@
+#include <string.h>
+#include "W7500x.h"
+#include "W7500x_wztoe.h"
+#include "wizchip_conf.h"
+#include "common.h"
+#include "eventHandler.h"
+#include "timerHandler.h"
+
+#ifdef _EVENT_DEBUG_
+	#include <stdio.h>
+#endif
+
+/* Private define ------------------------------------------------------------*/
+#define EVENT_SOCK_IMR			(Sn_IR_RECV | Sn_IR_DISCON) // Sn_IR_CON, SENDOK and TIMEOUT are polled by the socket API / SEG handlers
+#define EVENT_LATENCY_AVG_SHIFT	3 // Moving average weight: 1/8
+
+/* Private variables ---------------------------------------------------------*/
+static volatile uint32_t event_pending = 0;
+static volatile uint32_t event_post_tick[EVENT_MAX];
+static void (*event_handler[EVENT_MAX])(void);
+static struct __event_stat event_stat[EVENT_MAX];
+static struct __loop_stat loop_stat = {0, 0, 0, 0, EVENT_MAX, LOOP_THRESHOLD_DEFAULT, 0, PROFILE_MAX, 0, PROFILE_MAX, 0};
+
+uint32_t loop_probe_tick;
+static uint32_t loop_probe_ticks[PROFILE_MAX]; // Call probe time of the current iteration (timer ticks)
+
+/* Private functions ---------------------------------------------------------*/
+static teEVENT get_sock_event(uint8_t sock);
+static void add_loop_sample(uint32_t usec, uint8_t worst_event, uint8_t probe, uint32_t probe_usec);
+
+/* Public functions ----------------------------------------------------------*/
+void Event_Configuration(void)
+{
+	uint8_t i;
+	
+	/* WZTOE socket interrupts: Rx data / Disconnect for the sockets handled by the main loop */
+	for(i = 0; i < _WIZCHIP_SOCK_NUM_; i++)
+	{
+		if(get_sock_event(i) < EVENT_MAX)
+		{
+			setSn_IMR(i, EVENT_SOCK_IMR);
+			setSn_ICR(i, EVENT_SOCK_IMR);
+		}
+		else
+		{
+			setSn_IMR(i, 0);
+		}
+	}
+	setSIMR((1 << SOCK_DATA) | (1 << SOCK_CONFIG_UDP) | (1 << SOCK_CONFIG_TCP) | (1 << SOCK_DHCP) | (1 << SOCK_MODBUS));
+
+	/* NVIC configuration */
+	NVIC_ClearPendingIRQ(WZTOE_IRQn);
+	NVIC_SetPriority(WZTOE_IRQn, 2);
+	NVIC_EnableIRQ(WZTOE_IRQn);
+}
+
+void reg_event_handler(teEVENT event, void (*handler)(void))
+{
+	if(event < EVENT_MAX) event_handler[event] = handler;
+}
+
+// Can be called from both interrupt handlers and the main loop
+void post_event(teEVENT event)
+{
+	uint32_t primask;
+	uint32_t mask;
+
+	if(event >= EVENT_MAX) return;
+	mask = (1UL << event);
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(!(event_pending & mask)) // The first post since the last dispatch is the wake-up time of the event
+	{
+		event_post_tick[event] = get_timer_tick();
+		event_pending |= mask;
+	}
+
+	__set_PRIMASK(primask);
+}
+
+// Dispatches all the events pending at the time of call, in order of priority.
+// Events posted during the dispatch are handled in the next call, so a busy data path cannot starve the others.
+// ret: [0] no event dispatched / [!0] the number of dispatched events
+uint8_t dispatch_event(void)
+{
+	uint8_t i;
+	uint8_t cnt = 0;
+	uint32_t pending;
+	uint32_t mask;
+	uint32_t latency;
+	uint32_t start;
+	uint32_t handler_start;
+	uint32_t handler_time;
+	uint32_t handler_worst = 0;
+	uint8_t worst_event = EVENT_MAX;
+	uint8_t probe = PROFILE_MAX;
+	
+	if(event_pending == 0) return 0;
+	
+	memset(loop_probe_ticks, 0, sizeof(loop_probe_ticks));
+	start = get_timer_tick();
+	
+	__disable_irq();
+	pending = event_pending;
+	__enable_irq();
+	
+	for(i = 0; i < EVENT_MAX; i++)
+	{
+		mask = (1UL << i);
+		if(!(pending & mask)) continue;
+		
+		__disable_irq();
+		event_pending &= ~mask;
+		latency = timer_tick_to_usec(get_timer_tick() - event_post_tick[i]);
+		__enable_irq();
+		
+		event_stat[i].dispatch_cnt++;
+		event_stat[i].latency_last = latency;
+		if(latency > event_stat[i].latency_max) event_stat[i].latency_max = latency;
+		if(event_stat[i].dispatch_cnt == 1) event_stat[i].latency_avg = latency;
+		else event_stat[i].latency_avg += ((int32_t)(latency - event_stat[i].latency_avg) >> EVENT_LATENCY_AVG_SHIFT);
+		
+		handler_start = get_timer_tick();
+		if(event_handler[i]) event_handler[i]();
+		handler_time = timer_tick_to_usec(get_timer_tick() - handler_start);
+		
+		if(handler_time > loop_stat.handler_max[i]) loop_stat.handler_max[i] = handler_time;
+		if(handler_time >= handler_worst)
+		{
+			handler_worst = handler_time;
+			worst_event = i;
+		}
+		cnt++;
+	}
+	
+	for(i = 0; i < PROFILE_MAX; i++)
+	{
+		if(loop_probe_ticks[i] && ((probe == PROFILE_MAX) || (loop_probe_ticks[i] > loop_probe_ticks[probe]))) probe = i;
+	}
+	
+	add_loop_sample(timer_tick_to_usec(get_timer_tick() - start), worst_event, probe, (probe < PROFILE_MAX) ? timer_tick_to_usec(loop_probe_ticks[probe]) : 0);
+	
+	return cnt;
+}
+
+// Sleeps until the next interrupt when no event is pending.
+// An interrupt arriving between the check and WFI still wakes the core up because WFI ignores PRIMASK.
+void wait_for_event(void)
+{
+	__disable_irq();
+	if(event_pending == 0) __WFI();
+	__enable_irq();
+}
+
+void WZTOE_IRQ_Handler(void)
+{
+	uint8_t sir;
+	uint8_t ir;
+	uint8_t i;
+
+	sir = getSIR();
+
+	for(i = 0; i < _WIZCHIP_SOCK_NUM_; i++)
+	{
+		if(sir & (1 << i))
+		{
+			ir = getSn_IR(i) & EVENT_SOCK_IMR;
+			if(ir) setSn_ICR(i, ir);
+
+			post_event(get_sock_event(i));
+		}
+	}
+}
+
+// Called by CALL_PROBE_EXIT
+void add_loop_probe(tePROFILE probe, uint32_t ticks)
+{
+	loop_probe_ticks[probe] += ticks;
+}
+
+void get_event_stat(teEVENT event, struct __event_stat * stat)
+{
+	if(event < EVENT_MAX) memcpy(stat, &event_stat[event], sizeof(struct __event_stat));
+}
+
+void clear_event_stat(void)
+{
+	memset(event_stat, 0, sizeof(event_stat));
+}
+
+void get_loop_stat(struct __loop_stat * stat)
+{
+	memcpy(stat, &loop_stat, sizeof(struct __loop_stat));
+}
+
+// The threshold is kept
+void clear_loop_stat(void)
+{
+	uint32_t threshold = loop_stat.threshold;
+	
+	memset(&loop_stat, 0, sizeof(loop_stat));
+	loop_stat.worst_event = EVENT_MAX;
+	loop_stat.worst_probe = PROFILE_MAX;
+	loop_stat.over_probe = PROFILE_MAX;
+	loop_stat.threshold = threshold;
+}
+
+void set_loop_threshold(uint32_t usec)
+{
+	loop_stat.threshold = usec;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static void add_loop_sample(uint32_t usec, uint8_t worst_event, uint8_t probe, uint32_t probe_usec)
+{
+	uint32_t tmp;
+	uint8_t idx = 0;
+	
+	for(tmp = usec; tmp && (idx < (LOOP_HIST_BUCKETS - 1)); tmp >>= 1) idx++;
+	loop_stat.bucket[idx]++;
+	
+	loop_stat.iteration_cnt++;
+	loop_stat.time_last = usec;
+	if(loop_stat.iteration_cnt == 1) loop_stat.time_avg = usec;
+	else loop_stat.time_avg += ((int32_t)(usec - loop_stat.time_avg) >> EVENT_LATENCY_AVG_SHIFT);
+	
+	if(usec > loop_stat.time_max)
+	{
+		loop_stat.time_max = usec;
+		loop_stat.worst_event = worst_event;
+		loop_stat.worst_probe = probe;
+		loop_stat.worst_probe_time = probe_usec;
+	}
+	if(usec > loop_stat.threshold)
+	{
+		loop_stat.over_cnt++;
+		loop_stat.over_probe = probe;
+		loop_stat.over_probe_time = probe_usec;
+	}
+}
+
+static teEVENT get_sock_event(uint8_t sock)
+{
+	switch(sock)
+	{
+		case SOCK_DATA:
+		case SOCK_MODBUS:		return EVENT_SEG;
+		case SOCK_CONFIG_UDP:
+		case SOCK_CONFIG_TCP:	return EVENT_SEGCP;
+		case SOCK_DHCP:			return EVENT_DHCP;
+		default:				return EVENT_MAX;
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef EVENTHANDLER_H_
+#define EVENTHANDLER_H_
+
+#include <stdint.h>
+#include "timerHandler.h"
+#include "profileHandler.h"
+
+//#define _EVENT_DEBUG_
+
+// Event number is also the dispatch priority: lower number is dispatched first
+typedef enum {
+	EVENT_SEG = 0,		// S2E data path: UART Rx, data socket Rx/Discon, S2E timer expired (seg_timer_msec)
+	EVENT_SEGCP,		// Configuration: config sockets Rx/Discon, AT mode command line, SEGCP timer expired (segcp_timer_msec), 1s fallback poll
+	EVENT_DHCP,			// DHCP client: DHCP socket Rx, 1s timer tick
+	EVENT_SYSTEM,		// Housekeeping: PHY link check, Ring buffer full notice, Telemetry push (1s timer tick)
+	EVENT_MAX
+} teEVENT;
+
+// Main loop iteration time histogram: log2 buckets, [0] below 1 usec, [n] 2^(n-1) ~ 2^n - 1 usec, the last bucket: 2^18 usec (262 msec) and over
+#define LOOP_HIST_BUCKETS			20
+#define LOOP_THRESHOLD_DEFAULT		1000	// Iteration time budget (usec); not saved, set to the default at boot
+
+// Main loop call probes (tePROFILE): the run time of the probed calls is summed per iteration, in any build (also counted by
+// the profiler if _PROFILE_ is defined). For the calls made by the event handlers; a call probe must not contain another one.
+#define CALL_PROBE_ENTER(probe)		do { PROFILE_ENTER(probe); loop_probe_tick = get_timer_tick(); } while(0)
+#define CALL_PROBE_EXIT(probe)		do { add_loop_probe((probe), get_timer_tick() - loop_probe_tick); PROFILE_EXIT(probe); } while(0)
+
+// Wake-to-dispatch latency statistics (unit: usec)
+struct __event_stat {
+	uint32_t dispatch_cnt;
+	uint32_t latency_last;
+	uint32_t latency_avg;
+	uint32_t latency_max;
+};
+
+// Main loop iteration statistics (unit: usec)
+// An iteration is a dispatch of the pending events (all handlers run by one dispatch_event call); the sleep time is not included.
+struct __loop_stat {
+	uint32_t iteration_cnt;
+	uint32_t time_last;
+	uint32_t time_avg;
+	uint32_t time_max;
+	uint32_t worst_event;				// The longest handler of the worst iteration (teEVENT)
+	uint32_t threshold;
+	uint32_t over_cnt;					// Iterations over the threshold
+	uint32_t worst_probe;				// The call probe with the most time in the worst iteration (tePROFILE), PROFILE_MAX: none
+	uint32_t worst_probe_time;
+	uint32_t over_probe;				// The call probe with the most time in the last iteration over the threshold
+	uint32_t over_probe_time;
+	uint32_t handler_max[EVENT_MAX];	// Worst handler run time per event
+	uint32_t bucket[LOOP_HIST_BUCKETS];
+};
+
+void Event_Configuration(void);
+void reg_event_handler(teEVENT event, void (*handler)(void));
+
+void post_event(teEVENT event);
+uint8_t dispatch_event(void);
+void wait_for_event(void);
+
+void WZTOE_IRQ_Handler(void);
+
+extern uint32_t loop_probe_tick;
+void add_loop_probe(tePROFILE probe, uint32_t ticks);
+
+void get_event_stat(teEVENT event, struct __event_stat * stat);
+void clear_event_stat(void);
+
+void get_loop_stat(struct __loop_stat * stat);
+void clear_loop_stat(void);
+void set_loop_threshold(uint32_t usec);
+
+#endif /* EVENTHANDLER_H_ */
@@ -475,6 +475,9 @@ uint8_t get_flowcontrol_dsr_pin(void)
 }
 
 
+// PHY link up -> down transitions since boot
+static volatile uint32_t phylink_down_cnt = 0;
+
 // Check the PHY link status
 void check_phylink_status(void)
 {
@@ -492,12 +495,20 @@ void check_phylink_status(void)
 		if(link_status == 0x00)
 			set_connection_status_io(STATUS_PHYLINK_PIN, ON); 	// PHY Link up
 		else
+		{
 			set_connection_status_io(STATUS_PHYLINK_PIN, OFF); 	// PHY Link down
+			if(prev_link_status == 0x00) phylink_down_cnt++;	// Link flap: up -> down
+		}
 		
 		prev_link_status = link_status;
 	}
 }
 
+uint32_t get_phylink_down_count(void)
+{
+	return phylink_down_cnt;
+}
+
 // This function have to call every 1 millisecond by Timer IRQ handler routine.
 void gpio_handler_timer_msec(void)
 {
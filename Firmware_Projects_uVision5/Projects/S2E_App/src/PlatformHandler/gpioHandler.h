@@ -79,6 +79,7 @@ uint8_t get_flowcontrol_dsr_pin(void);
 
 // Check the PHY link status 
 void check_phylink_status(void);
+uint32_t get_phylink_down_count(void); // PHY link up -> down transitions since boot
 void gpio_handler_timer_msec(void); // This function have to call every 1 millisecond by Timer IRQ handler routine.
 
 #endif
@@ -0,0 +1,72 @@
+#include <string.h>
+#include "W7500x.h"
+#include "memoryHandler.h"
+
+#if defined(__ARMCC_VERSION)
+
+/* Private variables ---------------------------------------------------------*/
+// armlink generated symbols; the region names are of the scatter file generated by uVision
+extern uint32_t Image$$RW_IRAM1$$Base;
+extern uint32_t Image$$RW_IRAM1$$RW$$Length;
+extern uint32_t Image$$RW_IRAM1$$ZI$$Length;
+extern uint32_t Image$$RW_IRAM1$$ZI$$Limit;
+extern uint32_t STACK$$Base;
+extern uint32_t STACK$$Limit;
+extern uint32_t HEAP$$Base;
+extern uint32_t HEAP$$Limit;
+
+// Lowest painted word not overwritten yet; the scan goes from the stack base up to this mark only
+static uint32_t * stack_mark = 0;
+
+/* Public functions ----------------------------------------------------------*/
+void paint_stack(void)
+{
+	uint32_t * p = (uint32_t *)&STACK$$Base;
+	uint32_t * sp = (uint32_t *)__get_MSP(); // The words below the stack pointer are not in use
+
+	while(p < sp) *p++ = STACK_PAINT_PATTERN;
+	stack_mark = sp;
+}
+
+void check_stack_usage(void)
+{
+	uint32_t * p = (uint32_t *)&STACK$$Base;
+
+	if(stack_mark == 0) return; // Not painted
+
+	while((p < stack_mark) && (*p == STACK_PAINT_PATTERN)) p++;
+	stack_mark = p;
+}
+
+uint8_t get_ram_map(struct __ram_map * map)
+{
+	uint32_t base = (uint32_t)&Image$$RW_IRAM1$$Base;
+
+	map->total = RAM_SIZE;
+	map->data = (uint32_t)&Image$$RW_IRAM1$$RW$$Length;
+	map->heap = (uint32_t)&HEAP$$Limit - (uint32_t)&HEAP$$Base;
+	map->stack = (uint32_t)&STACK$$Limit - (uint32_t)&STACK$$Base;
+	map->bss = (uint32_t)&Image$$RW_IRAM1$$ZI$$Length - map->heap - map->stack;
+	map->free = RAM_SIZE - ((uint32_t)&Image$$RW_IRAM1$$ZI$$Limit - base);
+	map->stack_used = stack_mark ? ((uint32_t)&STACK$$Limit - (uint32_t)stack_mark) : 0;
+
+	return 1;
+}
+
+#else
+
+void paint_stack(void)
+{
+}
+
+void check_stack_usage(void)
+{
+}
+
+uint8_t get_ram_map(struct __ram_map * map)
+{
+	memset(map, 0, sizeof(struct __ram_map));
+	return 0;
+}
+
+#endif /* __ARMCC_VERSION */
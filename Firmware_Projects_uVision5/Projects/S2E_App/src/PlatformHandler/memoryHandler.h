@@ -0,0 +1,33 @@
+#ifndef MEMORYHANDLER_H_
+#define MEMORYHANDLER_H_
+
+#include <stdint.h>
+
+// SRAM usage report: linker section map (armlink: RW_IRAM1 execution region, STACK / HEAP areas of startup_W7500x.s)
+// and the stack high-water mark; the unused stack is painted at startup and scanned by the housekeeping event.
+// Not available in the builds without the armlink symbols (e.g., the host simulation).
+
+#define RAM_SIZE					0x4000		// W7500x SRAM 16KB
+#define STACK_PAINT_PATTERN			0xA5A5A5A5
+
+// RAM map, unit: bytes
+struct __ram_map {
+	uint32_t total;				// SRAM size
+	uint32_t data;				// Initialized static data (RW)
+	uint32_t bss;				// Zero-initialized static data (ZI), the stack and heap are not included
+	uint32_t heap;
+	uint32_t stack;
+	uint32_t free;				// Not allocated by the linker
+	uint32_t stack_used;		// High-water mark of the main stack; equal to stack: overflow is possible
+};
+
+// Called first in main(), before the interrupts are enabled
+void paint_stack(void);
+
+// High-water scan; called every second by the housekeeping event (main loop)
+void check_stack_usage(void);
+
+// ret: [1] available / [0] not available
+uint8_t get_ram_map(struct __ram_map * map);
+
+#endif /* MEMORYHANDLER_H_ */
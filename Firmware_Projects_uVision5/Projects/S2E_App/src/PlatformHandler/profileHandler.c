@@ -0,0 +1,46 @@
+#include <string.h>
+#include "W7500x.h"
+#include "profileHandler.h"
+#include "timerHandler.h"
+
+#ifdef _PROFILE_
+
+/* Private variables ---------------------------------------------------------*/
+volatile uint32_t profile_enter_tick[PROFILE_MAX];
+static struct __profile_stat profile_stat[PROFILE_MAX];
+
+/* Public functions ----------------------------------------------------------*/
+// Called by PROFILE_EXIT from both interrupt handlers and the main loop; each probe is recorded by one context only
+void profile_record(tePROFILE probe, uint32_t cycles)
+{
+	struct __profile_stat * stat = &profile_stat[probe];
+
+	if((stat->count == 0) || (cycles < stat->min)) stat->min = cycles;
+	if(cycles > stat->max) stat->max = cycles;
+	stat->total += cycles;
+	stat->count++;
+}
+
+void get_profile_stat(tePROFILE probe, struct __profile_stat * stat)
+{
+	uint32_t primask;
+
+	if(probe >= PROFILE_MAX) return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	memcpy(stat, &profile_stat[probe], sizeof(struct __profile_stat));
+	__set_PRIMASK(primask);
+}
+
+void clear_profile_stat(void)
+{
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	memset(profile_stat, 0, sizeof(profile_stat));
+	__set_PRIMASK(primask);
+}
+
+#endif /* _PROFILE_ */
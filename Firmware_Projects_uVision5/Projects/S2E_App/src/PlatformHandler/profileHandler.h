@@ -0,0 +1,49 @@
+#ifndef PROFILEHANDLER_H_
+#define PROFILEHANDLER_H_
+
+#include <stdint.h>
+#include "timerHandler.h"
+
+// Hot-path cycle profiler; the probes are compiled out (no code, no RAM) unless _PROFILE_ is defined
+//#define _PROFILE_
+
+// Probe number; the order of the SEGCP PF reply
+typedef enum {
+	PROFILE_UART_IRQ = 0,		// S2E_UART_IRQ_Handler
+	PROFILE_TIMER_IRQ,			// Timer_IRQ_Handler
+	PROFILE_GET_SERIAL_DATA,	// get_serial_data
+	PROFILE_UART_TO_ETHER,		// uart_to_ether
+	PROFILE_ETHER_TO_UART,		// ether_to_uart
+	PROFILE_PROC_SEGCP,			// proc_SEGCP
+	PROFILE_DHCP_RUN,			// DHCP_run (DHCP event)
+	PROFILE_UART_PUTS,			// Data UART writes: ether_to_uart, AT command replies
+	PROFILE_SOCK_SEND,			// send / sendto: data socket, SEGCP replies, Modbus TCP responses
+	PROFILE_CONFIG_SAVE,		// Configuration write to the storage (save_DevConfig_to_storage)
+	PROFILE_MAX
+} tePROFILE;
+
+// Probe statistics, unit: system clock cycles (DUALTIMER0_1 tick); the time spent in the interrupt handlers is included
+struct __profile_stat {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+};
+
+#ifdef _PROFILE_
+	extern volatile uint32_t profile_enter_tick[PROFILE_MAX];
+
+	// Not reentrant: a probe must not be entered again before its exit
+	#define PROFILE_ENTER(probe)	(profile_enter_tick[(probe)] = get_timer_tick())
+	#define PROFILE_EXIT(probe)		profile_record((probe), get_timer_tick() - profile_enter_tick[(probe)])
+
+	void profile_record(tePROFILE probe, uint32_t cycles);
+
+	void get_profile_stat(tePROFILE probe, struct __profile_stat * stat);
+	void clear_profile_stat(void);
+#else
+	#define PROFILE_ENTER(probe)
+	#define PROFILE_EXIT(probe)
+#endif
+
+#endif /* PROFILEHANDLER_H_ */
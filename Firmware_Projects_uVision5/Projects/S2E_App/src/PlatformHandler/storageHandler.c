@@ -34,9 +34,9 @@ uint32_t read_storage(teDATASTORAGE stype, uint32_t addr, void *data, uint16_t s
 		
 		case STORAGE_CONFIG:
 #ifndef __USE_EXT_EEPROM__
-			ret_len = read_flash(DEVICE_CONFIG_ADDR, data, size); // internal data flash for configuration data (DAT0/1)
+			ret_len = read_flash(DEVICE_CONFIG_ADDR + addr, data, size); // internal data flash for configuration data (DAT0/1), addr: offset
 #else
-			ret_len = read_eeprom(convert_eeprom_addr(DEVICE_CONFIG_ADDR), data, size); // external eeprom for configuration data
+			ret_len = read_eeprom(convert_eeprom_addr(DEVICE_CONFIG_ADDR + addr), data, size); // external eeprom for configuration data, addr: offset
 	#ifdef _EEPROM_DEBUG_
 			//dump_eeprom_block(convert_eeprom_addr(DEVICE_CONFIG_ADDR));
 	#endif
@@ -80,10 +80,10 @@ uint32_t write_storage(teDATASTORAGE stype, uint32_t addr, void *data, uint16_t
 		case STORAGE_CONFIG:
 #ifndef __USE_EXT_EEPROM__	// flash
 			erase_storage(STORAGE_CONFIG);
-			ret_len = write_flash(DEVICE_CONFIG_ADDR, data, size); // internal data flash for configuration data (DAT0/1)
+			ret_len = write_flash(DEVICE_CONFIG_ADDR, data, size); // internal data flash for configuration data (DAT0/1), the sector is erased: whole data only
 #else
 			//erase_storage(STORAGE_CONFIG);
-			ret_len = write_eeprom(convert_eeprom_addr(DEVICE_CONFIG_ADDR), data, size); // external eeprom for configuration data
+			ret_len = write_eeprom(convert_eeprom_addr(DEVICE_CONFIG_ADDR + addr), data, size); // external eeprom for configuration data, addr: offset
 	#ifdef _EEPROM_DEBUG_
 			dump_eeprom_block(convert_eeprom_addr(DEVICE_CONFIG_ADDR));
 	#endif
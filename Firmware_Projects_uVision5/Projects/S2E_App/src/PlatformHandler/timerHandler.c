@@ -6,6 +6,8 @@
 #include "segcp.h"
 #include "deviceHandler.h"
 #include "gpioHandler.h"
+#include "eventHandler.h"
+#include "profileHandler.h"
 
 #include "dhcp.h"
 #include "dns.h"
@@ -18,6 +20,14 @@ static volatile uint32_t hour_cnt = 0;
 static uint8_t enable_phylink_check = 1;
 static volatile uint32_t phylink_down_time_msec;
 
+static uint32_t timer_tick_per_usec = 1;
+
+static void update_usec_clock(void);
+
+// 32-bit usec clock extended from the free-running tick counter, updated every 1 msec
+static volatile uint32_t usec_clock = 0;
+static volatile uint32_t usec_clock_tick = 0;
+
 void Timer_Configuration(void)
 {
 	DUALTIMER_InitTypDef Dualtimer_InitStructure;
@@ -42,18 +52,41 @@ void Timer_Configuration(void)
 
 	/* Dualtimer 0_0 start */
 	DUALTIMER_Start(DUALTIMER0_0);
+	
+	/* Dualtimer 0_1: free-running system clock tick counter for timestamps (no interrupt) */
+	DUALTIMER_ClockEnable(DUALTIMER0_1);
+	
+	Dualtimer_InitStructure.TimerLoad = 0xFFFFFFFF;
+	Dualtimer_InitStructure.TimerControl_Mode = DUALTIMER_TimerControl_FreeRunning;
+	Dualtimer_InitStructure.TimerControl_OneShot = DUALTIMER_TimerControl_Wrapping;
+	Dualtimer_InitStructure.TimerControl_Pre = DUALTIMER_TimerControl_Pre_1;
+	Dualtimer_InitStructure.TimerControl_Size = DUALTIMER_TimerControl_Size_32;
+	
+	DUALTIMER_Init(DUALTIMER0_1, &Dualtimer_InitStructure);
+	DUALTIMER_Start(DUALTIMER0_1);
+	
+	timer_tick_per_usec = GetSystemClock() / 1000000;
+	if(timer_tick_per_usec == 0) timer_tick_per_usec = 1;
+	
+	usec_clock_tick = get_timer_tick();
 }
 
 void Timer_IRQ_Handler(void)
 {
+	uint8_t seg_due;
+	uint8_t segcp_due;
+	
+	PROFILE_ENTER(PROFILE_TIMER_IRQ);
+	
 	if(DUALTIMER_GetIntStatus(DUALTIMER0_0))
 	{
 		DUALTIMER_IntClear(DUALTIMER0_0);
 		
 		msec_cnt++; // millisecond counter
+		update_usec_clock();
 		
-		seg_timer_msec();		// [msec] time counter for SEG (S2E)
-		segcp_timer_msec();		// [msec] time counter for SEGCP (Config)
+		seg_due = seg_timer_msec();	// [msec] time counter for SEG (S2E)
+		segcp_due = segcp_timer_msec();	// [msec] time counter for SEGCP (Config)
 		device_timer_msec();	// [msec] time counter for DeviceHandler (fw update)
 		
 		if(enable_phylink_check) // will be modified
@@ -65,6 +98,9 @@ void Timer_IRQ_Handler(void)
 		if(flag_s2e_application_running)
 		{
 			gpio_handler_timer_msec();
+			
+			if(seg_due) post_event(EVENT_SEG); // S2E timers expired, data held or socket in transition; otherwise the data path sleeps
+			if(segcp_due) post_event(EVENT_SEGCP); // Search reply delay expired, request left or socket in transition
 		}
 		
 		/* Second Process */
@@ -73,10 +109,14 @@ void Timer_IRQ_Handler(void)
 			msec_cnt = 0;
 			sec_cnt++;
 			
-			seg_timer_sec(); // [sec] time counter for SEG
+			if(seg_timer_sec() && flag_s2e_application_running) post_event(EVENT_SEG); // [sec] time counter for SEG, inactivity timer
 			
 			DHCP_time_handler();	// Time counter for DHCP timeout
 			DNS_time_handler();		// Time counter for DNS timeout
+			
+			if(flag_s2e_application_running) post_event(EVENT_SEGCP); // Fallback poll
+			post_event(EVENT_DHCP);
+			post_event(EVENT_SYSTEM);
 		}
 		
 		/* Minute Process */
@@ -98,6 +138,43 @@ void Timer_IRQ_Handler(void)
 	{
 		DUALTIMER_IntClear(DUALTIMER0_1);
 	}
+	
+	PROFILE_EXIT(PROFILE_TIMER_IRQ);
+}
+
+// Free-running up-counter, one tick per system clock (wraps around)
+uint32_t get_timer_tick(void)
+{
+	return (0xFFFFFFFF - DUALTIMER_GetTimerValue(DUALTIMER0_1));
+}
+
+uint32_t timer_tick_to_usec(uint32_t tick)
+{
+	return (tick / timer_tick_per_usec);
+}
+
+// Tick -> usec timestamp; the tick must be within +/- 44 sec from now (tick counter wraps around every 89 sec at 48MHz)
+// Lock-free (used by the event trace): the clock is read again when the timer interrupt updated it in between
+uint32_t get_timer_usec(uint32_t tick)
+{
+	uint32_t base;
+	uint32_t base_tick;
+	
+	do {
+		base = usec_clock;
+		base_tick = usec_clock_tick;
+	} while(base != usec_clock);
+	
+	return (base + (uint32_t)((int32_t)(tick - base_tick) / (int32_t)timer_tick_per_usec));
+}
+
+// The remainder ticks are carried over to keep the usec clock exact
+static void update_usec_clock(void)
+{
+	uint32_t usec = (get_timer_tick() - usec_clock_tick) / timer_tick_per_usec;
+	
+	usec_clock += usec;
+	usec_clock_tick += usec * timer_tick_per_usec;
 }
 
 uint32_t getDeviceUptime_hour(void)
@@ -6,6 +6,10 @@
 void Timer_Configuration(void);
 void Timer_IRQ_Handler(void);
 
+uint32_t get_timer_tick(void);
+uint32_t timer_tick_to_usec(uint32_t tick);
+uint32_t get_timer_usec(uint32_t tick); // Free-running 32-bit usec timestamp of the tick
+
 uint32_t getDeviceUptime_hour(void);
 uint8_t  getDeviceUptime_min(void);
 uint8_t  getDeviceUptime_sec(void);
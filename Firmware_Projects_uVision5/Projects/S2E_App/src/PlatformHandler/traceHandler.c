@@ -0,0 +1,81 @@
+#include <string.h>
+#include "W7500x.h"
+#include "traceHandler.h"
+#include "timerHandler.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TRACE_RING_MASK(ring)		(((ring) == 0) ? (TRACE_RING_MAIN_SIZE - 1) : (TRACE_RING_IRQ_SIZE - 1))
+#define TRACE_RING_REC(ring, seq)	(((ring) == 0) ? &trace_main[(seq) & (TRACE_RING_MAIN_SIZE - 1)] : &trace_irq[(ring) - 1][(seq) & (TRACE_RING_IRQ_SIZE - 1)])
+
+/* Private variables ---------------------------------------------------------*/
+static struct __trace_record trace_main[TRACE_RING_MAIN_SIZE];
+static struct __trace_record trace_irq[TRACE_RING_NUM - 1][TRACE_RING_IRQ_SIZE];
+
+// Records written to the ring; updated by the writer after the record
+static volatile uint32_t trace_count[TRACE_RING_NUM];
+
+/* Private functions prototypes ----------------------------------------------*/
+static uint8_t get_trace_ring(void);
+
+/* Public functions ----------------------------------------------------------*/
+void trace_event(teTRACE event, uint8_t arg8, uint16_t arg16)
+{
+	uint8_t ring = get_trace_ring();
+	struct __trace_record * rec = TRACE_RING_REC(ring, trace_count[ring]);
+
+	rec->time = get_timer_usec(get_timer_tick());
+	rec->event = (uint8_t)event;
+	rec->arg8 = arg8;
+	rec->arg16 = arg16;
+
+	trace_count[ring]++;
+}
+
+uint32_t get_trace_count(uint8_t ring)
+{
+	if(ring >= TRACE_RING_NUM) return 0;
+	return trace_count[ring];
+}
+
+// The writer of an interrupt ring may preempt the copy: the records overwritten meanwhile are dropped by checking the count again
+uint8_t get_trace_records(uint8_t ring, uint32_t seq, struct __trace_record * rec, uint8_t num, uint32_t * first)
+{
+	uint32_t mask;
+	uint32_t count;
+	uint32_t oldest;
+	uint8_t i;
+	uint8_t n;
+
+	*first = seq;
+	if(ring >= TRACE_RING_NUM) return 0;
+	mask = TRACE_RING_MASK(ring);
+
+	count = trace_count[ring];
+	oldest = (count > mask) ? (count - mask - 1) : 0;
+	if((int32_t)(seq - oldest) < 0) seq = oldest;
+	if((int32_t)(count - seq) < (int32_t)num) num = (uint8_t)(count - seq);
+
+	for(i = 0; i < num; i++) memcpy(&rec[i], TRACE_RING_REC(ring, seq + i), sizeof(struct __trace_record));
+
+	count = trace_count[ring];
+	oldest = (count > mask) ? (count - mask - 1) : 0;
+	for(n = 0; (n < num) && ((int32_t)(seq + n - oldest) < 0); n++);
+	if(n) memmove(rec, &rec[n], (num - n) * sizeof(struct __trace_record));
+
+	*first = seq + n;
+	return (num - n);
+}
+
+/* Private functions ---------------------------------------------------------*/
+// Thread mode: main loop ring; exception: ring of the exception priority (the system exceptions use the highest)
+static uint8_t get_trace_ring(void)
+{
+	uint32_t exc = __get_IPSR() & 0x3F;
+	uint32_t prio;
+
+	if(exc == 0) return 0;
+	if(exc < 15) return 1;
+
+	prio = NVIC_GetPriority((IRQn_Type)((int32_t)exc - 16));
+	return (uint8_t)((prio < (TRACE_RING_NUM - 1)) ? (1 + prio) : (TRACE_RING_NUM - 1));
+}
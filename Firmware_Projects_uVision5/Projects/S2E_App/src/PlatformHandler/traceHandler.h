@@ -0,0 +1,54 @@
+#ifndef TRACEHANDLER_H_
+#define TRACEHANDLER_H_
+
+#include <stdint.h>
+
+// Data-path event trace: timestamped binary records kept in RAM rings, dumped by the SEGCP TD command
+// and decoded on the host (tools/s2e_trace.py); the oldest records are overwritten.
+// One ring per execution priority: each ring has a single writer, since the handlers of the same priority do not
+// preempt each other. The records are written without disabling the interrupts; the host merges the rings by the time.
+
+// Ring: [0] main loop, [1 + n] exception priority n (Cortex-M0: 4 levels)
+#define TRACE_RING_NUM				5
+#define TRACE_RING_MAIN_SIZE		16		// Records, power of 2
+#define TRACE_RING_IRQ_SIZE			4		// Records, power of 2
+
+#define TRACE_DUMP_RECORDS			16		// Records per SEGCP TD reply
+
+// Event code; the order of the host decoder table
+typedef enum {
+	TRACE_NONE = 0,
+	TRACE_UART_RING_FULL,		// UART Rx ring buffer full, the serial data is discarded until read
+	TRACE_UART_RTS_OFF,			// RTS/CTS: Rx stopped, RTS deasserted; arg16: ring buffer used size
+	TRACE_UART_RTS_ON,			// RTS/CTS: Rx resumed; arg16: ring buffer used size
+	TRACE_UART_XOFF,			// XON/XOFF: XOFF sent; arg16: ring buffer used size
+	TRACE_UART_XON,				// XON/XOFF: XON sent; arg16: ring buffer used size
+	TRACE_SEND_BUSY,			// The data is not sent, previous send in progress or error; arg8: socket, arg16: bytes dropped
+	TRACE_SEND_SHORT,			// The data is partly sent; arg8: socket, arg16: bytes dropped
+	TRACE_SOCK_STATE,			// Data socket status (Sn_SR) changed; arg8: socket, arg16: [old status << 8 | new status]
+	TRACE_PACK_FULL,			// Serial data packing buffer full, sent before a packing delimiter; arg16: packed size
+	TRACE_CONNECT,				// TCP client connection attempt; arg8: attempt, arg16: wait before the next attempt (msec)
+	TRACE_CONN_LOST,			// TCP client connection lost, the outage starts
+	TRACE_RECONNECTED,			// TCP client connected again; arg16: outage time (msec), saturated at 65535
+	TRACE_EVENT_MAX
+} teTRACE;
+
+// Record: 8 bytes
+struct __trace_record {
+	uint32_t time;				// usec timestamp (get_timer_usec), wraps around every 71 min
+	uint8_t event;				// teTRACE
+	uint8_t arg8;
+	uint16_t arg16;
+};
+
+// Called by both the interrupt handlers and the main loop
+void trace_event(teTRACE event, uint8_t arg8, uint16_t arg16);
+
+// Records written to the ring since the boot; the sequence number of the next record
+uint32_t get_trace_count(uint8_t ring);
+
+// Copies up to num records from the sequence number seq; seq is moved to the oldest record if overwritten
+// ret: records copied, *first: sequence number of the first record copied
+uint8_t get_trace_records(uint8_t ring, uint32_t seq, struct __trace_record * rec, uint8_t num, uint32_t * first);
+
+#endif /* TRACEHANDLER_H_ */
@@ -6,6 +6,10 @@
 #include "configdata.h"
 #include "uartHandler.h"
 #include "seg.h"
+#include "eventHandler.h"
+#include "timerHandler.h"
+#include "profileHandler.h"
+#include "traceHandler.h"
 
 #include <stdio.h> // for debugging
 
@@ -42,7 +46,7 @@ BUFFER_DEFINITION(data_rx, SEG_DATA_BUF_SIZE);
 	IRQn_Type 			UART_data_irq = UART1_IRQn;
 #endif
 
-//uint32_t baud_table[] = {300, 600, 1200, 1800, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 115200, 230400};
+static const uint32_t baud_table[] = {300, 600, 1200, 1800, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 115200, 230400};
 uint8_t word_len_table[] = {7, 8, 9};
 uint8_t * parity_table[] = {(uint8_t *)"N", (uint8_t *)"ODD", (uint8_t *)"EVEN"};
 uint8_t stop_bit_table[] = {1, 2};
@@ -55,6 +59,24 @@ static uint8_t xonoff_status = UART_XON;
 // UART Interface selecter; RS-422 or RS-485 use only
 static uint8_t uart_if_mode = UART_IF_RS422;
 
+// Timer tick of the last byte received by the data UART; for the frame silence detection
+static volatile uint32_t uart_rx_tick = 0;
+
+// Arrival marks of the serial data bursts; for the arrival time of the buffered data
+// [count]: bytes stored in the ring buffer before the burst, [tick]: arrival of the first byte of the burst
+// The oldest mark is kept until its burst is read out; the bursts with no free mark are estimated from the previous mark
+static volatile uint32_t uart_rx_store_cnt = 0;
+static volatile uint32_t uart_rx_mark_cnt[UART_RX_MARK_NUM];
+static volatile uint32_t uart_rx_mark_tick[UART_RX_MARK_NUM];
+static volatile uint8_t uart_rx_mark_idx = 0;
+static uint32_t uart_rx_gap_tick = 0; // Idle gap starts a new burst: 2 characters time
+
+// Peak usage of the UART Rx ring buffer (bytes)
+static volatile uint16_t uart_rx_high_water = 0;
+
+// RTS/CTS: Rx stopped by the ring buffer usage, RTS deasserted; for the event trace
+static uint8_t uart_rx_rts_off = 0;
+
 /* Public functions ----------------------------------------------------------*/
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -66,16 +88,24 @@ static uint8_t uart_if_mode = UART_IF_RS422;
 void S2E_UART_IRQ_Handler(UART_TypeDef * s2e_uart)
 {
 	uint8_t ch; // 1-byte character variable for UART Interrupt request handler
+	uint32_t tick;
+	uint16_t used;
 	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
 	
+	PROFILE_ENTER(PROFILE_UART_IRQ);
+	
 	if(UART_GetITStatus(s2e_uart,  UART_IT_FLAG_RXI))
 	{
+		tick = get_timer_tick();
+		
 		if(IS_BUFFER_FULL(data_rx))
 		{
 			//UartGetc(s2e_uart);
 			UART_ReceiveData(s2e_uart);
 			
+			if(!flag_ringbuf_full) trace_event(TRACE_UART_RING_FULL, 0, 0); // Once per housekeeping period
 			flag_ringbuf_full = 1;
+			uart_rx_high_water = SEG_DATA_BUF_SIZE - 1;
 			
 			// buffer full => Serial data discard
 			//BUFFER_CLEAR(data_rx); // Data-UART buffer flush -> Does not use
@@ -84,10 +114,15 @@ void S2E_UART_IRQ_Handler(UART_TypeDef * s2e_uart)
 		{
 			if((serial->flow_control == flow_rts_cts) && (BUFFER_USED_SIZE(data_rx) > UART_OFF_THRESHOLD)) // CTS/RTS
 			{
-				; // Does nothing => RTS signal inactive
+				// Does not read the data => RTS signal inactive
+				if(!uart_rx_rts_off) trace_event(TRACE_UART_RTS_OFF, 0, BUFFER_USED_SIZE(data_rx));
+				uart_rx_rts_off = 1;
 			}
 			else
 			{
+				if(uart_rx_rts_off) trace_event(TRACE_UART_RTS_ON, 0, BUFFER_USED_SIZE(data_rx));
+				uart_rx_rts_off = 0;
+				
 				//ch = UartGetc(s2e_uart);
 				ch = UART_ReceiveData(s2e_uart);
 				
@@ -98,13 +133,30 @@ void S2E_UART_IRQ_Handler(UART_TypeDef * s2e_uart)
 				{
 					if(check_serial_store_permitted(ch)) // ret: [0] not permitted / [1] permitted
 					{
+						if(IS_BUFFER_EMPTY(data_rx) ||
+						   (((tick - uart_rx_tick) > uart_rx_gap_tick) &&
+							((int32_t)(uart_rx_mark_cnt[(uart_rx_mark_idx + 1) % UART_RX_MARK_NUM] - (uart_rx_store_cnt - BUFFER_USED_SIZE(data_rx))) <= 0)))
+						{
+							uart_rx_mark_cnt[uart_rx_mark_idx] = uart_rx_store_cnt;
+							uart_rx_mark_tick[uart_rx_mark_idx] = tick;
+							uart_rx_mark_idx = (uart_rx_mark_idx + 1) % UART_RX_MARK_NUM;
+						}
+						
 						BUFFER_IN(data_rx) = ch;
 						BUFFER_IN_MOVE(data_rx, 1);
+						uart_rx_store_cnt++;
+						
+						used = BUFFER_USED_SIZE(data_rx);
+						if(used > uart_rx_high_water) uart_rx_high_water = used;
 					}
 				}
 			}
 		}
 		init_time_delimiter_timer();
+		uart_rx_tick = tick;
+		
+		post_event(EVENT_SEG);
+		if(opmode == DEVICE_AT_MODE) post_event(EVENT_SEGCP);
 
 /*		else
 		{
@@ -135,6 +187,7 @@ void S2E_UART_IRQ_Handler(UART_TypeDef * s2e_uart)
 		UART_ClearITPendingBit(s2e_uart, UART_IT_FLAG_TXI);
 	}
 */
+	PROFILE_EXIT(PROFILE_UART_IRQ);
 }
 
 void S2E_UART_Configuration(void)
@@ -177,7 +230,6 @@ void serial_info_init(UART_TypeDef *pUART, struct __serial_info *serial)
 {
 	UART_InitTypeDef UART_InitStructure;
 	uint32_t valid_arg = 0;
-	uint32_t baud_table[] = {300, 600, 1200, 1800, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 115200, 230400};
 
 	/* Set Baud Rate */
 	if(serial->baud_rate < (sizeof(baud_table) / sizeof(baud_table[0])))
@@ -268,6 +320,8 @@ void serial_info_init(UART_TypeDef *pUART, struct __serial_info *serial)
 	/* Configure the UARTx */
 	UART_InitStructure.UART_Mode = UART_Mode_Rx | UART_Mode_Tx;
 	UART_Init(pUART, &UART_InitStructure);
+	
+	uart_rx_gap_tick = 2 * get_uart_char_time(serial) * (GetSystemClock() / 1000000);
 }
 
 
@@ -279,6 +333,7 @@ void check_uart_flow_control(uint8_t flow_ctrl)
 		{
 			UartPutc(UART_data, UART_XOFF);
 			xonoff_status = UART_XOFF;
+			trace_event(TRACE_UART_XOFF, 0, BUFFER_USED_SIZE(data_rx));
 #ifdef _UART_DEBUG_
 			printf(" >> SEND XOFF [%d]\r\n", BUFFER_USED_SIZE(data_rx));
 #endif
@@ -287,6 +342,7 @@ void check_uart_flow_control(uint8_t flow_ctrl)
 		{
 			UartPutc(UART_data, UART_XON);
 			xonoff_status = UART_XON;
+			trace_event(TRACE_UART_XON, 0, BUFFER_USED_SIZE(data_rx));
 #ifdef _UART_DEBUG_
 			printf(" >> SEND XON [%d]\r\n", BUFFER_USED_SIZE(data_rx));
 #endif
@@ -298,6 +354,76 @@ void check_uart_flow_control(uint8_t flow_ctrl)
 	//}
 }
 
+uint32_t get_uart_rx_tick(void)
+{
+	return uart_rx_tick;
+}
+
+// Time to transfer a character on the UART (usec): start bit + data bits + parity bit + stop bits
+uint32_t get_uart_char_time(struct __serial_info *serial)
+{
+	uint32_t baud = baud_table[baud_115200];
+	uint32_t bits;
+	
+	if(serial->baud_rate < (sizeof(baud_table) / sizeof(baud_table[0]))) baud = baud_table[serial->baud_rate];
+	
+	bits = 1 + word_len_table[serial->data_bits] + stop_bit_table[serial->stop_bits];
+	if(serial->parity != parity_none) bits++;
+	
+	return ((bits * 1000000) + baud - 1) / baud;
+}
+
+// Arrival time (usec timestamp, get_timer_usec) of the oldest byte in the ring buffer
+// The ISR timestamp if the byte starts a burst; otherwise estimated (*estimated = 1): the bytes following
+// the first byte of a burst are taken as back-to-back characters, never later than the actual arrival
+uint32_t get_uart_rx_head_time(uint8_t * estimated)
+{
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	uint32_t head_cnt;
+	uint32_t mark_cnt = 0;
+	uint32_t mark_tick = 0;
+	uint32_t last_tick;
+	uint32_t usec;
+	uint32_t last_usec;
+	uint8_t idx;
+	uint8_t i;
+	
+	__disable_irq();
+	head_cnt = uart_rx_store_cnt - BUFFER_USED_SIZE(data_rx);
+	last_tick = uart_rx_tick;
+	idx = uart_rx_mark_idx;
+	for(i = 0; i < UART_RX_MARK_NUM; i++) // Newest mark first
+	{
+		idx = (idx + UART_RX_MARK_NUM - 1) % UART_RX_MARK_NUM;
+		mark_cnt = uart_rx_mark_cnt[idx];
+		mark_tick = uart_rx_mark_tick[idx];
+		if((int32_t)(head_cnt - mark_cnt) >= 0) break;
+	}
+	__enable_irq();
+	
+	usec = get_timer_usec(mark_tick);
+	*estimated = (head_cnt != mark_cnt);
+	if((int32_t)(head_cnt - mark_cnt) > 0) usec += (head_cnt - mark_cnt) * get_uart_char_time(serial);
+	
+	last_usec = get_timer_usec(last_tick);
+	if((int32_t)(usec - last_usec) > 0) usec = last_usec;
+	
+	return usec;
+}
+
+uint16_t get_uart_rx_high_water(void)
+{
+	return uart_rx_high_water;
+}
+
+// Baud rate table index -> Baud rate (bps); ret: [0] invalid index
+uint32_t get_uart_baud_rate(uint8_t baud_idx)
+{
+	if(baud_idx >= (sizeof(baud_table) / sizeof(baud_table[0]))) return 0;
+	
+	return baud_table[baud_idx];
+}
+
 int32_t uart_putc(uint8_t uartNum, uint8_t ch)
 {
 	DevConfig *value = get_DevConfig_pointer();
@@ -13,6 +13,8 @@
 	#define DATA_BUF_SIZE 2048
 #endif
 
+#define UART_RX_MARK_NUM			8	// Arrival marks of the serial data bursts kept for the arrival time estimation
+
 // XON/XOFF: Transmitter On / Off, Software flow control
 #define UART_XON				0x11 // 17
 #define UART_XOFF				0x13 // 19
@@ -104,6 +106,7 @@ enum flow_ctrl {
 */
 
 extern uint8_t flag_ringbuf_full;
+extern UART_TypeDef * UART_data; // S2E data UART: UART0 or UART1 (SEG_DATA_UART)
 
 //extern uint32_t baud_table[]; // 14
 extern uint8_t word_len_table[];
@@ -121,6 +124,19 @@ void UART2_Configuration(void);
 
 void serial_info_init(UART_TypeDef *pUART, struct __serial_info *serial);
 
+// Data UART Rx timing: last received byte (timer tick) / character time (usec)
+uint32_t get_uart_rx_tick(void);
+uint32_t get_uart_char_time(struct __serial_info *serial);
+
+// Arrival time of the oldest byte in the UART ring buffer (usec timestamp); *estimated: [0] ISR timestamp / [1] estimated
+uint32_t get_uart_rx_head_time(uint8_t * estimated);
+
+// Peak usage of the UART Rx ring buffer (bytes); [SEG_DATA_BUF_SIZE - 1] the buffer was full
+uint16_t get_uart_rx_high_water(void);
+
+// Baud rate table index (enum baud) -> Baud rate (bps), [0] invalid index
+uint32_t get_uart_baud_rate(uint8_t baud_idx);
+
 // #1 XON/XOFF Software flow control: Check the Buffer usage and Send the start/stop commands
 void check_uart_flow_control(uint8_t flow_ctrl);
 
@@ -131,6 +147,7 @@ void check_uart_flow_control(uint8_t flow_ctrl);
 
 int32_t uart_putc(uint8_t uartNum, uint8_t ch);
 int32_t uart_getc(uint8_t uartNum);
+int32_t uart_getc_nonblk(uint8_t uartNum);
 int32_t uart_puts(uint8_t uartNum, uint8_t* buf, uint16_t reqSize);
 int32_t uart_gets(uint8_t uartNum, uint8_t* buf, uint16_t reqSize);
 
@@ -155,8 +172,7 @@ void uart_rs485_enable(uint8_t uartNum);
 	extern uint8_t _name##_buf[]; \
 	extern uint16_t _name##_wr, _name##_rd, _name##_sz;
 #define BUFFER_CLEAR(_name) \
-	_name##_wr=0;\
-	_name##_rd=0;
+	do { _name##_wr=0; _name##_rd=0; } while(0)
 
 #define BUFFER_USED_SIZE(_name) ((_name##_sz + _name##_wr - _name##_rd) % _name##_sz)
 #define BUFFER_FREE_SIZE(_name) ((_name##_sz + _name##_rd - _name##_wr - 1) % _name##_sz)
@@ -6,14 +6,28 @@
 #include "W7500x_board.h"
 #include "socket.h"
 #include "seg.h"
+#include "segframe.h"
+#include "segmodbus.h"
+#include "segtelnet.h"
+#include "segbench.h"
 #include "timerHandler.h"
 #include "uartHandler.h"
 #include "gpioHandler.h"
+#include "profileHandler.h"
+#include "eventHandler.h"
+#include "traceHandler.h"
 
 /* Private define ------------------------------------------------------------*/
 // Ring Buffer
 BUFFER_DECLARATION(data_rx);
 
+// Store-and-forward spill buffer: the oldest serial data of the TCP outage, the storage is g_recv_buf (Ethernet -> UART).
+// g_recv_buf is not used while there is no connection; until the spill buffer is sent, the peer's data is kept in the socket Rx buffer.
+#define data_spill_buf		g_recv_buf
+static uint16_t data_spill_wr = 0;
+static uint16_t data_spill_rd = 0;
+static uint16_t data_spill_sz = DATA_BUF_SIZE;
+
 /* Private variables ---------------------------------------------------------*/
 uint8_t flag_s2e_application_running = 0;
 
@@ -36,6 +50,16 @@ volatile uint16_t modeswitch_gap_time = DEFAULT_MODESWITCH_INTER_GAP;
 uint8_t enable_reconnection_timer = SEG_DISABLE;
 volatile uint16_t reconnection_time = 0;
 
+// TCP client reconnection: immediate retry once, then exponential backoff with jitter
+static uint8_t reconnect_attempt = 0;
+static uint16_t reconnect_delay = 0;
+volatile uint8_t flag_reconnect_outage = SEG_DISABLE; // Connection lost, serial data is kept until reconnected
+volatile uint32_t reconnect_outage_time = 0;
+static struct __reconnect_stat reconnect_stat;
+
+// Socket status last traced, TRACE_SOCK_STATE
+static uint8_t trace_sock_status[_WIZCHIP_SOCK_NUM_];
+
 uint8_t enable_serial_input_timer = SEG_DISABLE;
 volatile uint16_t serial_input_time = 0;
 uint8_t flag_serial_input_time_elapse = SEG_DISABLE; // for Time delimiter
@@ -48,6 +72,7 @@ volatile uint16_t connection_auth_time = 0;
 uint8_t flag_connect_pw_auth = SEG_DISABLE; // TCP_SERVER_MODE only
 uint8_t flag_sent_keepalive = SEG_DISABLE;
 uint8_t flag_sent_first_keepalive = SEG_DISABLE;
+uint8_t flag_keepalive_auto = SEG_DISABLE; // Keep-alive packets are sent by WZTOE (Sn_KPALVTR)
 
 // static variables for function: check_modeswitch_trigger()
 static uint8_t triggercode_idx;
@@ -59,21 +84,55 @@ extern uint8_t g_recv_buf[DATA_BUF_SIZE];
 uint16_t u2e_size = 0;
 uint16_t e2u_size = 0;
 
-// S2E Data byte count variables
-volatile uint32_t s2e_uart_rx_bytecount = 0;
-volatile uint32_t s2e_uart_tx_bytecount = 0;
-volatile uint32_t s2e_ether_rx_bytecount = 0;
-volatile uint32_t s2e_ether_tx_bytecount = 0;
+// S2E Data byte / packet count variables, indexed by teDATADIR
+static uint64_t data_transfer_bytes[SEG_ALL];
+static uint64_t data_transfer_packets[SEG_ALL];
+
+// Data transfer rates; counter snapshots (low 32 bits): the last one of the 1 sec updates, 10 sec ring
+struct __transfer_snap {
+	uint32_t bytes[SEG_ALL];
+	uint32_t packets[SEG_ALL];
+};
+static struct __transfer_snap transfer_snap_sec;
+static struct __transfer_snap transfer_snap_10sec[TRANSFER_RATE_10SEC_SNAPS];
+static uint8_t transfer_snap_sec_valid = 0;
+static uint8_t transfer_snap_10sec_idx = 0;
+static uint8_t transfer_snap_10sec_cnt = 0;
+static uint8_t transfer_snap_10sec_phase = 0;
+static uint32_t transfer_byte_rate[SEG_ALL][TRANSFER_RATE_WINDOWS];
+static uint32_t transfer_packet_rate[SEG_ALL][TRANSFER_RATE_WINDOWS];
 
 // UDP: Peer netinfo
 uint8_t peerip[4] = {0, };
 uint8_t peerip_tmp[4] = {0xff, };
 uint16_t peerport = 0;
 
+// UDP_MODE: Payload bytes of a datagram larger than the user's buffer, left at the head of the socket Rx buffer for the next pass
+static uint16_t udp_remain_size = 0;
+
+// L2_TUNNEL_MODE: Peer MAC address is learned from the first tunnel frame received, kept until the socket is re-opened
+static uint8_t l2tunnel_peer_mac[6];
+static uint8_t flag_l2tunnel_peer = SEG_DISABLE;
+static uint16_t l2tunnel_tx_seq = 0;
+static uint16_t l2tunnel_rx_seq = 0; // Next expected sequence number
+static struct __l2tunnel_stat l2tunnel_stat;
+
+// Store-and-forward: the serial data buffered during the outage is replayed in order after connected
+static uint32_t sf_replay_len = 0;
+static uint32_t sf_replay_remain = 0;
+static uint32_t sf_replay_tick = 0;
+static struct __store_forward_stat store_forward_stat;
+
+// Data path latency histograms; start timestamps (usec) of the packet in progress
+static struct __latency_hist latency_hist[LATENCY_PATH_MAX];
+static uint32_t u2e_arrival_usec = 0;
+static uint8_t flag_u2e_arrival = SEG_DISABLE; // Arrival time of the first byte is known
+static uint32_t e2u_recv_usec = 0;
+
 // XON/XOFF (Software flow control) flag, Serial data can be transmitted to peer when XON enabled. 
 uint8_t isXON = SEG_ENABLE;
 
-char * str_working[] = {"TCP_CLIENT_MODE", "TCP_SERVER_MODE", "TCP_MIXED_MODE", "UDP_MODE"};
+char * str_working[] = {"TCP_CLIENT_MODE", "TCP_SERVER_MODE", "TCP_MIXED_MODE", "UDP_MODE", "L2_TUNNEL_MODE", "MODBUS_GATEWAY_MODE"};
 
 uint8_t flag_process_dhcp_success = OFF;
 uint8_t flag_process_dns_success = OFF;
@@ -88,10 +147,16 @@ void proc_SEG_tcp_client(uint8_t sock);
 void proc_SEG_tcp_server(uint8_t sock);
 void proc_SEG_tcp_mixed(uint8_t sock);
 void proc_SEG_udp(uint8_t sock);
+void proc_SEG_l2tunnel(uint8_t sock);
+
+uint16_t send_l2tunnel_frame(uint8_t sock, uint8_t * buf, uint16_t len);
+uint16_t recv_l2tunnel_frame(uint8_t sock, uint8_t * buf, uint16_t len);
+uint16_t recv_udp_datagrams(uint8_t sock, uint8_t * buf, uint16_t len);
 
 void uart_to_ether(uint8_t sock);
 void ether_to_uart(uint8_t sock);
 uint16_t get_serial_data(void);
+uint16_t get_serial_data_max(void);
 void reset_SEG_timeflags(void);
 uint8_t check_connect_pw_auth(uint8_t * buf, uint16_t len);
 void restore_serial_data(uint8_t idx);
@@ -101,8 +166,19 @@ uint8_t check_tcp_connect_exception(void);
 void set_device_status(teDEVSTATUS status);
 uint16_t get_tcp_any_port(void);
 
-// UART tx/rx and Ethernet tx/rx data transfer bytes counter
-void add_data_transfer_bytecount(teDATADIR dir, uint16_t len);
+void start_reconnect_outage(void);
+uint16_t get_reconnect_delay(uint8_t attempt);
+
+uint8_t get_store_forward_enabled(void);
+void spill_serial_data(void);
+
+void add_latency_sample(teLATENCYPATH path, uint32_t start_usec);
+
+void update_transfer_rate(void);
+void start_store_forward_replay(void);
+void update_store_forward_replay(uint16_t len);
+
+static uint8_t is_seg_timer_event(void);
 
 /* Public & Private functions ------------------------------------------------*/
 
@@ -112,6 +188,7 @@ void do_seg(uint8_t sock)
 	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
 	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
 	struct __firmware_update *fwupdate = (struct __firmware_update *)&(get_DevConfig_pointer()->firmware_update);
+	struct __network_option *netopt = (struct __network_option *)&(get_DevConfig_pointer()->network_option);
 	
 //#ifdef _SEG_DEBUG_
 #if 1
@@ -140,6 +217,13 @@ void do_seg(uint8_t sock)
 	// Firmware update: Do not run SEG process
 	if(fwupdate->fwup_flag == SEG_ENABLE) return;
 	
+	// Line-rate self-test: the S2E data path is suspended
+	if(get_bench_state() != BENCH_IDLE)
+	{
+		do_bench(sock);
+		return;
+	}
+	
 	// Serial AT command mode enabled, initial settings
 	if((opmode == DEVICE_GW_MODE) && (sw_modeswitch_at_mode_on == SEG_ENABLE))
 	{
@@ -173,6 +257,14 @@ void do_seg(uint8_t sock)
 				proc_SEG_udp(sock);
 				break;
 			
+			case L2_TUNNEL_MODE:
+				proc_SEG_l2tunnel(sock);
+				break;
+			
+			case MODBUS_GATEWAY_MODE:
+				proc_SEG_modbus(); // Master sockets: SOCK_DATA, SOCK_MODBUS
+				break;
+			
 			default:
 				break;
 		}
@@ -180,6 +272,19 @@ void do_seg(uint8_t sock)
 		// XON/XOFF Software flow control: Check the Buffer usage and Send the start/stop commands
 		// [WIZnet Device] -> [Peer]
 		if(serial->flow_control == flow_xon_xoff) check_uart_flow_control(flow_xon_xoff);
+		
+		// Store-and-forward: the UART ring buffer is spilled during the outage; the spilled data is dropped when it is turned off (SF, working mode)
+		if(get_store_forward_enabled() == SEG_ENABLE)
+		{
+			if(net->state == ST_OPEN) spill_serial_data();
+		}
+		else if(!IS_BUFFER_EMPTY(data_spill))
+		{
+			BUFFER_CLEAR(data_spill);
+		}
+		
+		// RFC 2217: Modem state lines change notification
+		if((netopt->option_flags & NET_OPTION_TELNET_COM_PORT) && (net->state == ST_CONNECT)) check_telnet_modemstate(sock);
 	}
 }
 
@@ -225,6 +330,14 @@ uint8_t get_device_status(void)
 	return net->state;
 }
 
+void trace_sock_state(uint8_t sock, uint8_t state)
+{
+	if(state == trace_sock_status[sock]) return;
+	
+	trace_event(TRACE_SOCK_STATE, sock, ((uint16_t)trace_sock_status[sock] << 8) | state);
+	trace_sock_status[sock] = state;
+}
+
 
 void proc_SEG_udp(uint8_t sock)
 {
@@ -233,6 +346,7 @@ void proc_SEG_udp(uint8_t sock)
 	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
 	
 	uint8_t state = getSn_SR(sock);
+	trace_sock_state(sock, state);
 	switch(state)
 	{
 		case SOCK_UDP:
@@ -246,6 +360,7 @@ void proc_SEG_udp(uint8_t sock)
 		
 			u2e_size = 0;
 			e2u_size = 0;
+			udp_remain_size = 0;
 			
 			if(socket(sock, Sn_MR_UDP, net->local_port, 0) == sock)
 			{
@@ -264,6 +379,245 @@ void proc_SEG_udp(uint8_t sock)
 	}
 }
 
+// L2_TUNNEL_MODE: Point-to-point serial tunnel between two devices on the same LAN segment.
+// No TCP/IP headers, ACKs or retransmissions; frame loss is detected by the sequence number and counted only.
+// MACRAW mode is available on socket 0 (SOCK_DATA) only.
+void proc_SEG_l2tunnel(uint8_t sock)
+{
+	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	
+	uint8_t state = getSn_SR(sock);
+	trace_sock_state(sock, state);
+	switch(state)
+	{
+		case SOCK_MACRAW:
+			if(BUFFER_USED_SIZE(data_rx) || u2e_size)	uart_to_ether(sock);
+			if(getSn_RX_RSR(sock) 	|| e2u_size)		ether_to_uart(sock);
+			break;
+			
+		case SOCK_CLOSED:
+			BUFFER_CLEAR(data_rx);
+		
+			u2e_size = 0;
+			e2u_size = 0;
+			
+			flag_l2tunnel_peer = SEG_DISABLE;
+			l2tunnel_tx_seq = 0;
+			l2tunnel_rx_seq = 0;
+			
+			// Receives the broadcast, multicast and own MAC address frames only
+			if(socket(sock, Sn_MR_MACRAW, 0, SF_ETHER_OWN) == sock)
+			{
+				set_device_status(ST_UDP);
+				
+				if(net->packing_time) modeswitch_gap_time = net->packing_time; // replace the GAP time (default: 500ms)
+				
+				if(serial->serial_debug_en == SEG_ENABLE)
+				{
+					printf(" > SEG:L2_TUNNEL_MODE:SOCKOPEN\r\n");
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+
+// Serial data -> Tunnel frame(s). Broadcast until the peer is learned.
+// Large serial data is split into several frames; ret: sent payload length
+uint16_t send_l2tunnel_frame(uint8_t sock, uint8_t * buf, uint16_t len)
+{
+	static const uint8_t pad[L2TUNNEL_FRAME_MIN - L2TUNNEL_HEADER_LEN] = {0, };
+	uint8_t *mac = get_DevConfig_pointer()->network_info_common.mac;
+	uint8_t hdr[L2TUNNEL_HEADER_LEN];
+	uint16_t sent = 0;
+	uint16_t size;
+	uint16_t padlen;
+	
+	while(sent < len)
+	{
+		size = len - sent;
+		if(size > L2TUNNEL_PAYLOAD_MAX) size = L2TUNNEL_PAYLOAD_MAX;
+		padlen = ((L2TUNNEL_HEADER_LEN + size) < L2TUNNEL_FRAME_MIN) ? (L2TUNNEL_FRAME_MIN - L2TUNNEL_HEADER_LEN - size) : 0;
+		
+		if(flag_l2tunnel_peer == SEG_ENABLE)	memcpy(&hdr[0], l2tunnel_peer_mac, 6);
+		else									memset(&hdr[0], 0xff, 6);
+		memcpy(&hdr[6], mac, 6);
+		hdr[12] = (uint8_t)(L2TUNNEL_ETHERTYPE >> 8);
+		hdr[13] = (uint8_t)(L2TUNNEL_ETHERTYPE & 0xff);
+		hdr[14] = (uint8_t)(l2tunnel_tx_seq >> 8);
+		hdr[15] = (uint8_t)(l2tunnel_tx_seq & 0xff);
+		hdr[16] = (uint8_t)(size >> 8);
+		hdr[17] = (uint8_t)(size & 0xff);
+		
+		// Header, payload and padding are copied to the socket Tx buffer in place; no frame assembly buffer
+		while(getSn_TX_FSR(sock) < (L2TUNNEL_HEADER_LEN + size + padlen))
+		{
+			if(getSn_SR(sock) != SOCK_MACRAW) return sent;
+		}
+		
+		wiz_send_data(sock, hdr, L2TUNNEL_HEADER_LEN);
+		wiz_send_data(sock, &buf[sent], size);
+		if(padlen) wiz_send_data(sock, (uint8_t *)pad, padlen);
+		
+		setSn_CR(sock, Sn_CR_SEND);
+		while(getSn_CR(sock));
+		
+		while(!(getSn_IR(sock) & Sn_IR_SENDOK))
+		{
+			if(getSn_SR(sock) != SOCK_MACRAW) return sent;
+		}
+		setSn_ICR(sock, Sn_IR_SENDOK);
+		
+		l2tunnel_tx_seq++;
+		l2tunnel_stat.tx_cnt++;
+		sent += size;
+	}
+	
+	return sent;
+}
+
+
+// Tunnel frame -> Serial data, one frame per call. The payload is moved to the beginning of the buffer.
+// ret: payload length, [0] not a tunnel frame from the peer or dropped
+uint16_t recv_l2tunnel_frame(uint8_t sock, uint8_t * buf, uint16_t len)
+{
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	uint8_t addr[4];
+	uint16_t port;
+	int32_t ret;
+	uint16_t seq;
+	uint16_t size;
+	uint16_t gap;
+	
+	ret = recvfrom(sock, buf, len, addr, &port);
+	if(ret < L2TUNNEL_HEADER_LEN) return 0;
+	
+	// Other protocols are also received by the MACRAW socket
+	if((((uint16_t)buf[12] << 8) | buf[13]) != L2TUNNEL_ETHERTYPE) return 0;
+	
+	seq = ((uint16_t)buf[14] << 8) | buf[15];
+	size = ((uint16_t)buf[16] << 8) | buf[17];
+	
+	if(flag_l2tunnel_peer == SEG_DISABLE)
+	{
+		memcpy(l2tunnel_peer_mac, &buf[6], 6);
+		flag_l2tunnel_peer = SEG_ENABLE;
+		l2tunnel_rx_seq = seq;
+		
+		if(serial->serial_debug_en == SEG_ENABLE)
+		{
+			printf(" > SEG:L2_TUNNEL_MODE:PEER %02X:%02X:%02X:%02X:%02X:%02X\r\n", buf[6], buf[7], buf[8], buf[9], buf[10], buf[11]);
+		}
+	}
+	else if(memcmp(l2tunnel_peer_mac, &buf[6], 6) != 0)
+	{
+		return 0;
+	}
+	
+	if(size > (ret - L2TUNNEL_HEADER_LEN))
+	{
+		l2tunnel_stat.drop_cnt++;
+		return 0;
+	}
+	
+	// Sequence number 0 is also sent by a restarted peer: re-synchronized without counting the gap as lost
+	if((seq == 0) && (l2tunnel_rx_seq != 0)) l2tunnel_rx_seq = 0;
+	
+	gap = seq - l2tunnel_rx_seq;
+	if(gap & 0x8000) // Behind the expected sequence number
+	{
+		l2tunnel_stat.drop_cnt++;
+		return 0;
+	}
+	
+	l2tunnel_stat.lost_cnt += gap;
+	l2tunnel_stat.rx_cnt++;
+	l2tunnel_rx_seq = seq + 1;
+	
+	memmove(buf, &buf[L2TUNNEL_HEADER_LEN], size);
+	
+	return size;
+}
+
+
+// UDP_MODE: Drains the queued datagrams up to SEG_UDP_DRAIN_BUDGET in one pass.
+// The 8-byte headers ([IP 4][Port 2][Length 2]) are parsed in the socket Rx buffer and only the payloads are copied,
+// so the datagrams are handed to the UART as one contiguous run. A datagram is split across passes only if it is larger than the user's buffer:
+// the rest is copied first by the next pass, before the headers are parsed again.
+// A pass holds the datagrams of one peer: the UDP 1:N serial data is sent to the peer of the last run (peerip / peerport).
+// ret: payload length copied to the user's buffer
+uint16_t recv_udp_datagrams(uint8_t sock, uint8_t * buf, uint16_t len)
+{
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	uint8_t head[8];
+	uint16_t rsr;
+	uint16_t rd = 0; // Socket Rx buffer offset
+	uint16_t wr = 0; // User's buffer offset
+	uint16_t size;
+	uint8_t cnt;
+	
+	rsr = getSn_RX_RSR(sock);
+	
+	// The rest of a datagram larger than the user's buffer (no header)
+	if(udp_remain_size != 0)
+	{
+		size = udp_remain_size;
+		if(size > len) size = len;
+		if(size > rsr) size = rsr;
+		
+		wiz_recv_peek(sock, 0, buf, size);
+		rd = size;
+		wr = size;
+		udp_remain_size -= size;
+	}
+	
+	for(cnt = 0; (udp_remain_size == 0) && (cnt < SEG_UDP_DRAIN_BUDGET) && ((rsr - rd) >= sizeof(head)); cnt++)
+	{
+		wiz_recv_peek(sock, rd, head, sizeof(head));
+		size = ((uint16_t)head[6] << 8) | head[7];
+		
+		if((rsr - rd - sizeof(head)) < size) break;
+		
+		// Another peer: left for the next pass
+		if((wr != 0) && ((memcmp(peerip, head, 4) != 0) || (peerport != (((uint16_t)head[4] << 8) | head[5])))) break;
+		
+		if((len - wr) < size)
+		{
+			if(wr != 0) break; // Remains in the socket Rx buffer for the next pass
+			
+			// Larger than the user's buffer: the first part now, the rest by the next passes
+			udp_remain_size = size - len;
+			size = len;
+		}
+		
+		memcpy(peerip, head, 4);
+		peerport = ((uint16_t)head[4] << 8) | head[5];
+		
+		wiz_recv_peek(sock, rd + sizeof(head), &buf[wr], size);
+		rd += sizeof(head) + size;
+		wr += size;
+	}
+	
+	if(rd != 0)
+	{
+		wiz_recv_ignore(sock, rd);
+		setSn_CR(sock, Sn_CR_RECV);
+		while(getSn_CR(sock));
+	}
+	
+	if(memcmp(peerip_tmp, peerip, 4) !=  0)
+	{
+		memcpy(peerip_tmp, peerip, 4);
+		if(serial->serial_debug_en == SEG_ENABLE) printf(" > UDP Peer IP/Port: %d.%d.%d.%d : %d\r\n", peerip[0], peerip[1], peerip[2], peerip[3], peerport);
+	}
+	
+	return wr;
+}
+
+
 void proc_SEG_tcp_client(uint8_t sock)
 {
 	DevConfig *s2e = get_DevConfig_pointer();
@@ -275,21 +629,33 @@ void proc_SEG_tcp_client(uint8_t sock)
 	uint8_t destip[4] = {0, };
 	uint16_t destport = 0;
 	
+	uint8_t io_mode;
+	
 	uint8_t state = getSn_SR(sock);
+	trace_sock_state(sock, state);
 	switch(state)
 	{
 		case SOCK_INIT:
-			if(reconnection_time >= net->reconnection)
+			if(reconnection_time >= reconnect_delay)
 			{
 				reconnection_time = 0; // reconnection time variable clear
 				
+				// Wait time before the next connection attempt
+				if(reconnect_attempt < 0xFF) reconnect_attempt++;
+				reconnect_delay = get_reconnect_delay(reconnect_attempt);
+				
 				// TCP connect exception checker; e.g., dns failed / zero srcip ... and etc.
 				if(check_tcp_connect_exception() == ON) return;
 				
-				// TCP connect
+				// TCP connect: non-blocking, the result is checked by the socket status (SOCK_ESTABLISHED or SOCK_CLOSED)
+				io_mode = SOCK_IO_NONBLOCK;
+				ctlsocket(sock, CS_SET_IOMODE, &io_mode);
 				connect(sock, net->remote_ip, net->remote_port);
+				
+				reconnect_stat.attempt_cnt++;
+				trace_event(TRACE_CONNECT, reconnect_attempt, reconnect_delay);
 #ifdef _SEG_DEBUG_
-				printf(" > SEG:TCP_CLIENT_MODE:CLIENT_CONNECTION\r\n");
+				printf(" > SEG:TCP_CLIENT_MODE:CLIENT_CONNECTION [%d]\r\n", reconnect_attempt);
 #endif
 			}
 			break;
@@ -304,7 +670,9 @@ void proc_SEG_tcp_client(uint8_t sock)
 				set_device_status(ST_CONNECT);
 				
 				if(!inactivity_time && net->inactivity)		enable_inactivity_timer = SEG_ENABLE;
-				if(!keepalive_time && net->keepalive_en)	enable_keepalive_timer = SEG_ENABLE;
+				if((init_keepalive_auto(sock) == SEG_DISABLE) && !keepalive_time && net->keepalive_en)	enable_keepalive_timer = SEG_ENABLE;
+				init_frame_session();
+				init_telnet_session();
 				
 				// TCP server mode only, This flag have to be enabled always at TCP client mode
 				//if(option->pw_connect_en == SEG_ENABLE)		flag_connect_pw_auth = SEG_ENABLE;
@@ -317,6 +685,13 @@ void proc_SEG_tcp_client(uint8_t sock)
 					reconnection_time = 0;
 				}
 				
+				// Back to the blocking mode for data transfer
+				io_mode = SOCK_IO_BLOCK;
+				ctlsocket(sock, CS_SET_IOMODE, &io_mode);
+				
+				reconnect_attempt = 0;
+				reconnect_delay = 0;
+				
 				// Serial debug message printout
 				if(serial->serial_debug_en == SEG_ENABLE)
 				{
@@ -325,8 +700,25 @@ void proc_SEG_tcp_client(uint8_t sock)
 					printf(" > SEG:CONNECTED TO - %d.%d.%d.%d : %d\r\n",destip[0], destip[1], destip[2], destip[3], destport);
 				}
 				
-				// UART Ring buffer clear
-				BUFFER_CLEAR(data_rx);
+				if(flag_reconnect_outage == SEG_ENABLE)
+				{
+					// Reconnected: the serial data received during the outage is sent to the peer
+					reconnect_stat.reconnect_cnt++;
+					reconnect_stat.last_time = reconnect_outage_time;
+					if(reconnect_stat.last_time > reconnect_stat.max_time) reconnect_stat.max_time = reconnect_stat.last_time;
+					
+					flag_reconnect_outage = SEG_DISABLE;
+					trace_event(TRACE_RECONNECTED, 0, (reconnect_stat.last_time > 0xFFFF) ? 0xFFFF : (uint16_t)reconnect_stat.last_time);
+					
+					if(serial->serial_debug_en == SEG_ENABLE) printf(" > SEG:RECONNECTED - %u (msec)\r\n", reconnect_stat.last_time);
+				}
+				else if(get_store_forward_enabled() == SEG_DISABLE)
+				{
+					// UART Ring buffer clear
+					BUFFER_CLEAR(data_rx);
+				}
+				
+				start_store_forward_replay();
 				
 				// Debug message enable flag: TCP client sokect open 
 				isSocketOpen_TCPclient = OFF;
@@ -335,7 +727,7 @@ void proc_SEG_tcp_client(uint8_t sock)
 			}
 			
 			// Serial to Ethernet process
-			if(BUFFER_USED_SIZE(data_rx) || u2e_size)	uart_to_ether(sock);
+			if(BUFFER_USED_SIZE(data_rx) || BUFFER_USED_SIZE(data_spill) || u2e_size)	uart_to_ether(sock);
 			if(getSn_RX_RSR(sock) 	|| e2u_size)		ether_to_uart(sock);
 			
 			// Check the inactivity timer
@@ -380,18 +772,26 @@ void proc_SEG_tcp_client(uint8_t sock)
 			break;
 		
 		case SOCK_CLOSE_WAIT:
+			if(get_device_status() == ST_CONNECT) start_reconnect_outage(); // FIN received
+			
 			while(getSn_RX_RSR(sock) || e2u_size) ether_to_uart(sock); // receive remaining packets
 			disconnect(sock);
 			break;
 		
 		case SOCK_FIN_WAIT:
 		case SOCK_CLOSED:
+			if(get_device_status() == ST_CONNECT) start_reconnect_outage(); // RST received or connection timeout
+			
 			set_device_status(ST_OPEN);
 			reset_SEG_timeflags();
 			
-			u2e_size = 0;
+			// Packed serial data is kept during the outage
+			if((flag_reconnect_outage == SEG_DISABLE) && (get_store_forward_enabled() == SEG_DISABLE)) u2e_size = 0;
 			e2u_size = 0;
 			
+			io_mode = SOCK_IO_BLOCK;
+			ctlsocket(sock, CS_SET_IOMODE, &io_mode);
+			
 			source_port = get_tcp_any_port();
 #ifdef _SEG_DEBUG_
 			printf(" > TCP CLIENT: client_any_port = %d\r\n", client_any_port);
@@ -401,8 +801,9 @@ void proc_SEG_tcp_client(uint8_t sock)
 				// Replace the command mode switch code GAP time (default: 500ms)
 				if((option->serial_command == SEG_ENABLE) && net->packing_time) modeswitch_gap_time = net->packing_time;
 				
-				// Enable the reconnection Timer
-				if((enable_reconnection_timer == SEG_DISABLE) && net->reconnection) enable_reconnection_timer = SEG_ENABLE;
+				// Enable the reconnection Timer: the wait time is counted from the socket re-open
+				reconnection_time = 0;
+				enable_reconnection_timer = SEG_ENABLE;
 				
 				if(serial->serial_debug_en == SEG_ENABLE)
 				{
@@ -432,6 +833,7 @@ void proc_SEG_tcp_server(uint8_t sock)
 	uint16_t destport = 0;
 	
 	uint8_t state = getSn_SR(sock);
+	trace_sock_state(sock, state);
 	switch(state)
 	{
 		case SOCK_INIT:
@@ -452,6 +854,9 @@ void proc_SEG_tcp_server(uint8_t sock)
 				
 				if(!inactivity_time && net->inactivity)		enable_inactivity_timer = SEG_ENABLE;
 				//if(!keepalive_time && net->keepalive_en)	enable_keepalive_timer = SEG_ENABLE;
+				init_keepalive_auto(sock);
+				init_frame_session();
+				init_telnet_session();
 				
 				if(option->pw_connect_en == SEG_DISABLE)	flag_connect_pw_auth = SEG_ENABLE;		// TCP server mode only (+ mixed_server)
 				else
@@ -470,13 +875,18 @@ void proc_SEG_tcp_server(uint8_t sock)
 				}
 				
 				// UART Ring buffer clear
-				BUFFER_CLEAR(data_rx);
+				if(get_store_forward_enabled() == SEG_DISABLE)
+				{
+					BUFFER_CLEAR(data_rx);
+				}
+				
+				start_store_forward_replay();
 				
 				setSn_IR(sock, Sn_IR_CON);
 			}
 			
 			// Serial to Ethernet process
-			if(BUFFER_USED_SIZE(data_rx) || u2e_size)	uart_to_ether(sock);
+			if(BUFFER_USED_SIZE(data_rx) || BUFFER_USED_SIZE(data_spill) || u2e_size)	uart_to_ether(sock);
 			if(getSn_RX_RSR(sock) || e2u_size)	ether_to_uart(sock);
 			
 			// Check the inactivity timer
@@ -545,7 +955,7 @@ void proc_SEG_tcp_server(uint8_t sock)
 			set_device_status(ST_OPEN);
 			reset_SEG_timeflags();
 			
-			u2e_size = 0;
+			if(get_store_forward_enabled() == SEG_DISABLE) u2e_size = 0;
 			e2u_size = 0;
 
 			if(socket(sock, Sn_MR_TCP, net->local_port, Sn_MR_ND) == sock)
@@ -585,6 +995,7 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 #endif
 	
 	uint8_t state = getSn_SR(sock);
+	trace_sock_state(sock, state);
 	switch(state)
 	{
 		case SOCK_INIT:
@@ -600,7 +1011,10 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 #ifdef MIXED_CLIENT_LIMITED_CONNECT
 						process_socket_termination(sock);
 						reconnection_count = 0;
-						BUFFER_CLEAR(data_rx);
+						if(get_store_forward_enabled() == SEG_DISABLE)
+						{
+							BUFFER_CLEAR(data_rx);
+						}
 						mixed_state = MIXED_SERVER;
 #endif
 						return;
@@ -615,7 +1029,10 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 					{
 						process_socket_termination(sock);
 						reconnection_count = 0;
-						BUFFER_CLEAR(data_rx);
+						if(get_store_forward_enabled() == SEG_DISABLE)
+						{
+							BUFFER_CLEAR(data_rx);
+						}
 						mixed_state = MIXED_SERVER;
 					}
 	#ifdef _SEG_DEBUG_
@@ -630,7 +1047,7 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 		case SOCK_LISTEN:
 			// UART Rx interrupt detection in MIXED_SERVER mode
 			// => Switch to MIXED_CLIENT mode
-			if((mixed_state == MIXED_SERVER) && (BUFFER_USED_SIZE(data_rx)))
+			if((mixed_state == MIXED_SERVER) && (BUFFER_USED_SIZE(data_rx) || BUFFER_USED_SIZE(data_spill)))
 			{
 				process_socket_termination(sock);
 				mixed_state = MIXED_CLIENT;
@@ -649,7 +1066,9 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 				set_device_status(ST_CONNECT);
 				
 				if(!inactivity_time && net->inactivity)		enable_inactivity_timer = SEG_ENABLE;
-				if(!keepalive_time && net->keepalive_en)	enable_keepalive_timer = SEG_ENABLE;
+				if((init_keepalive_auto(sock) == SEG_DISABLE) && !keepalive_time && net->keepalive_en)	enable_keepalive_timer = SEG_ENABLE;
+				init_frame_session();
+				init_telnet_session();
 				
 				// Connection Password option: TCP server mode only (+ mixed_server)
 				if((option->pw_connect_en == SEG_DISABLE) || (mixed_state == MIXED_CLIENT))
@@ -678,7 +1097,10 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 				if(mixed_state == MIXED_SERVER)
 				{
 					// UART Ring buffer clear
-					BUFFER_CLEAR(data_rx);
+					if(get_store_forward_enabled() == SEG_DISABLE)
+					{
+						BUFFER_CLEAR(data_rx);
+					}
 				}
 				else if(mixed_state == MIXED_CLIENT)
 				{
@@ -690,11 +1112,13 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 				reconnection_count = 0;
 #endif
 				
+				start_store_forward_replay();
+				
 				setSn_IR(sock, Sn_IR_CON);
 			}
 			
 			// Serial to Ethernet process
-			if(BUFFER_USED_SIZE(data_rx) || u2e_size)	uart_to_ether(sock);
+			if(BUFFER_USED_SIZE(data_rx) || BUFFER_USED_SIZE(data_spill) || u2e_size)	uart_to_ether(sock);
 			if(getSn_RX_RSR(sock) 	|| e2u_size)		ether_to_uart(sock);
 			
 			// Check the inactivity timer
@@ -768,7 +1192,7 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 			{
 				reset_SEG_timeflags();
 				
-				u2e_size = 0;
+				if(get_store_forward_enabled() == SEG_DISABLE) u2e_size = 0;
 				e2u_size = 0;
 				
 				if(socket(sock, Sn_MR_TCP, net->local_port, Sn_MR_ND) == sock)
@@ -817,14 +1241,28 @@ void proc_SEG_tcp_mixed(uint8_t sock)
 void uart_to_ether(uint8_t sock)
 {
 	struct __network_info *netinfo = (struct __network_info *)&(get_DevConfig_pointer()->network_info);
+	struct __network_option *netopt = (struct __network_option *)&(get_DevConfig_pointer()->network_option);
 	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
 	uint16_t len;
+	int32_t ret;
 	
 	//uint16_t i; // ## for debugging
 	
+	PROFILE_ENTER(PROFILE_UART_TO_ETHER);
+	
+	// RFC 2217: Peer requested to suspend the data transfer (FLOWCONTROL-SUSPEND), the serial data is kept in the ring buffer
+	if((netopt->option_flags & NET_OPTION_TELNET_COM_PORT) && (get_telnet_flow_suspended() == SEG_ENABLE))
+	{
+		PROFILE_EXIT(PROFILE_UART_TO_ETHER);
+		return;
+	}
+	
 	// UART ring buffer -> user's buffer
+	CALL_PROBE_ENTER(PROFILE_GET_SERIAL_DATA);
 	len = get_serial_data();
+	CALL_PROBE_EXIT(PROFILE_GET_SERIAL_DATA);
 	add_data_transfer_bytecount(SEG_UART_RX, len);
+	if(sf_replay_remain) update_store_forward_replay(len);
 	
 	/*
 	// ## for debugging
@@ -859,24 +1297,55 @@ void uart_to_ether(uint8_t sock)
 					else
 					{
 						// UDP 1:N mode
-						sendto(sock, g_send_buf, len, peerip, peerport);
+						CALL_PROBE_ENTER(PROFILE_SOCK_SEND);
+						ret = sendto(sock, g_send_buf, len, peerip, peerport);
+						CALL_PROBE_EXIT(PROFILE_SOCK_SEND);
+						if(ret > 0) add_latency_sample(LATENCY_U2E, u2e_arrival_usec);
 					}
 				}
 				else
 				{
 					// UDP 1:1 mode
-					sendto(sock, g_send_buf, len, netinfo->remote_ip, netinfo->remote_port);
+					CALL_PROBE_ENTER(PROFILE_SOCK_SEND);
+					ret = sendto(sock, g_send_buf, len, netinfo->remote_ip, netinfo->remote_port);
+					CALL_PROBE_EXIT(PROFILE_SOCK_SEND);
+					if(ret > 0) add_latency_sample(LATENCY_U2E, u2e_arrival_usec);
 				}
 				
 				u2e_size = 0;
 				break;
 			
+			case SOCK_MACRAW: // L2_TUNNEL_MODE
+				CALL_PROBE_ENTER(PROFILE_SOCK_SEND);
+				len = send_l2tunnel_frame(sock, g_send_buf, len);
+				CALL_PROBE_EXIT(PROFILE_SOCK_SEND);
+				if(len) add_latency_sample(LATENCY_U2E, u2e_arrival_usec);
+				u2e_size = 0;
+				
+				add_data_transfer_bytecount(SEG_UART_TX, len);
+				break;
+			
 			case SOCK_ESTABLISHED: // TCP_SERVER_MODE, TCP_CLIENT_MODE, TCP_MIXED_MODE
 			case SOCK_CLOSE_WAIT:
 				// Connection password is only checked in the TCP SERVER MODE / TCP MIXED MODE (MIXED_SERVER)
 				if(flag_connect_pw_auth == SEG_ENABLE)
 				{
-					len = send(sock, g_send_buf, len);
+					if(netopt->option_flags & NET_OPTION_TELNET_COM_PORT)
+					{
+						len = encode_frame(netopt->frame_mode, g_send_buf, len, get_telnet_data_max(DATA_BUF_SIZE));
+						len = encode_telnet_data(g_send_buf, len);
+					}
+					else
+					{
+						len = encode_frame(netopt->frame_mode, g_send_buf, len, DATA_BUF_SIZE);
+					}
+					CALL_PROBE_ENTER(PROFILE_SOCK_SEND);
+					ret = send(sock, g_send_buf, len);
+					CALL_PROBE_EXIT(PROFILE_SOCK_SEND);
+					if(ret <= 0)				trace_event(TRACE_SEND_BUSY, sock, len);
+					else if(ret < (int32_t)len)	trace_event(TRACE_SEND_SHORT, sock, len - (uint16_t)ret);
+					len = (uint16_t)ret;
+					if(ret > 0) add_latency_sample(LATENCY_U2E, u2e_arrival_usec);
 					u2e_size = 0;
 					
 					add_data_transfer_bytecount(SEG_UART_TX, len);
@@ -884,7 +1353,7 @@ void uart_to_ether(uint8_t sock)
 					
 					//if(!keepalive_time && netinfo->keepalive_en)
 					//if((netinfo->keepalive_en == ENABLE) && (flag_sent_first_keepalive == DISABLE))
-					if(netinfo->keepalive_en == ENABLE)
+					if((netinfo->keepalive_en == ENABLE) && (flag_keepalive_auto == SEG_DISABLE))
 					{
 						if(flag_sent_first_keepalive == DISABLE)
 						{
@@ -901,6 +1370,7 @@ void uart_to_ether(uint8_t sock)
 			
 			case SOCK_LISTEN:
 				u2e_size = 0;
+				PROFILE_EXIT(PROFILE_UART_TO_ETHER);
 				return;
 			
 			default:
@@ -910,17 +1380,46 @@ void uart_to_ether(uint8_t sock)
 	
 	inactivity_time = 0;
 	//flag_serial_input_time_elapse = SEG_DISABLE; // this flag is cleared in the 'Data packing delimiter:time' checker routine
+	
+	PROFILE_EXIT(PROFILE_UART_TO_ETHER);
 }
 
 uint16_t get_serial_data(void)
 {
 	struct __network_info *netinfo = (struct __network_info *)&(get_DevConfig_pointer()->network_info);
+	struct __network_option *netopt = (struct __network_option *)&(get_DevConfig_pointer()->network_option);
 	uint16_t i;
 	uint16_t len;
+	uint16_t size_max = get_serial_data_max();
+	uint8_t estimated;
+	
+	// Store-and-forward: the spilled data is older than the UART ring buffer data, sent first without packing; arrival time unknown
+	if(!IS_BUFFER_EMPTY(data_spill))
+	{
+		if(u2e_size == 0)
+		{
+			set_frame_arrival_time(0, 0);
+			flag_u2e_arrival = SEG_DISABLE;
+		}
+		while(!IS_BUFFER_EMPTY(data_spill) && (u2e_size < size_max))
+		{
+			g_send_buf[u2e_size++] = BUFFER_OUT(data_spill);
+			BUFFER_OUT_MOVE(data_spill, 1);
+		}
+		return u2e_size;
+	}
 	
 	len = BUFFER_USED_SIZE(data_rx);
 	
-	if((len + u2e_size) >= DATA_BUF_SIZE) // Avoiding u2e buffer (g_send_buf) overflow	
+	// Arrival time of the first byte of the packet: latency histogram, FRAME_MODE_TIMESTAMP header
+	if((u2e_size == 0) && (len != 0))
+	{
+		u2e_arrival_usec = get_uart_rx_head_time(&estimated);
+		flag_u2e_arrival = SEG_ENABLE;
+		if(netopt->frame_mode == FRAME_MODE_TIMESTAMP) set_frame_arrival_time(u2e_arrival_usec, estimated);
+	}
+	
+	if((len + u2e_size) >= size_max) // Avoiding u2e buffer (g_send_buf) overflow	
 	{
 		/* Checking Data packing option: charactor delimiter */
 		if((netinfo->packing_delimiter[0] != 0x00) && (len == 1))
@@ -936,7 +1435,7 @@ uint16_t get_serial_data(void)
 		//return 0; 
 		
 		// serial data length value update for avoiding u2e buffer overflow
-		len = DATA_BUF_SIZE - u2e_size;
+		len = size_max - u2e_size;
 	}
 	
 	if((!netinfo->packing_time) && (!netinfo->packing_size) && (!netinfo->packing_delimiter[0])) // No Packing delimiters.
@@ -954,6 +1453,9 @@ uint16_t get_serial_data(void)
 	}
 	else
 	{
+		// Packing size reduced by a SEGCP request to the pending data or below: sent now, with no more serial data needed
+		if((netinfo->packing_size != 0) && (u2e_size >= netinfo->packing_size)) return u2e_size;
+		
 		/* Checking Data packing options */
 		for(i = 0; i < len; i++)
 		{
@@ -966,11 +1468,14 @@ uint16_t get_serial_data(void)
 			}
 			
 			// Packing delimiter: size option
-			if((netinfo->packing_size != 0) && (netinfo->packing_size == u2e_size))
+			if((netinfo->packing_size != 0) && (u2e_size >= netinfo->packing_size))
 			{
 				return u2e_size;
 			}
 		}
+		
+		// Traced: the buffer is full before a packing delimiter (the delimiter flushes are the normal data path, not traced)
+		if((len != 0) && (u2e_size >= size_max)) trace_event(TRACE_PACK_FULL, 0, u2e_size);
 	}
 	
 	// Packing delimiter: time option
@@ -984,37 +1489,65 @@ uint16_t get_serial_data(void)
 	return 0;
 }
 
+
+// Serial data size limit of the user's buffer (g_send_buf): TCP data is encoded in place, the encapsulation overhead is reserved
+// Telnet (RFC 2217): the frame is encoded within the first half of the buffer, the IAC escaping may double it
+uint16_t get_serial_data_max(void)
+{
+	struct __network_info *netinfo = (struct __network_info *)&(get_DevConfig_pointer()->network_info);
+	struct __network_option *netopt = (struct __network_option *)&(get_DevConfig_pointer()->network_option);
+	
+	if((netinfo->working_mode == UDP_MODE) || (netinfo->working_mode == L2_TUNNEL_MODE)) return DATA_BUF_SIZE;
+	
+	if(netopt->option_flags & NET_OPTION_TELNET_COM_PORT) return get_frame_data_max(netopt->frame_mode, get_telnet_data_max(DATA_BUF_SIZE));
+	
+	return get_frame_data_max(netopt->frame_mode, DATA_BUF_SIZE);
+}
+
 void ether_to_uart(uint8_t sock)
 {
 	struct __network_info *netinfo = (struct __network_info *)&(get_DevConfig_pointer()->network_info);
+	struct __network_option *netopt = (struct __network_option *)&(get_DevConfig_pointer()->network_option);
 	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
 	struct __options *option = (struct __options *)&(get_DevConfig_pointer()->options);
 	uint16_t len;
 	uint16_t i;
 	
+	PROFILE_ENTER(PROFILE_ETHER_TO_UART);
+	
+	// Store-and-forward: g_recv_buf holds the spilled serial data, the peer's data waits in the socket Rx buffer
+	if(!IS_BUFFER_EMPTY(data_spill))
+	{
+		PROFILE_EXIT(PROFILE_ETHER_TO_UART);
+		return;
+	}
+	
 	// H/W Socket buffer -> User's buffer
 	len = getSn_RX_RSR(sock);
 	if(len > DATA_BUF_SIZE) len = DATA_BUF_SIZE; // avoiding buffer overflow
 	
 	//printf("ether_to_uart: %d\r\n", len); // ## for debugging
 	
-	if(len > 0)
+	// The next data is read after the data held by the flow control (XOFF / DSR) is written to the UART
+	if((len > 0) && (e2u_size == 0))
 	{
+		e2u_recv_usec = get_timer_usec(get_timer_tick()); // Latency histogram: the chunk is read
+		
 		switch(getSn_SR(sock))
 		{
 			case SOCK_UDP: // UDP_MODE
-				e2u_size = recvfrom(sock, g_recv_buf, len, peerip, &peerport);
-				
-				if(memcmp(peerip_tmp, peerip, 4) !=  0)
-				{
-					memcpy(peerip_tmp, peerip, 4);
-					if(serial->serial_debug_en == SEG_ENABLE) printf(" > UDP Peer IP/Port: %d.%d.%d.%d : %d\r\n", peerip[0], peerip[1], peerip[2], peerip[3], peerport);
-				}
+				e2u_size = recv_udp_datagrams(sock, g_recv_buf, len);
 				break;
 			
 			case SOCK_ESTABLISHED: // TCP_SERVER_MODE, TCP_CLIENT_MODE, TCP_MIXED_MODE
 			case SOCK_CLOSE_WAIT:
 				e2u_size = recv(sock, g_recv_buf, len);
+				if(netopt->option_flags & NET_OPTION_TELNET_COM_PORT) e2u_size = decode_telnet_data(sock, g_recv_buf, e2u_size);
+				e2u_size = decode_frame(netopt->frame_mode, g_recv_buf, e2u_size);
+				break;
+			
+			case SOCK_MACRAW: // L2_TUNNEL_MODE
+				e2u_size = recv_l2tunnel_frame(sock, g_recv_buf, DATA_BUF_SIZE);
 				break;
 			
 			default:
@@ -1047,6 +1580,7 @@ void ether_to_uart(uint8_t sock)
 			if(flag_connect_pw_auth == SEG_DISABLE)
 			{
 				disconnect(sock);
+				PROFILE_EXIT(PROFILE_ETHER_TO_UART);
 				return;
 			}
 		}
@@ -1057,16 +1591,23 @@ void ether_to_uart(uint8_t sock)
 	{
 		if(serial->dsr_en == SEG_ENABLE) // DTR / DSR handshake (flowcontrol)
 		{
-			if(get_flowcontrol_dsr_pin() == 0) return;
+			if(get_flowcontrol_dsr_pin() == 0)
+			{
+				PROFILE_EXIT(PROFILE_ETHER_TO_UART);
+				return;
+			}
 		}
 //////////////////////////////////////////////////////////////////////
 		if(serial->uart_interface == UART_IF_RS422_485)
 		{
+			CALL_PROBE_ENTER(PROFILE_UART_PUTS);
 			uart_rs485_enable(SEG_DATA_UART);
 			uart_puts(SEG_DATA_UART, g_recv_buf, e2u_size);
 			uart_rs485_disable(SEG_DATA_UART);
+			CALL_PROBE_EXIT(PROFILE_UART_PUTS);
 			
 			add_data_transfer_bytecount(SEG_ETHER_TX, e2u_size);
+			add_latency_sample(LATENCY_E2U, e2u_recv_usec);
 			e2u_size = 0;
 		}
 //////////////////////////////////////////////////////////////////////
@@ -1074,8 +1615,11 @@ void ether_to_uart(uint8_t sock)
 		{
 			if(isXON == SEG_ENABLE)
 			{
+				CALL_PROBE_ENTER(PROFILE_UART_PUTS);
 				uart_puts(SEG_DATA_UART, g_recv_buf, e2u_size);
+				CALL_PROBE_EXIT(PROFILE_UART_PUTS);
 				add_data_transfer_bytecount(SEG_ETHER_TX, e2u_size);
+				add_latency_sample(LATENCY_E2U, e2u_recv_usec);
 				e2u_size = 0;
 			}
 			//else
@@ -1087,15 +1631,221 @@ void ether_to_uart(uint8_t sock)
 		{
 			//uart_puts(SEG_DATA_UART, g_recv_buf, e2u_size);
 			
+			CALL_PROBE_ENTER(PROFILE_UART_PUTS);
 			for(i = 0; i < e2u_size; i++)
 			{
 				uart_putc(SEG_DATA_UART, g_recv_buf[i]);
 			}
+			CALL_PROBE_EXIT(PROFILE_UART_PUTS);
 			
 			add_data_transfer_bytecount(SEG_ETHER_TX, e2u_size);
+			add_latency_sample(LATENCY_E2U, e2u_recv_usec);
 			e2u_size = 0;
 		}
 	}
+	
+	PROFILE_EXIT(PROFILE_ETHER_TO_UART);
+}
+
+
+void start_reconnect_outage(void)
+{
+	if(flag_reconnect_outage == SEG_ENABLE) return;
+	
+	reconnect_outage_time = 0;
+	flag_reconnect_outage = SEG_ENABLE;
+	trace_event(TRACE_CONN_LOST, 0, 0);
+	
+	reconnect_attempt = 0;
+	reconnect_delay = 0; // The first reconnection is tried immediately
+}
+
+
+// Wait time before the connection attempt, unit: msec
+// [1st] reconnection interval, doubled for each failure up to the backoff cap, randomized in range of [delay/2, delay]
+uint16_t get_reconnect_delay(uint8_t attempt)
+{
+	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
+	struct __network_option *netopt = (struct __network_option *)&(get_DevConfig_pointer()->network_option);
+	
+	uint8_t *mac = get_DevConfig_pointer()->network_info_common.mac;
+	
+	uint32_t delay;
+	uint32_t delay_max;
+	uint32_t r;
+	uint8_t i;
+	
+	delay = net->reconnection;
+	if(delay < RECONNECTION_MIN_INTERVAL) delay = RECONNECTION_MIN_INTERVAL;
+	
+	if(attempt == 0) return 0;
+	if(netopt->reconnect_backoff_max == 0) return (uint16_t)delay; // Backoff disabled: fixed interval
+	
+	delay_max = (uint32_t)netopt->reconnect_backoff_max * 1000;
+	if(delay_max > RECONNECTION_BACKOFF_LIMIT) delay_max = RECONNECTION_BACKOFF_LIMIT;
+	if(delay_max < delay) delay_max = delay;
+	
+	for(i = 1; (i < attempt) && (delay < delay_max); i++) delay <<= 1;
+	if(delay > delay_max) delay = delay_max;
+	
+	// Jitter: spreads out the reconnection of the devices lost the connection at the same time
+	// The devices powered up together have the same rand() sequence: the MAC address and the timer are mixed in
+	r = (uint32_t)rand() + get_timer_usec(get_timer_tick()) + ((((uint32_t)mac[4] << 8) | mac[5]) * 40503UL);
+	delay = (delay / 2) + (r % ((delay / 2) + 1));
+	
+	return (uint16_t)delay;
+}
+
+
+void get_reconnect_stat(struct __reconnect_stat * stat)
+{
+	memcpy(stat, &reconnect_stat, sizeof(struct __reconnect_stat));
+}
+
+
+void clear_reconnect_stat(void)
+{
+	memset(&reconnect_stat, 0, sizeof(struct __reconnect_stat));
+}
+
+
+void get_l2tunnel_stat(struct __l2tunnel_stat * stat)
+{
+	memcpy(stat, &l2tunnel_stat, sizeof(struct __l2tunnel_stat));
+}
+
+
+void clear_l2tunnel_stat(void)
+{
+	memset(&l2tunnel_stat, 0, sizeof(struct __l2tunnel_stat));
+}
+
+
+// Store-and-forward: TCP modes only
+uint8_t get_store_forward_enabled(void)
+{
+	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
+	struct __network_option *netopt = (struct __network_option *)&(get_DevConfig_pointer()->network_option);
+	
+	if(net->working_mode > TCP_MIXED_MODE) return SEG_DISABLE;
+	
+	return (netopt->option_flags & NET_OPTION_STORE_FORWARD) ? SEG_ENABLE : SEG_DISABLE;
+}
+
+
+// UART ring buffer -> Spill buffer, the data over the threshold (oldest first) is moved; the spilled data is always older than the ring buffer data.
+// Not used with the connection password (TCP server): the password is received into g_recv_buf.
+// When both buffers are full, the UART's flow control / drop applies.
+void spill_serial_data(void)
+{
+	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
+	struct __options *option = (struct __options *)&(get_DevConfig_pointer()->options);
+	uint32_t buffered;
+	
+	if((e2u_size == 0) && ((net->working_mode == TCP_CLIENT_MODE) || (option->pw_connect_en == SEG_DISABLE)))
+	{
+		while((BUFFER_USED_SIZE(data_rx) > SEG_SPILL_THRESHOLD) && !IS_BUFFER_FULL(data_spill))
+		{
+			BUFFER_IN(data_spill) = BUFFER_OUT(data_rx);
+			BUFFER_IN_MOVE(data_spill, 1);
+			BUFFER_OUT_MOVE(data_rx, 1);
+		}
+	}
+	
+	buffered = BUFFER_USED_SIZE(data_spill) + BUFFER_USED_SIZE(data_rx) + u2e_size;
+	if(buffered > store_forward_stat.buffered_max) store_forward_stat.buffered_max = buffered;
+}
+
+
+// Connection established: the buffered serial data size is taken as the replay length
+void start_store_forward_replay(void)
+{
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	
+	if(get_store_forward_enabled() == SEG_DISABLE) return;
+	
+	sf_replay_len = BUFFER_USED_SIZE(data_spill) + BUFFER_USED_SIZE(data_rx) + u2e_size;
+	sf_replay_remain = sf_replay_len;
+	sf_replay_tick = get_timer_tick();
+	
+	if(sf_replay_len > store_forward_stat.buffered_max) store_forward_stat.buffered_max = sf_replay_len;
+	
+	if((serial->serial_debug_en == SEG_ENABLE) && sf_replay_len) printf(" > SEG:STORE_FORWARD:REPLAY - %u bytes\r\n", sf_replay_len);
+}
+
+
+// Replay throughput: the replay length / time from the connection to the last buffered byte taken (bytes/sec)
+void update_store_forward_replay(uint16_t len)
+{
+	uint32_t usec;
+	
+	if(len < sf_replay_remain)
+	{
+		sf_replay_remain -= len;
+		return;
+	}
+	
+	sf_replay_remain = 0;
+	usec = timer_tick_to_usec(get_timer_tick() - sf_replay_tick);
+	
+	store_forward_stat.replay_cnt++;
+	store_forward_stat.replay_bytes += sf_replay_len;
+	store_forward_stat.replay_rate = usec ? (uint32_t)(((uint64_t)sf_replay_len * 1000000) / usec) : 0;
+}
+
+
+void get_store_forward_stat(struct __store_forward_stat * stat)
+{
+	memcpy(stat, &store_forward_stat, sizeof(struct __store_forward_stat));
+	stat->buffered = BUFFER_USED_SIZE(data_spill) + BUFFER_USED_SIZE(data_rx) + u2e_size;
+}
+
+
+// The spilled data is discarded: mode switch, line-rate self-test (g_recv_buf is used)
+void clear_store_forward_spill(void)
+{
+	BUFFER_CLEAR(data_spill);
+}
+
+
+void clear_store_forward_stat(void)
+{
+	memset(&store_forward_stat, 0, sizeof(struct __store_forward_stat));
+}
+
+
+// Latency from the start timestamp to now, counted into the log2 bucket: bit length of the usec value
+// U2E samples are taken only if the arrival time of the first byte is known
+void add_latency_sample(teLATENCYPATH path, uint32_t start_usec)
+{
+	uint32_t usec;
+	uint32_t tmp;
+	uint8_t idx = 0;
+	
+	if(path == LATENCY_U2E)
+	{
+		if(flag_u2e_arrival == SEG_DISABLE) return;
+		flag_u2e_arrival = SEG_DISABLE;
+	}
+	
+	usec = get_timer_usec(get_timer_tick()) - start_usec;
+	
+	for(tmp = usec; tmp && (idx < (LATENCY_HIST_BUCKETS - 1)); tmp >>= 1) idx++;
+	
+	latency_hist[path].bucket[idx]++;
+	if(usec > latency_hist[path].max) latency_hist[path].max = usec;
+}
+
+
+void get_latency_hist(teLATENCYPATH path, struct __latency_hist * hist)
+{
+	memcpy(hist, &latency_hist[path], sizeof(struct __latency_hist));
+}
+
+
+void clear_latency_hist(void)
+{
+	memset(latency_hist, 0, sizeof(latency_hist));
 }
 
 
@@ -1127,6 +1877,34 @@ void send_keepalive_packet_manual(uint8_t sock)
 }
 
 
+uint8_t init_keepalive_auto(uint8_t sock)
+{
+	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
+	struct __network_option *netopt = (struct __network_option *)&(get_DevConfig_pointer()->network_option);
+	
+	uint8_t kpalvtr = 0; // [0] WZTOE auto keep-alive disabled
+	uint32_t kpalv_time;
+	
+	if((net->keepalive_en == SEG_ENABLE) && (netopt->option_flags & NET_OPTION_KEEPALIVE_AUTO))
+	{
+		// Keep-alive retry time (msec) to Sn_KPALVTR (5sec unit)
+		kpalv_time = ((uint32_t)net->keepalive_retry_time + (KEEPALIVE_AUTO_TIME_UNIT - 1)) / KEEPALIVE_AUTO_TIME_UNIT;
+		if(kpalv_time == 0) kpalv_time = 1;
+		kpalvtr = (uint8_t)kpalv_time; // 65535ms / 5sec: fits in 8-bit
+	}
+	
+	// The peer is checked by WZTOE without the S2E keep-alive timer; Sn_IR_TIMEOUT closes the socket when the peer does not respond.
+	setsockopt(sock, SO_KEEPALIVEAUTO, &kpalvtr);
+	
+	flag_keepalive_auto = (kpalvtr != 0) ? SEG_ENABLE : SEG_DISABLE;
+#ifdef _SEG_DEBUG_
+	if(flag_keepalive_auto) printf(" > SOCKET[%x]: AUTO KEEP-ALIVE [%d] x 5sec\r\n", sock, kpalvtr);
+#endif
+	
+	return flag_keepalive_auto;
+}
+
+
 uint8_t process_socket_termination(uint8_t sock)
 {
 	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
@@ -1144,6 +1922,9 @@ uint8_t process_socket_termination(uint8_t sock)
 	
 	close(sock);
 	
+	// Modbus gateway: the other master connection is also terminated
+	if((net->working_mode == MODBUS_GATEWAY_MODE) && (sock == SEG_SOCK)) process_socket_termination(SOCK_MODBUS);
+	
 	return sock;
 }
 
@@ -1197,6 +1978,8 @@ void init_trigger_modeswitch(uint8_t mode)
 	
 	u2e_size = 0;
 	BUFFER_CLEAR(data_rx);
+	BUFFER_CLEAR(data_spill);
+	sf_replay_remain = 0;
 	
 	enable_inactivity_timer = SEG_DISABLE;
 	enable_keepalive_timer = SEG_DISABLE;
@@ -1221,6 +2004,7 @@ uint8_t check_modeswitch_trigger(uint8_t ch)
 	
 	if(opmode != DEVICE_GW_MODE) 				return 0;
 	if(option->serial_command == SEG_DISABLE) 	return 0;
+	if(get_bench_state() != BENCH_IDLE)			return 0; // Line-rate self-test: the looped PRBS data may contain the trigger code
 	
 	switch(triggercode_idx)
 	{
@@ -1287,9 +2071,22 @@ uint8_t check_serial_store_permitted(uint8_t ch)
 	
 	uint8_t ret = SEG_DISABLE; // SEG_DISABLE: Doesn't put the serial data in a ring buffer
 	
+	// Line-rate self-test: every looped byte is checked by the test, regardless of the connection state and XON/XOFF
+	if(get_bench_state() != BENCH_IDLE) return SEG_ENABLE;
+	
 	switch(net->state)
 	{
 		case ST_OPEN:
+			if((net->working_mode == TCP_CLIENT_MODE) && (flag_reconnect_outage == SEG_ENABLE))
+			{
+				ret = SEG_ENABLE; // Serial data is kept during the reconnection
+				break;
+			}
+			if(get_store_forward_enabled() == SEG_ENABLE)
+			{
+				ret = SEG_ENABLE; // Store-and-forward: Serial data is kept until connected
+				break;
+			}
 			if(net->working_mode != TCP_MIXED_MODE) break;
 		case ST_CONNECT:
 		case ST_UDP:
@@ -1410,103 +2207,130 @@ uint8_t check_tcp_connect_exception(void)
 
 void clear_data_transfer_bytecount(teDATADIR dir)
 {
-	switch(dir)
+	uint32_t primask;
+	
+	if(dir == SEG_ALL)
 	{
-		case SEG_ALL:
-			s2e_uart_rx_bytecount = 0;
-			s2e_uart_tx_bytecount = 0;
-			s2e_ether_rx_bytecount = 0;
-			s2e_ether_tx_bytecount = 0;
-			break;
-		
-		case SEG_UART_RX:
-			s2e_uart_rx_bytecount = 0;
-			break;
-		
-		case SEG_UART_TX:
-			s2e_uart_tx_bytecount = 0;
-			break;
-		
-		case SEG_ETHER_RX:
-			s2e_ether_rx_bytecount = 0;
-			break;
-		
-		case SEG_ETHER_TX:
-			s2e_ether_tx_bytecount = 0;
-			break;
-		
-		default:
-			break;
+		memset(data_transfer_bytes, 0, sizeof(data_transfer_bytes));
+		memset(data_transfer_packets, 0, sizeof(data_transfer_packets));
 	}
+	else if(dir < SEG_ALL)
+	{
+		data_transfer_bytes[dir] = 0;
+		data_transfer_packets[dir] = 0;
+	}
+	
+	// The snapshots taken before the clear are not valid: the rates restart from zero
+	primask = __get_PRIMASK();
+	__disable_irq();
+	transfer_snap_sec_valid = 0;
+	transfer_snap_10sec_cnt = 0;
+	transfer_snap_10sec_phase = 0;
+	memset(transfer_byte_rate, 0, sizeof(transfer_byte_rate));
+	memset(transfer_packet_rate, 0, sizeof(transfer_packet_rate));
+	__set_PRIMASK(primask);
 }
 
 
+// Called by the main loop only; a data block handled at once is counted as a packet
 void add_data_transfer_bytecount(teDATADIR dir, uint16_t len)
 {
-	if(len > 0)
+	if((len > 0) && (dir < SEG_ALL))
 	{
-		switch(dir)
-		{
-			case SEG_UART_RX:
-				if(s2e_uart_rx_bytecount < 0xffffffff)	s2e_uart_rx_bytecount += len;
-				else 									s2e_uart_rx_bytecount = 0;
-				break;
-			
-			case SEG_UART_TX:
-				if(s2e_uart_rx_bytecount < 0xffffffff)	s2e_uart_tx_bytecount += len;
-				else 									s2e_uart_tx_bytecount = 0;
-				break;
-			
-			case SEG_ETHER_RX:
-				if(s2e_uart_rx_bytecount < 0xffffffff)	s2e_ether_rx_bytecount += len;
-				else 									s2e_ether_rx_bytecount = 0;
-				break;
-			
-			case SEG_ETHER_TX:
-				if(s2e_uart_rx_bytecount < 0xffffffff)	s2e_ether_tx_bytecount += len;
-				else 									s2e_ether_tx_bytecount = 0;
-				break;
-			
-			default:
-				break;
-		}
+		data_transfer_bytes[dir] += len;
+		data_transfer_packets[dir]++;
 	}
 }
 
 
-uint32_t get_data_transfer_bytecount(teDATADIR dir)
+uint64_t get_data_transfer_bytecount(teDATADIR dir)
 {
-	uint32_t ret = 0;
+	if(dir >= SEG_ALL) return 0;
+	return data_transfer_bytes[dir];
+}
+
+
+void get_transfer_stat(teDATADIR dir, struct __transfer_stat * stat)
+{
+	uint32_t primask;
+	
+	if(dir >= SEG_ALL) return;
+	
+	stat->bytes = data_transfer_bytes[dir];
+	stat->packets = data_transfer_packets[dir];
+	
+	primask = __get_PRIMASK();
+	__disable_irq();
+	memcpy(stat->byte_rate, transfer_byte_rate[dir], sizeof(stat->byte_rate));
+	memcpy(stat->packet_rate, transfer_packet_rate[dir], sizeof(stat->packet_rate));
+	__set_PRIMASK(primask);
+}
+
+
+// Called by seg_timer_sec (timer interrupt); the rates are the counter differences over the windows.
+// The snapshots keep the low 32 bits of the counters, the word is read at once while the main loop updates the counter.
+// The first 10 sec snapshot is taken at once after boot or clear; until the 60 sec window is filled up, the rate is averaged over the periods available.
+void update_transfer_rate(void)
+{
+	uint32_t bytes[SEG_ALL];
+	uint32_t packets[SEG_ALL];
+	struct __transfer_snap * last;
+	struct __transfer_snap * oldest;
+	uint8_t cnt;
+	uint8_t i;
 	
-	switch(dir)
+	for(i = 0; i < SEG_ALL; i++)
 	{
-		case SEG_UART_RX:
-			ret = s2e_uart_rx_bytecount;
-			break;
-		
-		case SEG_UART_TX:
-			ret = s2e_uart_tx_bytecount;
-			break;
-		
-		case SEG_ETHER_RX:
-			ret = s2e_ether_rx_bytecount;
-			break;
-		
-		case SEG_ETHER_TX:
-			ret = s2e_ether_tx_bytecount;
-			break;
-		
-		default:
-			break;
+		bytes[i] = (uint32_t)data_transfer_bytes[i];
+		packets[i] = (uint32_t)data_transfer_packets[i];
 	}
-	return ret;
+	
+	// 1 sec window
+	if(transfer_snap_sec_valid)
+	{
+		for(i = 0; i < SEG_ALL; i++)
+		{
+			transfer_byte_rate[i][0] = bytes[i] - transfer_snap_sec.bytes[i];
+			transfer_packet_rate[i][0] = packets[i] - transfer_snap_sec.packets[i];
+		}
+	}
+	memcpy(transfer_snap_sec.bytes, bytes, sizeof(bytes));
+	memcpy(transfer_snap_sec.packets, packets, sizeof(packets));
+	transfer_snap_sec_valid = 1;
+	
+	// 10 sec / 60 sec windows, updated every 10 sec
+	if(transfer_snap_10sec_phase != 0)
+	{
+		transfer_snap_10sec_phase--;
+		return;
+	}
+	transfer_snap_10sec_phase = 10 - 1;
+	
+	cnt = transfer_snap_10sec_cnt;
+	if(cnt)
+	{
+		last = &transfer_snap_10sec[(transfer_snap_10sec_idx + TRANSFER_RATE_10SEC_SNAPS - 1) % TRANSFER_RATE_10SEC_SNAPS];
+		oldest = &transfer_snap_10sec[(transfer_snap_10sec_idx + TRANSFER_RATE_10SEC_SNAPS - cnt) % TRANSFER_RATE_10SEC_SNAPS];
+		for(i = 0; i < SEG_ALL; i++)
+		{
+			transfer_byte_rate[i][1] = (bytes[i] - last->bytes[i]) / 10;
+			transfer_packet_rate[i][1] = (packets[i] - last->packets[i]) / 10;
+			transfer_byte_rate[i][2] = (bytes[i] - oldest->bytes[i]) / (cnt * 10);
+			transfer_packet_rate[i][2] = (packets[i] - oldest->packets[i]) / (cnt * 10);
+		}
+	}
+	memcpy(transfer_snap_10sec[transfer_snap_10sec_idx].bytes, bytes, sizeof(bytes));
+	memcpy(transfer_snap_10sec[transfer_snap_10sec_idx].packets, packets, sizeof(packets));
+	transfer_snap_10sec_idx = (transfer_snap_10sec_idx + 1) % TRANSFER_RATE_10SEC_SNAPS;
+	if(transfer_snap_10sec_cnt < TRANSFER_RATE_10SEC_SNAPS) transfer_snap_10sec_cnt++;
 }
 
 
 // This function have to call every 1 millisecond by Timer IRQ handler routine.
-void seg_timer_msec(void)
+uint8_t seg_timer_msec(void)
 {
 	struct __network_info *netinfo = (struct __network_info *)&(get_DevConfig_pointer()->network_info);
+	uint8_t due = SEG_DISABLE;
 	
 	// Firmware update timer for timeout
 	// DHCP timer for timeout
@@ -1520,6 +2344,12 @@ void seg_timer_msec(void)
 		else 							reconnection_time = 0;
 	}
 	
+	// Reconnection outage timer: time-to-reconnect (msec)
+	if(flag_reconnect_outage)
+	{
+		if(reconnect_outage_time < 0xFFFFFFFF) reconnect_outage_time++;
+	}
+	
 	// Keep-alive timer: Time count routine (msec)
 	if(enable_keepalive_timer)
 	{
@@ -1538,6 +2368,7 @@ void seg_timer_msec(void)
 		
 		triggercode_idx = 0;
 		enable_modeswitch_timer = SEG_DISABLE;
+		due = SEG_ENABLE;
 	}
 	
 	// Serial data packing time delimiter timer
@@ -1552,6 +2383,7 @@ void seg_timer_msec(void)
 			serial_input_time = 0;
 			enable_serial_input_timer = 0;
 			flag_serial_input_time_elapse = 1;
+			due = SEG_ENABLE;
 		}
 	}
 	
@@ -1561,18 +2393,61 @@ void seg_timer_msec(void)
 		if(connection_auth_time < 0xffff) 	connection_auth_time++;
 		else								connection_auth_time = 0;
 	}
+	
+	if(!due) due = is_seg_timer_event();
+	
+	return due;
 }
 
 // This function have to call every 1 second by Timer IRQ handler routine.
-void seg_timer_sec(void)
+uint8_t seg_timer_sec(void)
 {
 	// Inactivity timer: Time count routine (sec)
 	if(enable_inactivity_timer)
 	{
 		if(inactivity_time < 0xFFFF) inactivity_time++;
 	}
+	
+	// Data transfer rates (bytes/sec, packets/sec)
+	update_transfer_rate();
 
 	tmp_timeflag_for_debug = 1;
+	
+	return enable_inactivity_timer;
+}
+
+// Timed jobs of the data path, checked every millisecond by the timer interrupt; the other jobs are started by the UART / socket interrupts.
+// The socket connection (Sn_IR_CON), send completion and timeout are polled: a socket in transition is serviced every millisecond.
+static uint8_t is_seg_timer_event(void)
+{
+	struct __network_info *net = (struct __network_info *)&(get_DevConfig_pointer()->network_info);
+	uint8_t sock_status;
+	
+	if(sw_modeswitch_at_mode_on) return SEG_ENABLE;
+	if(get_bench_state() != BENCH_IDLE) return SEG_ENABLE;
+	if(opmode != DEVICE_GW_MODE) return SEG_DISABLE;
+	
+	// Timers compared by the socket handlers
+	if(enable_reconnection_timer && (reconnection_time >= reconnect_delay)) return SEG_ENABLE;
+	if(enable_keepalive_timer && (keepalive_time >= (flag_sent_first_keepalive ? net->keepalive_retry_time : net->keepalive_wait_time))) return SEG_ENABLE;
+	if(enable_connection_auth_timer && (connection_auth_time >= MAX_CONNECTION_AUTH_TIME)) return SEG_ENABLE;
+	
+	// Data held: packing, send retry, flow control, store-and-forward replay
+	if(u2e_size || e2u_size || sf_replay_remain) return SEG_ENABLE;
+	if(!IS_BUFFER_EMPTY(data_rx) || !IS_BUFFER_EMPTY(data_spill)) return SEG_ENABLE;
+	
+	if(net->working_mode == MODBUS_GATEWAY_MODE)
+	{
+		if(is_modbus_busy()) return SEG_ENABLE;
+		sock_status = getSn_SR(SOCK_MODBUS);
+		if((sock_status != SOCK_LISTEN) && (sock_status != SOCK_ESTABLISHED)) return SEG_ENABLE;
+	}
+	
+	sock_status = getSn_SR(SEG_SOCK);
+	if((sock_status != SOCK_LISTEN) && (sock_status != SOCK_ESTABLISHED) && (sock_status != SOCK_UDP) && (sock_status != SOCK_MACRAW)) return SEG_ENABLE;
+	if((sock_status == SOCK_ESTABLISHED) && (getSn_IR(SEG_SOCK) & Sn_IR_CON)) return SEG_ENABLE; // Connected: the connection setup is polled
+	
+	return SEG_DISABLE;
 }
 
 
@@ -25,6 +25,33 @@
 #endif
 
 #define MAX_CONNECTION_AUTH_TIME		5000 // 5000ms (5sec)
+
+#define RECONNECTION_MIN_INTERVAL		100 // 100ms, used when the reconnection interval is zero
+#define RECONNECTION_BACKOFF_LIMIT		60000 // 60000ms (60sec), upper limit of reconnection backoff cap
+
+#define KEEPALIVE_AUTO_TIME_UNIT		5000 // Sn_KPALVTR time unit: 5000ms (5sec)
+
+// Store-and-forward (TCP modes): the UART ring buffer data over the threshold is moved to the spill buffer during the outage
+#define SEG_SPILL_THRESHOLD				(SEG_DATA_BUF_SIZE / 2)
+
+#ifndef SEG_UDP_DRAIN_BUDGET
+	#define SEG_UDP_DRAIN_BUDGET		16 // UDP_MODE: Max. datagrams drained from the socket in one pass
+#endif
+
+// Data transfer rates: the last 1 sec snapshot of the counters for the 1 sec window, 10 sec snapshots for the 10 sec / 60 sec windows
+#define TRANSFER_RATE_10SEC_SNAPS		6
+#define TRANSFER_RATE_WINDOWS			3 // [0] 1 sec, [1] 10 sec, [2] 60 sec ([1], [2]: updated every 10 sec)
+
+// Data path latency histograms: log2 buckets, [0] below 1 usec, [n] 2^(n-1) ~ 2^n - 1 usec, the last bucket: 2^22 usec (4.2 sec) and over
+#define LATENCY_HIST_BUCKETS			24
+
+// L2_TUNNEL_MODE: Serial data carried in raw Ethernet frames (MACRAW socket)
+// Frame: [DA 6][SA 6][EtherType 2][Sequence 2][Payload length 2][Payload]
+#define L2TUNNEL_ETHERTYPE				0x88B5 // IEEE Std 802 Local Experimental EtherType 1
+#define L2TUNNEL_HEADER_LEN				18
+#define L2TUNNEL_FRAME_MIN				60 // Minimum Ethernet frame size without FCS, short frames are zero-padded
+#define L2TUNNEL_FRAME_MAX				1514
+#define L2TUNNEL_PAYLOAD_MAX			(L2TUNNEL_FRAME_MAX - L2TUNNEL_HEADER_LEN)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #ifndef DATA_BUF_SIZE
@@ -36,38 +63,110 @@
 
 extern uint8_t opmode;
 extern uint8_t flag_s2e_application_running;
+extern uint16_t u2e_size; // Serial data in g_send_buf, not sent yet
+extern uint16_t e2u_size; // Network data in g_recv_buf, not written to the UART yet
 extern uint8_t flag_process_dhcp_success;
 extern uint8_t flag_process_dns_success;
 extern char * str_working[];
 
 
+// UART_RX: serial data received, UART_TX: serial data sent to the network, ETHER_RX: network data received, ETHER_TX: network data written to the UART
 typedef enum{SEG_UART_RX, SEG_UART_TX, SEG_ETHER_RX, SEG_ETHER_TX, SEG_ALL} teDATADIR;
 
+// Data path latency; U2E: first byte of the packet received by the UART -> packet sent to the socket (SEND command issued)
+//                    E2U: received data found in the socket (Sn_RX_RSR) -> last byte written to the UART
+typedef enum{LATENCY_U2E, LATENCY_E2U, LATENCY_PATH_MAX} teLATENCYPATH;
+
+// TCP client reconnection statistics
+struct __reconnect_stat {
+	uint32_t reconnect_cnt;		// Reconnected count after the connection lost
+	uint32_t attempt_cnt;		// Connection attempts count
+	uint32_t last_time;			// Time-to-reconnect (msec)
+	uint32_t max_time;			// Time-to-reconnect, worst case (msec)
+};
+
+// L2_TUNNEL_MODE frame statistics
+struct __l2tunnel_stat {
+	uint32_t tx_cnt;			// Sent frames
+	uint32_t rx_cnt;			// Received frames, delivered to the serial port
+	uint32_t lost_cnt;			// Frames lost, detected by the sequence number gap
+	uint32_t drop_cnt;			// Duplicated or out-of-order frames, dropped
+};
+
+// Store-and-forward statistics
+struct __store_forward_stat {
+	uint32_t buffered;			// Serial data bytes waiting for the connection (current)
+	uint32_t buffered_max;		// Buffered bytes, peak
+	uint32_t replay_cnt;		// Completed replays after connected
+	uint32_t replay_bytes;		// Replayed bytes, total
+	uint32_t replay_rate;		// Last replay throughput (bytes/sec)
+};
+
+// Data transfer statistics per direction
+struct __transfer_stat {
+	uint64_t bytes;
+	uint64_t packets;
+	uint32_t byte_rate[TRANSFER_RATE_WINDOWS];		// bytes/sec
+	uint32_t packet_rate[TRANSFER_RATE_WINDOWS];	// packets/sec
+};
+
+// Data path latency histogram (usec)
+struct __latency_hist {
+	uint32_t bucket[LATENCY_HIST_BUCKETS];	// Sample count per log2 bucket
+	uint32_t max;							// Worst case latency (usec)
+};
+
 // Serial to Ethernet function handler; call by main loop
 void do_seg(uint8_t sock);
 
 // Timer for S2E core operations
-void seg_timer_sec(void);
-void seg_timer_msec(void);
+// ret: [1] the data path has a job due (EVENT_SEG is posted by the timer)
+uint8_t seg_timer_sec(void);
+uint8_t seg_timer_msec(void);
 
 void init_trigger_modeswitch(uint8_t mode);
 
 void set_device_status(teDEVSTATUS status);
 uint8_t get_device_status(void);
 
+// Event trace of the data socket status (Sn_SR) changes; called by the S2E / Modbus socket handlers
+void trace_sock_state(uint8_t sock, uint8_t state);
+
 uint8_t process_socket_termination(uint8_t socket);
 
 // Send Keep-alive packet manually (once)
 void send_keepalive_packet_manual(uint8_t sock);
 
+// Keep-alive packet sent automatically by WZTOE (Sn_KPALVTR)
+uint8_t init_keepalive_auto(uint8_t sock);
+
 //These functions must be located in UART Rx IRQ Handler.
 uint8_t check_serial_store_permitted(uint8_t ch);
 uint8_t check_modeswitch_trigger(uint8_t ch);	// Serial command mode switch trigger code (3-bytes) checker
 void init_time_delimiter_timer(void); 			// Serial data packing option [Time]: Timer enalble function for Time delimiter
 
-// UART tx/rx and Ethernet tx/rx data transfer bytes counter
+// UART tx/rx and Ethernet tx/rx data transfer bytes / packets counter (64-bit)
+void add_data_transfer_bytecount(teDATADIR dir, uint16_t len);
 void clear_data_transfer_bytecount(teDATADIR dir);
-uint32_t get_data_transfer_bytecount(teDATADIR dir);
+uint64_t get_data_transfer_bytecount(teDATADIR dir);
+void get_transfer_stat(teDATADIR dir, struct __transfer_stat * stat);
+
+// TCP client reconnection statistics
+void get_reconnect_stat(struct __reconnect_stat * stat);
+void clear_reconnect_stat(void);
+
+// Store-and-forward statistics
+void get_store_forward_stat(struct __store_forward_stat * stat);
+void clear_store_forward_stat(void);
+void clear_store_forward_spill(void);
+
+// Data path latency histograms
+void get_latency_hist(teLATENCYPATH path, struct __latency_hist * hist);
+void clear_latency_hist(void);
+
+// L2_TUNNEL_MODE frame statistics
+void get_l2tunnel_stat(struct __l2tunnel_stat * stat);
+void clear_l2tunnel_stat(void);
 
 #endif /* SEG_H_ */
 
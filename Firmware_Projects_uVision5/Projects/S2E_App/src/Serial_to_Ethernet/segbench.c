@@ -0,0 +1,306 @@
+#include <string.h>
+#include "common.h"
+#include "W7500x_uart.h"
+#include "W7500x_wztoe.h"
+#include "socket.h"
+#include "ConfigData.h"
+#include "seg.h"
+#include "segbench.h"
+#include "timerHandler.h"
+#include "uartHandler.h"
+
+/* Private define ------------------------------------------------------------*/
+// Ring Buffer
+BUFFER_DECLARATION(data_rx);
+
+#define BENCH_PRBS_SEED				0x7FFF
+#define BENCH_SYNC_BYTES			2	// The checker state (15 bits) is loaded from the first bytes received
+#define BENCH_RTT_AVG_SHIFT			3	// Moving average weight: 1/8
+
+/* Private typedef -----------------------------------------------------------*/
+struct __bench_path {
+	uint16_t tx_prbs;
+	uint16_t rx_prbs;
+	uint8_t rx_sync;
+	uint8_t rtt_head;
+	uint8_t rtt_tail;
+	uint32_t rtt_pos[BENCH_RTT_SLOTS];	// Byte position, the lower 32 bits of tx_bytes
+	uint32_t rtt_tick[BENCH_RTT_SLOTS];
+	uint32_t rtt_cnt;
+	struct __bench_stat stat;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t bench_state = BENCH_IDLE;
+static uint8_t bench_paths = 0;
+static uint32_t bench_tick = 0;
+static uint64_t bench_elapsed_usec = 0;		// Running time; the settling time is not included
+static uint32_t bench_settle_usec = 0;
+static uint16_t bench_net_pending = 0;		// Network path: PRBS data in g_send_buf, not sent yet
+static struct __bench_path bench_path[BENCH_PATH_MAX];
+
+extern uint8_t g_send_buf[DATA_BUF_SIZE];
+extern uint8_t g_recv_buf[DATA_BUF_SIZE];
+
+/* Private functions prototypes ----------------------------------------------*/
+static void bench_uart_tx(void);
+static void bench_uart_rx(void);
+static void bench_net_tx(uint8_t sock);
+static void bench_net_rx(uint8_t sock);
+static void bench_check(struct __bench_path * p, const uint8_t * buf, uint16_t len);
+static void put_rtt_marks(struct __bench_path * p, uint16_t len);
+static void check_rtt_marks(struct __bench_path * p);
+static uint8_t prbs15_next(uint16_t * state);
+
+/* Public functions ----------------------------------------------------------*/
+void do_bench(uint8_t sock)
+{
+	uint32_t tick = get_timer_tick();
+	uint32_t usec = timer_tick_to_usec(tick - bench_tick);
+	uint8_t sr;
+
+	bench_tick = tick;
+	if(bench_state == BENCH_RUNNING)		bench_elapsed_usec += usec;
+	else if(bench_state == BENCH_SETTLING)	bench_settle_usec += usec;
+	else return;
+
+	if(bench_paths & BENCH_PATH_UART)
+	{
+		if(bench_state == BENCH_RUNNING) bench_uart_tx();
+		bench_uart_rx();
+	}
+
+	if(bench_paths & BENCH_PATH_NET)
+	{
+		sr = getSn_SR(sock);
+		if((sr == SOCK_ESTABLISHED) || (sr == SOCK_CLOSE_WAIT)) bench_net_rx(sock);
+
+		if(sr != SOCK_ESTABLISHED) stop_bench(); // Connection lost: the test ends, the S2E data path handles the socket
+		else if(bench_state == BENCH_RUNNING) bench_net_tx(sock);
+	}
+
+	if((bench_state == BENCH_SETTLING) && (bench_settle_usec >= (BENCH_SETTLE_MSEC * 1000UL)))
+	{
+		// Echoed data arriving later is handled by the S2E data path
+		bench_state = BENCH_IDLE;
+	}
+}
+
+// The pending S2E data (UART ring buffer, packing buffer, socket Rx buffer) is discarded
+uint8_t start_bench(uint8_t paths)
+{
+	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
+	uint16_t len;
+	uint8_t i;
+
+	if((paths == 0) || (paths & ~(BENCH_PATH_UART | BENCH_PATH_NET))) return 0;
+	if(bench_state != BENCH_IDLE) return 0;
+
+	// UART path: the data UART is used by the AT command mode
+	if((paths & BENCH_PATH_UART) && (opmode != DEVICE_GW_MODE)) return 0;
+
+	// Network path: TCP modes, connected
+	if(paths & BENCH_PATH_NET)
+	{
+		if((opmode != DEVICE_GW_MODE) || (net->state != ST_CONNECT)) return 0;
+		if(getSn_SR(SEG_SOCK) != SOCK_ESTABLISHED) return 0;
+
+		while((len = getSn_RX_RSR(SEG_SOCK)) != 0) recv(SEG_SOCK, g_recv_buf, (len > DATA_BUF_SIZE) ? DATA_BUF_SIZE : len);
+	}
+
+	uart_rx_flush(SEG_DATA_UART);
+	clear_store_forward_spill();
+	u2e_size = 0;
+	e2u_size = 0;
+
+	memset(bench_path, 0, sizeof(bench_path));
+	for(i = 0; i < BENCH_PATH_MAX; i++) bench_path[i].tx_prbs = BENCH_PRBS_SEED;
+
+	bench_paths = paths;
+	bench_elapsed_usec = 0;
+	bench_settle_usec = 0;
+	bench_net_pending = 0;
+	bench_tick = get_timer_tick();
+	bench_state = BENCH_RUNNING;
+
+	return 1;
+}
+
+void stop_bench(void)
+{
+	if(bench_state == BENCH_RUNNING) bench_state = BENCH_SETTLING;
+}
+
+uint8_t get_bench_state(void)
+{
+	return bench_state;
+}
+
+uint8_t get_bench_paths(void)
+{
+	return bench_paths;
+}
+
+uint32_t get_bench_elapsed_msec(void)
+{
+	return (uint32_t)(bench_elapsed_usec / 1000);
+}
+
+// path: [0] UART, [1] Network
+void get_bench_stat(uint8_t path, struct __bench_stat * stat)
+{
+	if(path >= BENCH_PATH_MAX) return;
+
+	memcpy(stat, &bench_path[path].stat, sizeof(struct __bench_stat));
+	stat->rate = (bench_elapsed_usec >= 1000) ? (uint32_t)((stat->rx_bytes * 1000) / (bench_elapsed_usec / 1000)) : 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+// The Tx FIFO is filled as long as it has room; the line rate is reached without waiting for the UART
+static void bench_uart_tx(void)
+{
+	struct __bench_path * p = &bench_path[0];
+	uint8_t i;
+
+	for(i = 0; i < BENCH_UART_BURST; i++)
+	{
+		if(UART_GetFlagStatus(UART_data, UART_FLAG_TXFF) == SET) break;
+
+		put_rtt_marks(p, 1);
+		UART_SendData(UART_data, prbs15_next(&p->tx_prbs));
+		p->stat.tx_bytes++;
+	}
+}
+
+static void bench_uart_rx(void)
+{
+	uint16_t len = 0;
+
+	while(!IS_BUFFER_EMPTY(data_rx) && (len < DATA_BUF_SIZE))
+	{
+		g_recv_buf[len++] = BUFFER_OUT(data_rx);
+		BUFFER_OUT_MOVE(data_rx, 1);
+	}
+
+	if(len) bench_check(&bench_path[0], g_recv_buf, len);
+}
+
+// A chunk refused by send() (the previous one in progress) is kept in g_send_buf and retried
+static void bench_net_tx(uint8_t sock)
+{
+	struct __bench_path * p = &bench_path[1];
+	int32_t ret;
+	uint16_t len;
+	uint16_t i;
+
+	if(bench_net_pending == 0)
+	{
+		len = getSn_TX_FSR(sock);
+		if(len > BENCH_NET_CHUNK) len = BENCH_NET_CHUNK;
+
+		for(i = 0; i < len; i++) g_send_buf[i] = prbs15_next(&p->tx_prbs);
+		bench_net_pending = len;
+	}
+
+	if(bench_net_pending == 0) return;
+
+	ret = send(sock, g_send_buf, bench_net_pending);
+	if(ret <= 0) return; // SOCK_BUSY; errors are found by the socket status
+
+	put_rtt_marks(p, bench_net_pending);
+	p->stat.tx_bytes += bench_net_pending;
+	bench_net_pending = 0;
+}
+
+static void bench_net_rx(uint8_t sock)
+{
+	uint16_t len = getSn_RX_RSR(sock);
+	int32_t ret;
+
+	if(len == 0) return;
+	if(len > DATA_BUF_SIZE) len = DATA_BUF_SIZE;
+
+	ret = recv(sock, g_recv_buf, len);
+	if(ret > 0) bench_check(&bench_path[1], g_recv_buf, (uint16_t)ret);
+}
+
+// Self-synchronizing checker: each byte is predicted from the last 15 bits received, so a lost byte does not break the check
+static void bench_check(struct __bench_path * p, const uint8_t * buf, uint16_t len)
+{
+	uint16_t state;
+	uint8_t diff;
+	uint16_t i;
+
+	for(i = 0; i < len; i++)
+	{
+		if(p->rx_sync < BENCH_SYNC_BYTES)
+		{
+			p->rx_sync++;
+		}
+		else
+		{
+			state = p->rx_prbs;
+			for(diff = prbs15_next(&state) ^ buf[i]; diff; diff &= (diff - 1)) p->stat.bit_errors++;
+		}
+		p->rx_prbs = ((p->rx_prbs << 8) | buf[i]) & 0x7FFF;
+	}
+
+	p->stat.rx_bytes += len;
+	check_rtt_marks(p);
+}
+
+// Marks the sampled byte positions in [tx_bytes, tx_bytes + len); the sample is skipped when all the slots are in flight
+static void put_rtt_marks(struct __bench_path * p, uint16_t len)
+{
+	uint32_t pos = (uint32_t)p->stat.tx_bytes;
+	uint32_t mark = (pos + BENCH_RTT_SAMPLE_BYTES - 1) & ~(uint32_t)(BENCH_RTT_SAMPLE_BYTES - 1);
+	uint8_t next;
+
+	for(; (mark - pos) < len; mark += BENCH_RTT_SAMPLE_BYTES)
+	{
+		next = (p->rtt_head + 1) % BENCH_RTT_SLOTS;
+		if(next == p->rtt_tail) break;
+
+		p->rtt_pos[p->rtt_head] = mark;
+		p->rtt_tick[p->rtt_head] = get_timer_tick();
+		p->rtt_head = next;
+	}
+}
+
+static void check_rtt_marks(struct __bench_path * p)
+{
+	struct __bench_stat * stat = &p->stat;
+	uint32_t rx = (uint32_t)stat->rx_bytes;
+	uint32_t rtt;
+
+	while((p->rtt_tail != p->rtt_head) && ((int32_t)(rx - p->rtt_pos[p->rtt_tail]) > 0))
+	{
+		rtt = timer_tick_to_usec(get_timer_tick() - p->rtt_tick[p->rtt_tail]);
+		p->rtt_tail = (p->rtt_tail + 1) % BENCH_RTT_SLOTS;
+
+		p->rtt_cnt++;
+		if((p->rtt_cnt == 1) || (rtt < stat->rtt_min)) stat->rtt_min = rtt;
+		if(rtt > stat->rtt_max) stat->rtt_max = rtt;
+		if(p->rtt_cnt == 1) stat->rtt_avg = rtt;
+		else stat->rtt_avg += ((int32_t)(rtt - stat->rtt_avg) >> BENCH_RTT_AVG_SHIFT);
+	}
+}
+
+// PRBS-15 (x^15 + x^14 + 1), 8 bits per call, MSB first; the state is the last 15 bits generated
+static uint8_t prbs15_next(uint16_t * state)
+{
+	uint16_t s = *state;
+	uint8_t out = 0;
+	uint8_t bit;
+	uint8_t i;
+
+	for(i = 0; i < 8; i++)
+	{
+		bit = ((s >> 14) ^ (s >> 13)) & 0x01;
+		s = ((s << 1) | bit) & 0x7FFF;
+		out = (out << 1) | bit;
+	}
+
+	*state = s;
+	return out;
+}
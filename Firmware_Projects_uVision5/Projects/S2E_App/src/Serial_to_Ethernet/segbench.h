@@ -0,0 +1,51 @@
+#ifndef SEGBENCH_H_
+#define SEGBENCH_H_
+
+#include <stdint.h>
+
+// Line-rate self-test: PRBS-15 (x^15 + x^14 + 1) generator and checker on the data UART and / or the TCP data socket
+// UART path: the data UART Tx is looped back to the Rx (loopback plug, RS-232 / TTL / RS-422)
+// Network path: the connected peer echoes the data back (e.g., TCP echo server)
+// While the test is running, the S2E data path is suspended; the data received from both paths is taken by the checker.
+
+#define BENCH_PATH_UART					0x01
+#define BENCH_PATH_NET					0x02
+#define BENCH_PATH_MAX					2		// Index: [0] UART, [1] Network
+
+#define BENCH_NET_CHUNK					1024	// Network path: max. bytes per send
+#define BENCH_UART_BURST				16		// UART path: max. bytes per call, the Tx FIFO is never waited
+#define BENCH_SETTLE_MSEC				500		// After the stop: the checker waits for the data in flight
+#define BENCH_RTT_SAMPLE_BYTES			1024	// Round-trip latency is sampled every N bytes sent
+#define BENCH_RTT_SLOTS					8		// Samples in flight
+
+// Test state
+#define BENCH_IDLE						0		// Not started or finished; the results of the last test are kept
+#define BENCH_RUNNING					1
+#define BENCH_SETTLING					2
+
+// Results per path
+// bit_errors: detections of the self-synchronizing checker; a single flipped bit is detected 3 times, a lost byte makes an error burst
+// rtt: byte sent -> the same byte position received (usec), sampled every BENCH_RTT_SAMPLE_BYTES
+struct __bench_stat {
+	uint64_t tx_bytes;
+	uint64_t rx_bytes;
+	uint32_t bit_errors;
+	uint32_t rate;					// Received bytes/sec over the test
+	uint32_t rtt_min;
+	uint32_t rtt_avg;
+	uint32_t rtt_max;
+};
+
+// Called by do_seg instead of the S2E data path while the test is running
+void do_bench(uint8_t sock);
+
+// paths: BENCH_PATH_UART | BENCH_PATH_NET; ret: [1] started / [0] the path is not available
+uint8_t start_bench(uint8_t paths);
+void stop_bench(void);
+
+uint8_t get_bench_state(void);
+uint8_t get_bench_paths(void);
+uint32_t get_bench_elapsed_msec(void);
+void get_bench_stat(uint8_t path, struct __bench_stat * stat);
+
+#endif /* SEGBENCH_H_ */
@@ -0,0 +1,283 @@
+#include <string.h>
+#include "common.h"
+#include "ConfigData.h"
+#include "segframe.h"
+#include "timerHandler.h"
+
+/* Private variables ---------------------------------------------------------*/
+// Streaming decoder state, kept across the calls
+static uint8_t dec_state = 0;
+static uint16_t dec_remain = 0;
+static uint8_t dec_code = 0;
+
+// FRAME_MODE_TIMESTAMP
+static uint16_t enc_seq = 0;
+static uint32_t enc_arrival = 0;
+static uint16_t enc_flags = 0; // Length field bits
+
+/* Private functions prototypes ----------------------------------------------*/
+static uint16_t encode_frame_slip(uint8_t * buf, const uint8_t * src, uint16_t len);
+static uint16_t encode_frame_cobs(uint8_t * buf, const uint8_t * src, uint16_t len);
+static uint16_t encode_frame_timestamp(uint8_t * buf, uint16_t len);
+static uint16_t decode_frame_length(uint8_t * buf, uint16_t len);
+static uint16_t decode_frame_slip(uint8_t * buf, uint16_t len);
+static uint16_t decode_frame_cobs(uint8_t * buf, uint16_t len);
+
+/* Public functions ----------------------------------------------------------*/
+uint16_t get_frame_data_max(uint8_t mode, uint16_t bufsize)
+{
+	switch(mode)
+	{
+		case FRAME_MODE_LENGTH:	return (bufsize - 2);
+		case FRAME_MODE_SLIP:	return ((bufsize - 2) / 2); // Worst case: all bytes escaped
+		case FRAME_MODE_COBS:	return (uint16_t)(((uint32_t)(bufsize - 2) * 254) / 255); // One code byte per 254 bytes
+		case FRAME_MODE_TIMESTAMP:	return (bufsize - TIMESTAMP_HEADER_LEN);
+		default:				return bufsize;
+	}
+}
+
+uint16_t encode_frame(uint8_t mode, uint8_t * buf, uint16_t len, uint16_t bufsize)
+{
+	uint16_t max = get_frame_data_max(mode, bufsize);
+
+	if(len > max) len = max;
+
+	switch(mode)
+	{
+		case FRAME_MODE_LENGTH:
+			memmove(&buf[2], buf, len);
+			buf[0] = (uint8_t)(len >> 8);
+			buf[1] = (uint8_t)(len & 0xff);
+			return (len + 2);
+
+		// The data is moved to the end of the buffer first and encoded forward from the beginning;
+		// with the 'get_frame_data_max' limit, the encoder output never overtakes the unread data.
+		case FRAME_MODE_SLIP:
+			memmove(&buf[bufsize - len], buf, len);
+			return encode_frame_slip(buf, &buf[bufsize - len], len);
+
+		case FRAME_MODE_COBS:
+			memmove(&buf[bufsize - len], buf, len);
+			return encode_frame_cobs(buf, &buf[bufsize - len], len);
+
+		case FRAME_MODE_TIMESTAMP:
+			return encode_frame_timestamp(buf, len);
+
+		default:
+			return len;
+	}
+}
+
+uint16_t decode_frame(uint8_t mode, uint8_t * buf, uint16_t len)
+{
+	switch(mode)
+	{
+		case FRAME_MODE_LENGTH:	return decode_frame_length(buf, len);
+		case FRAME_MODE_SLIP:	return decode_frame_slip(buf, len);
+		case FRAME_MODE_COBS:	return decode_frame_cobs(buf, len);
+		default:				return len; // FRAME_MODE_TIMESTAMP: Device -> Peer direction only
+	}
+}
+
+void set_frame_arrival_time(uint32_t usec, uint8_t estimated)
+{
+	enc_arrival = usec;
+	enc_flags = estimated ? TIMESTAMP_LEN_ESTIMATED : 0;
+}
+
+void init_frame_session(void)
+{
+	dec_state = 0;
+	dec_remain = 0;
+	dec_code = 0;
+	
+	enc_seq = 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static uint16_t encode_frame_slip(uint8_t * buf, const uint8_t * src, uint16_t len)
+{
+	uint16_t i;
+	uint16_t out = 0;
+	uint8_t ch;
+
+	buf[out++] = SLIP_END; // Flushes the line noise received before the frame at the peer
+	for(i = 0; i < len; i++)
+	{
+		ch = src[i];
+		if(ch == SLIP_END)
+		{
+			buf[out++] = SLIP_ESC;
+			buf[out++] = SLIP_ESC_END;
+		}
+		else if(ch == SLIP_ESC)
+		{
+			buf[out++] = SLIP_ESC;
+			buf[out++] = SLIP_ESC_ESC;
+		}
+		else
+		{
+			buf[out++] = ch;
+		}
+	}
+	buf[out++] = SLIP_END;
+
+	return out;
+}
+
+static uint16_t encode_frame_cobs(uint8_t * buf, const uint8_t * src, uint16_t len)
+{
+	uint16_t i;
+	uint16_t out = 1;
+	uint16_t code_idx = 0;
+	uint8_t code = 1;
+	uint8_t ch;
+
+	for(i = 0; i < len; i++)
+	{
+		ch = src[i];
+		if(ch == 0x00)
+		{
+			buf[code_idx] = code;
+			code_idx = out++;
+			code = 1;
+		}
+		else
+		{
+			buf[out++] = ch;
+			if(++code == COBS_BLOCK_MAX)
+			{
+				buf[code_idx] = code;
+				code_idx = out++;
+				code = 1;
+			}
+		}
+	}
+	buf[code_idx] = code;
+	buf[out++] = COBS_DELIMITER;
+
+	return out;
+}
+
+static uint16_t encode_frame_timestamp(uint8_t * buf, uint16_t len)
+{
+	uint32_t sent = get_timer_usec(get_timer_tick());
+
+	memmove(&buf[TIMESTAMP_HEADER_LEN], buf, len);
+	buf[0] = (uint8_t)(enc_seq >> 8);
+	buf[1] = (uint8_t)(enc_seq & 0xff);
+	buf[2] = (uint8_t)((len | enc_flags) >> 8);
+	buf[3] = (uint8_t)(len & 0xff);
+	buf[4] = (uint8_t)(enc_arrival >> 24);
+	buf[5] = (uint8_t)(enc_arrival >> 16);
+	buf[6] = (uint8_t)(enc_arrival >> 8);
+	buf[7] = (uint8_t)(enc_arrival & 0xff);
+	buf[8] = (uint8_t)(sent >> 24);
+	buf[9] = (uint8_t)(sent >> 16);
+	buf[10] = (uint8_t)(sent >> 8);
+	buf[11] = (uint8_t)(sent & 0xff);
+	enc_seq++;
+
+	return (len + TIMESTAMP_HEADER_LEN);
+}
+
+// dec_state: [0] Length MSB / [1] Length LSB / [2] Data, dec_remain bytes left
+static uint16_t decode_frame_length(uint8_t * buf, uint16_t len)
+{
+	uint16_t i = 0;
+	uint16_t out = 0;
+	uint16_t size;
+
+	while(i < len)
+	{
+		switch(dec_state)
+		{
+			case 0:
+				dec_remain = (uint16_t)buf[i++] << 8;
+				dec_state = 1;
+				break;
+
+			case 1:
+				dec_remain |= buf[i++];
+				dec_state = (dec_remain != 0) ? 2 : 0;
+				break;
+
+			default:
+				size = len - i;
+				if(size > dec_remain) size = dec_remain;
+
+				memmove(&buf[out], &buf[i], size);
+				out += size;
+				i += size;
+
+				dec_remain -= size;
+				if(dec_remain == 0) dec_state = 0;
+				break;
+		}
+	}
+
+	return out;
+}
+
+// dec_state: [0] Normal / [1] Escaped
+static uint16_t decode_frame_slip(uint8_t * buf, uint16_t len)
+{
+	uint16_t i;
+	uint16_t out = 0;
+	uint8_t ch;
+
+	for(i = 0; i < len; i++)
+	{
+		ch = buf[i];
+		if(dec_state == 1)
+		{
+			if(ch == SLIP_ESC_END)		ch = SLIP_END;
+			else if(ch == SLIP_ESC_ESC)	ch = SLIP_ESC;
+			buf[out++] = ch; // Protocol violation: the byte is kept as is (RFC 1055)
+			dec_state = 0;
+		}
+		else if(ch == SLIP_ESC)
+		{
+			dec_state = 1;
+		}
+		else if(ch != SLIP_END)
+		{
+			buf[out++] = ch;
+		}
+	}
+
+	return out;
+}
+
+// dec_state: [0] Frame start / [1] In frame, dec_code: code byte of the current block
+// A block shorter than COBS_BLOCK_MAX implies a zero byte, unless it is the last block of the frame.
+static uint16_t decode_frame_cobs(uint8_t * buf, uint16_t len)
+{
+	uint16_t i;
+	uint16_t out = 0;
+	uint8_t ch;
+
+	for(i = 0; i < len; i++)
+	{
+		ch = buf[i];
+		if(ch == COBS_DELIMITER) // End of frame, also re-synchronizes a broken frame
+		{
+			dec_state = 0;
+			dec_remain = 0;
+		}
+		else if(dec_remain == 0) // Code byte
+		{
+			if((dec_state == 1) && (dec_code < COBS_BLOCK_MAX)) buf[out++] = 0x00;
+			dec_code = ch;
+			dec_remain = ch - 1;
+			dec_state = 1;
+		}
+		else
+		{
+			buf[out++] = ch;
+			dec_remain--;
+		}
+	}
+
+	return out;
+}
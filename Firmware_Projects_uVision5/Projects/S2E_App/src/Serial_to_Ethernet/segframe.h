@@ -0,0 +1,40 @@
+#ifndef SEGFRAME_H_
+#define SEGFRAME_H_
+
+#include <stdint.h>
+
+// Frame-preserving encapsulation of the serial data on the TCP data socket
+// mode: FRAME_MODE_NONE / FRAME_MODE_LENGTH / FRAME_MODE_SLIP / FRAME_MODE_COBS / FRAME_MODE_TIMESTAMP (ConfigData.h)
+
+#define SLIP_END			0xC0
+#define SLIP_ESC			0xDB
+#define SLIP_ESC_END		0xDC
+#define SLIP_ESC_ESC		0xDD
+
+#define COBS_DELIMITER		0x00
+#define COBS_BLOCK_MAX		0xFF
+
+// FRAME_MODE_TIMESTAMP header, big-endian: [Sequence 2][Length 2][Arrival 4][Sent 4]
+// Arrival: first byte received by the UART, Sent: packet encoded for sending (usec timestamps, same free-running clock)
+// Device queueing delay = Sent - Arrival; Arrival 0: unknown (store-and-forward replay)
+// Length bit 15: Arrival estimated from the previous byte timestamp (the packet does not start a serial burst)
+#define TIMESTAMP_HEADER_LEN	12
+#define TIMESTAMP_LEN_ESTIMATED	0x8000
+
+// Max. serial data length can be encoded in place in the buffer of 'bufsize' bytes
+uint16_t get_frame_data_max(uint8_t mode, uint16_t bufsize);
+
+// Serial data -> Encoded frame, in place; ret: encoded frame length
+uint16_t encode_frame(uint8_t mode, uint8_t * buf, uint16_t len, uint16_t bufsize);
+
+// Encoded stream -> Serial data, in place. Frames can be split across the calls (TCP byte stream)
+// ret: decoded data length
+uint16_t decode_frame(uint8_t mode, uint8_t * buf, uint16_t len);
+
+// FRAME_MODE_TIMESTAMP: arrival time of the first byte of the next packet (usec timestamp); estimated: [0] ISR timestamp / [1] estimated
+void set_frame_arrival_time(uint32_t usec, uint8_t estimated);
+
+// Encoder sequence / decoder state reset; call when a new connection is established
+void init_frame_session(void);
+
+#endif /* SEGFRAME_H_ */
@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <string.h>
+#include "common.h"
+#include "W7500x_wztoe.h"
+#include "socket.h"
+#include "ConfigData.h"
+#include "seg.h"
+#include "segmodbus.h"
+#include "timerHandler.h"
+#include "uartHandler.h"
+#include "eventHandler.h"
+
+/* Private define ------------------------------------------------------------*/
+// Ring Buffer
+BUFFER_DECLARATION(data_rx);
+
+#define MODBUS_BUS_IDLE					0
+#define MODBUS_BUS_WAIT_RESPONSE		1
+
+#define MODBUS_MASTER_NONE				0xFF
+#define MODBUS_TURNAROUND_AVG_SHIFT		3 // Moving average weight: 1/8
+
+/* Private variables ---------------------------------------------------------*/
+// CRC-16/MODBUS (polynomial 0xA001, reflected) lookup table
+static const uint16_t crc16_table[256] = {
+	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+	0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+	0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+	0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+	0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+	0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+	0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+	0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+	0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+	0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+	0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+	0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+	0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+	0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+	0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+	0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+	0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+	0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+	0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+	0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+	0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+	0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+	0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+	0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+	0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+	0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+	0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+	0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+	0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+	0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+	0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+static const uint8_t modbus_sock[MODBUS_MASTER_MAX] = {SOCK_DATA, SOCK_MODBUS};
+
+// Request queue: the order of the requests from all masters; the request data is read from the socket when it goes onto the bus
+struct __modbus_request {
+	uint8_t master;
+	uint32_t recv_tick;
+};
+
+static struct __modbus_request modbus_queue[MODBUS_QUEUE_SIZE];
+static uint8_t modbus_queue_rd = 0;
+static uint8_t modbus_queue_cnt = 0;
+static uint16_t modbus_queued_len[MODBUS_MASTER_MAX]; // Queued request bytes in the socket Rx buffer of each master
+static uint8_t modbus_connected = 0;
+
+// RTU bus: one outstanding request
+static uint8_t bus_state = MODBUS_BUS_IDLE;
+static uint8_t bus_master = MODBUS_MASTER_NONE;
+static uint8_t bus_mbap[MODBUS_MBAP_LEN];
+static uint8_t bus_function;
+static uint32_t bus_recv_tick;
+static uint32_t bus_tx_tick;
+static uint32_t bus_idle_tick;
+
+static struct __modbus_stat modbus_stat;
+
+// User's buffer
+extern uint8_t g_send_buf[DATA_BUF_SIZE];
+extern uint8_t g_recv_buf[DATA_BUF_SIZE];
+
+/* Private functions prototypes ----------------------------------------------*/
+static void proc_modbus_master(uint8_t master);
+static void proc_modbus_bus(void);
+static void enqueue_modbus_request(uint8_t master);
+static void remove_modbus_request(uint8_t master);
+static void send_modbus_response(uint8_t * buf, uint16_t len);
+static void send_modbus_exception(uint8_t code);
+static uint32_t get_modbus_t35(void);
+static uint32_t get_elapsed_usec(uint32_t tick);
+
+/* Public functions ----------------------------------------------------------*/
+void proc_SEG_modbus(void)
+{
+	uint8_t i;
+	uint8_t connected = 0;
+	
+	for(i = 0; i < MODBUS_MASTER_MAX; i++)
+	{
+		proc_modbus_master(i);
+		if(getSn_SR(modbus_sock[i]) == SOCK_ESTABLISHED) connected++;
+	}
+	
+	proc_modbus_bus();
+	
+	// Serial data is stored in the ring buffer only while a master is connected
+	if((connected != 0) != (modbus_connected != 0)) set_device_status(connected ? ST_CONNECT : ST_OPEN);
+	modbus_connected = connected;
+}
+
+uint8_t is_modbus_busy(void)
+{
+	return ((bus_state != MODBUS_BUS_IDLE) || (modbus_queue_cnt != 0));
+}
+
+uint16_t crc16_modbus(const uint8_t * buf, uint16_t len)
+{
+	uint16_t crc = 0xFFFF;
+	
+	while(len--)
+	{
+		crc = (crc >> 8) ^ crc16_table[(crc ^ *buf++) & 0xFF];
+	}
+	
+	return crc;
+}
+
+void get_modbus_stat(struct __modbus_stat * stat)
+{
+	memcpy(stat, &modbus_stat, sizeof(struct __modbus_stat));
+}
+
+void clear_modbus_stat(void)
+{
+	memset(&modbus_stat, 0, sizeof(struct __modbus_stat));
+}
+
+/* Private functions ---------------------------------------------------------*/
+// Modbus TCP server socket of each master, listens on the data port (local_port)
+static void proc_modbus_master(uint8_t master)
+{
+	struct __network_info *net = (struct __network_info *)get_DevConfig_pointer()->network_info;
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	uint8_t sock = modbus_sock[master];
+	uint8_t state = getSn_SR(sock);
+	
+	trace_sock_state(sock, state);
+	switch(state)
+	{
+		case SOCK_ESTABLISHED:
+			if(getSn_IR(sock) & Sn_IR_CON)
+			{
+				setSn_IR(sock, Sn_IR_CON);
+				modbus_queued_len[master] = 0;
+				init_keepalive_auto(sock);
+				
+				if(serial->serial_debug_en == SEG_ENABLE)
+				{
+					getsockopt(sock, SO_DESTIP, g_recv_buf);
+					printf(" > SEG:MODBUS_GATEWAY_MODE:MASTER%d %d.%d.%d.%d\r\n", master, g_recv_buf[0], g_recv_buf[1], g_recv_buf[2], g_recv_buf[3]);
+				}
+			}
+			enqueue_modbus_request(master);
+			break;
+		
+		case SOCK_CLOSE_WAIT:
+			disconnect(sock);
+			break;
+		
+		case SOCK_CLOSED:
+			remove_modbus_request(master);
+			
+			if(socket(sock, Sn_MR_TCP, net->local_port, Sn_MR_ND) == sock)
+			{
+				listen(sock);
+				
+				if(serial->serial_debug_en == SEG_ENABLE)
+				{
+					printf(" > SEG:MODBUS_GATEWAY_MODE:MASTER%d:SOCKOPEN\r\n", master);
+				}
+			}
+			break;
+		
+		default:
+			break;
+	}
+}
+
+// Queues the complete requests in the socket Rx buffer; MBAP headers are parsed in place (wiz_recv_peek)
+static void enqueue_modbus_request(uint8_t master)
+{
+	uint8_t sock = modbus_sock[master];
+	uint8_t mbap[MODBUS_MBAP_LEN];
+	uint16_t rsr;
+	uint16_t len;
+	
+	rsr = getSn_RX_RSR(sock);
+	
+	while(modbus_queue_cnt < MODBUS_QUEUE_SIZE)
+	{
+		if(rsr < (modbus_queued_len[master] + MODBUS_MBAP_LEN)) break;
+		
+		wiz_recv_peek(sock, modbus_queued_len[master], mbap, MODBUS_MBAP_LEN);
+		len = ((uint16_t)mbap[4] << 8) | mbap[5]; // Unit ID + PDU
+		
+		if((mbap[2] != 0) || (mbap[3] != 0) || (len < 2) || (len > (MODBUS_PDU_MAX + 1))) // Not a Modbus TCP stream
+		{
+			modbus_stat.error_cnt++;
+			disconnect(sock);
+			return;
+		}
+		
+		if(rsr < (modbus_queued_len[master] + (MODBUS_MBAP_LEN - 1) + len)) break; // Incomplete request
+		
+		modbus_queue[(modbus_queue_rd + modbus_queue_cnt) % MODBUS_QUEUE_SIZE].master = master;
+		modbus_queue[(modbus_queue_rd + modbus_queue_cnt) % MODBUS_QUEUE_SIZE].recv_tick = get_timer_tick();
+		modbus_queue_cnt++;
+		
+		modbus_queued_len[master] += (MODBUS_MBAP_LEN - 1) + len;
+		modbus_stat.req_cnt++;
+	}
+}
+
+// Closed master: the queued requests are removed, the response of the request on the bus is discarded
+static void remove_modbus_request(uint8_t master)
+{
+	uint8_t i;
+	uint8_t cnt = 0;
+	struct __modbus_request req;
+	
+	for(i = 0; i < modbus_queue_cnt; i++)
+	{
+		req = modbus_queue[(modbus_queue_rd + i) % MODBUS_QUEUE_SIZE];
+		if(req.master != master)
+		{
+			modbus_queue[(modbus_queue_rd + cnt) % MODBUS_QUEUE_SIZE] = req;
+			cnt++;
+		}
+	}
+	modbus_queue_cnt = cnt;
+	modbus_queued_len[master] = 0;
+	
+	if(bus_master == master) bus_master = MODBUS_MASTER_NONE;
+}
+
+// RTU bus: the next request goes out as soon as the response (or timeout) of the previous one and the inter-frame silence
+static void proc_modbus_bus(void)
+{
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	struct __modbus_request req;
+	uint16_t len;
+	uint16_t crc;
+	uint16_t i;
+	
+	switch(bus_state)
+	{
+		case MODBUS_BUS_IDLE:
+			if(modbus_queue_cnt == 0) break;
+			if(get_elapsed_usec(bus_idle_tick) < get_modbus_t35()) break;
+			
+			req = modbus_queue[modbus_queue_rd];
+			modbus_queue_rd = (modbus_queue_rd + 1) % MODBUS_QUEUE_SIZE;
+			modbus_queue_cnt--;
+			
+			// Modbus TCP request: [MBAP 6][Unit ID][PDU] -> Modbus RTU request: [Unit ID][PDU][CRC]
+			recv(modbus_sock[req.master], bus_mbap, MODBUS_MBAP_LEN - 1);
+			len = ((uint16_t)bus_mbap[4] << 8) | bus_mbap[5];
+			recv(modbus_sock[req.master], g_send_buf, len);
+			modbus_queued_len[req.master] -= (MODBUS_MBAP_LEN - 1) + len;
+			bus_mbap[MODBUS_MBAP_LEN - 1] = g_send_buf[0];
+			bus_function = g_send_buf[1];
+			
+			add_data_transfer_bytecount(SEG_ETHER_RX, (MODBUS_MBAP_LEN - 1) + len);
+			
+			crc = crc16_modbus(g_send_buf, len);
+			g_send_buf[len++] = (uint8_t)(crc & 0xFF);
+			g_send_buf[len++] = (uint8_t)(crc >> 8);
+			
+			BUFFER_CLEAR(data_rx); // Discards the unsolicited serial data
+			
+			if(serial->uart_interface == UART_IF_RS422_485) uart_rs485_enable(SEG_DATA_UART);
+			for(i = 0; i < len; i++) uart_putc(SEG_DATA_UART, g_send_buf[i]);
+			if(serial->uart_interface == UART_IF_RS422_485) uart_rs485_disable(SEG_DATA_UART);
+			
+			add_data_transfer_bytecount(SEG_ETHER_TX, len);
+			
+			bus_master = req.master;
+			bus_recv_tick = req.recv_tick;
+			bus_tx_tick = get_timer_tick();
+			bus_idle_tick = bus_tx_tick;
+			
+			if(g_send_buf[0] != 0) bus_state = MODBUS_BUS_WAIT_RESPONSE; // Unit ID 0: Broadcast, no response
+			break;
+		
+		case MODBUS_BUS_WAIT_RESPONSE:
+			if(BUFFER_USED_SIZE(data_rx) == 0)
+			{
+				if(get_elapsed_usec(bus_tx_tick) >= ((uint32_t)MODBUS_RESPONSE_TIMEOUT * 1000))
+				{
+					modbus_stat.timeout_cnt++;
+					send_modbus_exception(MODBUS_EXCEPTION_GW_TARGET);
+					bus_idle_tick = get_timer_tick();
+					bus_state = MODBUS_BUS_IDLE;
+				}
+				break;
+			}
+			
+			// End of the response frame: 3.5 characters of silence
+			if(get_elapsed_usec(get_uart_rx_tick()) < get_modbus_t35()) break;
+			
+			// The response is placed after the room for the MBAP header
+			len = BUFFER_USED_SIZE(data_rx);
+			if(len > MODBUS_RTU_MAX) len = MODBUS_RTU_MAX;
+			for(i = 0; i < len; i++) g_recv_buf[(MODBUS_MBAP_LEN - 1) + i] = (uint8_t)uart_getc(SEG_DATA_UART);
+			BUFFER_CLEAR(data_rx);
+			
+			add_data_transfer_bytecount(SEG_UART_RX, len);
+			
+			bus_idle_tick = get_uart_rx_tick();
+			bus_state = MODBUS_BUS_IDLE;
+			
+			// CRC over the whole frame including the CRC field is zero
+			if((len < 4) || (crc16_modbus(&g_recv_buf[MODBUS_MBAP_LEN - 1], len) != 0) || (g_recv_buf[MODBUS_MBAP_LEN - 1] != bus_mbap[MODBUS_MBAP_LEN - 1]))
+			{
+				modbus_stat.error_cnt++;
+				send_modbus_exception(MODBUS_EXCEPTION_GW_TARGET);
+				break;
+			}
+			
+			send_modbus_response(g_recv_buf, len - 2);
+			break;
+		
+		default:
+			bus_state = MODBUS_BUS_IDLE;
+			break;
+	}
+}
+
+// buf: [Room for MBAP 6][Unit ID][PDU], len: Unit ID + PDU
+static void send_modbus_response(uint8_t * buf, uint16_t len)
+{
+	uint8_t sock;
+	uint32_t turnaround;
+	
+	if(bus_master == MODBUS_MASTER_NONE) return;
+	
+	sock = modbus_sock[bus_master];
+	bus_master = MODBUS_MASTER_NONE;
+	
+	if(getSn_SR(sock) != SOCK_ESTABLISHED) return;
+	
+	// Transaction ID / Protocol ID of the request are mapped back
+	memcpy(buf, bus_mbap, 4);
+	buf[4] = (uint8_t)(len >> 8);
+	buf[5] = (uint8_t)(len & 0xFF);
+	
+	CALL_PROBE_ENTER(PROFILE_SOCK_SEND);
+	send(sock, buf, (MODBUS_MBAP_LEN - 1) + len);
+	CALL_PROBE_EXIT(PROFILE_SOCK_SEND);
+	
+	turnaround = get_elapsed_usec(bus_recv_tick);
+	
+	modbus_stat.resp_cnt++;
+	modbus_stat.turnaround_last = turnaround;
+	if(turnaround > modbus_stat.turnaround_max) modbus_stat.turnaround_max = turnaround;
+	if(modbus_stat.resp_cnt == 1) modbus_stat.turnaround_avg = turnaround;
+	else modbus_stat.turnaround_avg += ((int32_t)(turnaround - modbus_stat.turnaround_avg) >> MODBUS_TURNAROUND_AVG_SHIFT);
+	
+	add_data_transfer_bytecount(SEG_UART_TX, (MODBUS_MBAP_LEN - 1) + len);
+}
+
+static void send_modbus_exception(uint8_t code)
+{
+	uint8_t buf[MODBUS_MBAP_LEN + 2];
+	
+	buf[MODBUS_MBAP_LEN - 1] = bus_mbap[MODBUS_MBAP_LEN - 1];	// Unit ID
+	buf[MODBUS_MBAP_LEN] = bus_function | 0x80;					// Function code of the request
+	buf[MODBUS_MBAP_LEN + 1] = code;
+	
+	send_modbus_response(buf, 3);
+}
+
+// Inter-frame silence: 3.5 characters, fixed 1.75ms over 19200bps (Modbus over serial line V1.02)
+static uint32_t get_modbus_t35(void)
+{
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	uint32_t t35 = (get_uart_char_time(serial) * 35) / 10;
+	
+	return (t35 < MODBUS_T35_MIN) ? MODBUS_T35_MIN : t35;
+}
+
+static uint32_t get_elapsed_usec(uint32_t tick)
+{
+	return timer_tick_to_usec(get_timer_tick() - tick);
+}
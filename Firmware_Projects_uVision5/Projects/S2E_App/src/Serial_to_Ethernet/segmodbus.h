@@ -0,0 +1,41 @@
+#ifndef SEGMODBUS_H_
+#define SEGMODBUS_H_
+
+#include <stdint.h>
+
+// MODBUS_GATEWAY_MODE: Modbus TCP (MBAP) masters <-> Modbus RTU slaves on the data UART
+
+#define MODBUS_MASTER_MAX				2		// Concurrent Modbus TCP masters: SOCK_DATA, SOCK_MODBUS
+#define MODBUS_QUEUE_SIZE				8		// Pending requests of all masters, the request data is kept in the socket Rx buffer
+
+#define MODBUS_MBAP_LEN					7		// [Transaction ID 2][Protocol ID 2][Length 2][Unit ID 1]
+#define MODBUS_PDU_MAX					253
+#define MODBUS_RTU_MAX					256		// [Unit ID 1][PDU][CRC 2]
+
+#define MODBUS_RESPONSE_TIMEOUT			1000	// ms, RTU slave response timeout
+#define MODBUS_T35_MIN					1750	// usec, fixed inter-frame silence for the baud rates over 19200bps
+
+#define MODBUS_EXCEPTION_GW_TARGET		0x0B	// Gateway target device failed to respond
+
+// Gateway statistics; turnaround: request received from the TCP master -> response sent (usec)
+struct __modbus_stat {
+	uint32_t req_cnt;
+	uint32_t resp_cnt;
+	uint32_t timeout_cnt;
+	uint32_t error_cnt;				// RTU response CRC / Unit ID mismatch, MBAP header error
+	uint32_t turnaround_last;
+	uint32_t turnaround_avg;
+	uint32_t turnaround_max;
+};
+
+void proc_SEG_modbus(void);
+
+// ret: [1] a request is queued or on the bus (the timeouts are checked by proc_SEG_modbus)
+uint8_t is_modbus_busy(void);
+
+uint16_t crc16_modbus(const uint8_t * buf, uint16_t len);
+
+void get_modbus_stat(struct __modbus_stat * stat);
+void clear_modbus_stat(void);
+
+#endif /* SEGMODBUS_H_ */
@@ -0,0 +1,173 @@
+#include <string.h>
+#include "common.h"
+#include "W7500x_wztoe.h"
+#include "socket.h"
+#include "ConfigData.h"
+#include "seg.h"
+#include "segtelemetry.h"
+#include "deviceHandler.h"
+#include "eventHandler.h"
+#include "gpioHandler.h"
+#include "timerHandler.h"
+#include "uartHandler.h"
+
+/* Private variables ---------------------------------------------------------*/
+static const uint16_t telemetry_interval_table[TELEMETRY_INTERVAL_NUM] = TELEMETRY_INTERVAL_TABLE;
+
+static uint8_t telemetry_buf[TELEMETRY_DATAGRAM_LEN];
+static uint32_t telemetry_seq = 0;
+static uint32_t telemetry_last_sec = 0;
+static uint8_t flag_telemetry_sending = SEG_DISABLE;
+
+/* Private functions prototypes ----------------------------------------------*/
+static uint16_t make_telemetry_datagram(uint8_t * buf);
+static uint8_t * put_be16(uint8_t * p, uint16_t val);
+static uint8_t * put_be32(uint8_t * p, uint32_t val);
+static uint8_t * put_be64(uint8_t * p, uint64_t val);
+static uint32_t get_uptime_sec(void);
+
+/* Public functions ----------------------------------------------------------*/
+void do_telemetry(void)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	uint8_t * ip = dev_config->network_option.telemetry_ip;
+	uint32_t now = get_uptime_sec();
+	uint16_t len;
+	uint8_t ir;
+
+	if((ip[0] | ip[1] | ip[2] | ip[3]) == 0) // Disabled
+	{
+		if(getSn_SR(SOCK_TELEMETRY) != SOCK_CLOSED) close(SOCK_TELEMETRY);
+		flag_telemetry_sending = SEG_DISABLE;
+		return;
+	}
+
+	if(getSn_SR(SOCK_TELEMETRY) != SOCK_UDP)
+	{
+		flag_telemetry_sending = SEG_DISABLE;
+		if(socket(SOCK_TELEMETRY, Sn_MR_UDP, DEVICE_TELEMETRY_PORT, 0) != SOCK_TELEMETRY) return;
+	}
+
+	// Result of the previous datagram; a lost datagram is not retried
+	if(flag_telemetry_sending)
+	{
+		ir = getSn_IR(SOCK_TELEMETRY);
+		if(ir & (Sn_IR_SENDOK | Sn_IR_TIMEOUT))
+		{
+			setSn_ICR(SOCK_TELEMETRY, ir & (Sn_IR_SENDOK | Sn_IR_TIMEOUT));
+			flag_telemetry_sending = SEG_DISABLE;
+		}
+	}
+
+	if((int32_t)(now - telemetry_last_sec) < (int32_t)get_telemetry_interval()) return;
+	telemetry_last_sec = now;
+
+	// Still in progress (e.g., ARP retransmissions to an absent collector): this period is skipped
+	if(flag_telemetry_sending) return;
+
+	len = make_telemetry_datagram(telemetry_buf);
+
+	setSn_DIPR(SOCK_TELEMETRY, ip);
+	setSn_DPORT(SOCK_TELEMETRY, DEVICE_TELEMETRY_PORT);
+	wiz_send_data(SOCK_TELEMETRY, telemetry_buf, len);
+	setSn_CR(SOCK_TELEMETRY, Sn_CR_SEND);
+	while(getSn_CR(SOCK_TELEMETRY));
+
+	flag_telemetry_sending = SEG_ENABLE;
+	telemetry_seq++;
+}
+
+uint16_t get_telemetry_interval(void)
+{
+	uint8_t code = (get_DevConfig_pointer()->network_option.option_flags & NET_OPTION_TELEMETRY_INTERVAL) >> NET_OPTION_TELEMETRY_SHIFT;
+
+	return telemetry_interval_table[code];
+}
+
+uint8_t set_telemetry_interval(uint16_t sec)
+{
+	struct __network_option *option = &get_DevConfig_pointer()->network_option;
+	uint8_t i;
+
+	for(i = 0; i < TELEMETRY_INTERVAL_NUM; i++)
+	{
+		if(telemetry_interval_table[i] == sec)
+		{
+			option->option_flags = (option->option_flags & ~NET_OPTION_TELEMETRY_INTERVAL) | (i << NET_OPTION_TELEMETRY_SHIFT);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+static uint16_t make_telemetry_datagram(uint8_t * buf)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	struct __transfer_stat transfer[SEG_ALL];
+	struct __reconnect_stat reconnect;
+	struct __store_forward_stat store_forward;
+	struct __event_stat event;
+	uint32_t latency_max = 0;
+	uint8_t * p = buf;
+	uint8_t i;
+
+	for(i = 0; i < SEG_ALL; i++) get_transfer_stat((teDATADIR)i, &transfer[i]);
+	get_reconnect_stat(&reconnect);
+	get_store_forward_stat(&store_forward);
+	for(i = 0; i < EVENT_MAX; i++)
+	{
+		get_event_stat((teEVENT)i, &event);
+		if(event.latency_max > latency_max) latency_max = event.latency_max;
+	}
+
+	*p++ = TELEMETRY_MAGIC_0;
+	*p++ = TELEMETRY_MAGIC_1;
+	*p++ = TELEMETRY_VERSION;
+	*p++ = get_device_status();
+	memcpy(p, dev_config->network_info_common.mac, 6);
+	p += 6;
+	p = put_be32(p, telemetry_seq);
+	p = put_be32(p, get_uptime_sec());
+
+	for(i = 0; i < SEG_ALL; i++) p = put_be64(p, transfer[i].bytes);
+	for(i = 0; i < SEG_ALL; i++) p = put_be64(p, transfer[i].packets);
+
+	p = put_be16(p, get_uart_rx_high_water());
+	p = put_be32(p, store_forward.buffered_max);
+	p = put_be32(p, reconnect.reconnect_cnt);
+	p = put_be32(p, reconnect.attempt_cnt);
+	p = put_be32(p, latency_max);
+	p = put_be32(p, get_phylink_down_count());
+
+	return (uint16_t)(p - buf);
+}
+
+static uint8_t * put_be16(uint8_t * p, uint16_t val)
+{
+	*p++ = (uint8_t)(val >> 8);
+	*p++ = (uint8_t)val;
+	return p;
+}
+
+static uint8_t * put_be32(uint8_t * p, uint32_t val)
+{
+	p = put_be16(p, (uint16_t)(val >> 16));
+	return put_be16(p, (uint16_t)val);
+}
+
+static uint8_t * put_be64(uint8_t * p, uint64_t val)
+{
+	p = put_be32(p, (uint32_t)(val >> 32));
+	return put_be32(p, (uint32_t)val);
+}
+
+// The uptime counters are updated by the timer interrupt; a rollover between the reads gives an earlier time only
+static uint32_t get_uptime_sec(void)
+{
+	uint32_t hour = getDeviceUptime_hour();
+	uint8_t min = getDeviceUptime_min();
+	uint8_t sec = getDeviceUptime_sec();
+
+	return (hour * 3600) + ((uint32_t)min * 60) + sec;
+}
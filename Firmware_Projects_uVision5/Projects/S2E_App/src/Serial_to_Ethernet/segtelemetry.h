@@ -0,0 +1,33 @@
+#ifndef SEGTELEMETRY_H_
+#define SEGTELEMETRY_H_
+
+#include <stdint.h>
+
+// Periodic UDP telemetry push of the device performance metrics to a collector
+// Collector: network_option.telemetry_ip (ConfigData.h), DEVICE_TELEMETRY_PORT; 0.0.0.0 disables the push.
+// The datagram is sent without waiting for the WZTOE; the result is checked at the next 1s tick.
+
+// Interval code (NET_OPTION_TELEMETRY_INTERVAL) -> sec; the code 0 is the default of the factory and older configuration
+#define TELEMETRY_INTERVAL_TABLE	{10, 1, 2, 5, 30, 60, 300, 600}
+#define TELEMETRY_INTERVAL_NUM		8
+
+// Datagram, all fields big-endian
+//  [Magic 'W' 'T'][Version 1][Device status 1][MAC 6][Sequence 4][Uptime sec 4]
+//  [Bytes 8 x 4: UART Rx / UART Tx / Ether Rx / Ether Tx][Packets 8 x 4: same order]
+//  [UART Rx ring high-water 2][Store-and-forward peak 4][Reconnect count 4][Connection attempts 4]
+//  [Max. event dispatch latency usec 4][PHY link down count 4]
+#define TELEMETRY_MAGIC_0			'W'
+#define TELEMETRY_MAGIC_1			'T'
+#define TELEMETRY_VERSION			1
+#define TELEMETRY_DATAGRAM_LEN		104
+
+// Called every second by the housekeeping event (main loop)
+void do_telemetry(void);
+
+// Push interval (sec) of the running configuration
+uint16_t get_telemetry_interval(void);
+
+// Push interval (sec) -> interval code of the running configuration; ret: [1] set / [0] not a table value
+uint8_t set_telemetry_interval(uint16_t sec);
+
+#endif /* SEGTELEMETRY_H_ */
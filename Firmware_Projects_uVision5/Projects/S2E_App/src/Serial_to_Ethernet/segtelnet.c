@@ -0,0 +1,489 @@
+#include <stdio.h>
+#include <string.h>
+#include "common.h"
+#include "W7500x_uart.h"
+#include "socket.h"
+#include "ConfigData.h"
+#include "seg.h"
+#include "segtelnet.h"
+#include "uartHandler.h"
+#include "gpioHandler.h"
+
+/* Private define ------------------------------------------------------------*/
+// Decoder states
+#define TELNET_STATE_DATA			0
+#define TELNET_STATE_IAC			1
+#define TELNET_STATE_OPTION			2	// WILL / WONT / DO / DONT received, waiting for the option code
+#define TELNET_STATE_SB				3
+#define TELNET_STATE_SB_IAC			4
+
+// Negotiated options, bit flags of the local (WILL) / remote (DO) side
+#define TELNET_OPTFLAG_BINARY		0x01
+#define TELNET_OPTFLAG_SGA			0x02
+#define TELNET_OPTFLAG_COM_PORT		0x04
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t tn_state = TELNET_STATE_DATA;
+static uint8_t tn_cmd = 0;
+static uint8_t tn_local = 0;
+static uint8_t tn_remote = 0;
+
+static uint8_t tn_sb_buf[TELNET_SB_BUF_SIZE];
+static uint8_t tn_sb_len = 0;
+
+static uint8_t tn_reply_buf[TELNET_REPLY_BUF_SIZE];
+static uint16_t tn_reply_len = 0;
+
+static uint8_t tn_modemstate = 0;
+static uint8_t tn_modemstate_mask = 0xFF;	// RFC 2217 defaults
+static uint8_t tn_linestate_mask = 0;
+static uint8_t tn_dtr = ON;
+static uint8_t tn_flow_suspended = SEG_DISABLE;
+
+/* Private functions prototypes ----------------------------------------------*/
+static void proc_telnet_option(uint8_t sock, uint8_t cmd, uint8_t opt);
+static void proc_telnet_com_port(uint8_t sock, uint8_t * sb, uint8_t len);
+static uint8_t get_telnet_optflag(uint8_t opt);
+static uint8_t get_telnet_modemstate(void);
+static uint8_t get_cpc_flow_control(struct __serial_info *serial);
+static void put_telnet_reply(uint8_t sock, const uint8_t * buf, uint16_t len);
+static void put_telnet_cpc_reply(uint8_t sock, uint8_t cmd, const uint8_t * value, uint8_t len);
+static void flush_telnet_reply(uint8_t sock);
+
+/* Public functions ----------------------------------------------------------*/
+uint16_t get_telnet_data_max(uint16_t bufsize)
+{
+	return (bufsize / 2);
+}
+
+// The data is scanned for IAC first; without any IAC byte, the data is sent as is.
+uint16_t encode_telnet_data(uint8_t * buf, uint16_t len)
+{
+	uint8_t * ptr;
+	uint16_t i;
+	uint16_t iac_cnt = 0;
+	uint16_t total;
+	uint16_t out;
+
+	ptr = memchr(buf, TELNET_IAC, len);
+	if(ptr == NULL) return len;
+
+	for(i = (uint16_t)(ptr - buf); i < len; i++)
+	{
+		if(buf[i] == TELNET_IAC) iac_cnt++;
+	}
+
+	// Expanded backward from the end of the data, in place
+	total = len + iac_cnt;
+	out = total;
+	for(i = len; (i > 0) && (iac_cnt > 0); i--)
+	{
+		buf[--out] = buf[i - 1];
+		if(buf[i - 1] == TELNET_IAC)
+		{
+			buf[--out] = TELNET_IAC;
+			iac_cnt--;
+		}
+	}
+
+	return total;
+}
+
+uint16_t decode_telnet_data(uint8_t sock, uint8_t * buf, uint16_t len)
+{
+	uint8_t * ptr;
+	uint16_t i;
+	uint16_t out;
+	uint8_t ch;
+
+	// Pure data block: returned as is
+	if(tn_state == TELNET_STATE_DATA)
+	{
+		ptr = memchr(buf, TELNET_IAC, len);
+		if(ptr == NULL) return len;
+
+		i = (uint16_t)(ptr - buf);
+	}
+	else
+	{
+		i = 0;
+	}
+
+	for(out = i; i < len; i++)
+	{
+		ch = buf[i];
+
+		switch(tn_state)
+		{
+			case TELNET_STATE_DATA:
+				if(ch == TELNET_IAC)	tn_state = TELNET_STATE_IAC;
+				else					buf[out++] = ch;
+				break;
+
+			case TELNET_STATE_IAC:
+				if(ch == TELNET_IAC) // Escaped 0xFF data byte
+				{
+					buf[out++] = ch;
+					tn_state = TELNET_STATE_DATA;
+				}
+				else if((ch >= TELNET_WILL) && (ch <= TELNET_DONT))
+				{
+					tn_cmd = ch;
+					tn_state = TELNET_STATE_OPTION;
+				}
+				else if(ch == TELNET_SB)
+				{
+					tn_sb_len = 0;
+					tn_state = TELNET_STATE_SB;
+				}
+				else // NOP, GA, AYT and the other commands are ignored
+				{
+					tn_state = TELNET_STATE_DATA;
+				}
+				break;
+
+			case TELNET_STATE_OPTION:
+				proc_telnet_option(sock, tn_cmd, ch);
+				tn_state = TELNET_STATE_DATA;
+				break;
+
+			case TELNET_STATE_SB:
+				if(ch == TELNET_IAC)					tn_state = TELNET_STATE_SB_IAC;
+				else if(tn_sb_len < TELNET_SB_BUF_SIZE)	tn_sb_buf[tn_sb_len++] = ch;
+				break;
+
+			case TELNET_STATE_SB_IAC:
+				if(ch == TELNET_SE)
+				{
+					if((tn_sb_len >= 2) && (tn_sb_buf[0] == TELNET_OPT_COM_PORT)) proc_telnet_com_port(sock, &tn_sb_buf[1], tn_sb_len - 1);
+					tn_state = TELNET_STATE_DATA;
+				}
+				else
+				{
+					if(tn_sb_len < TELNET_SB_BUF_SIZE) tn_sb_buf[tn_sb_len++] = ch; // IAC IAC: 0xFF in the parameter
+					tn_state = TELNET_STATE_SB;
+				}
+				break;
+
+			default:
+				tn_state = TELNET_STATE_DATA;
+				break;
+		}
+	}
+
+	flush_telnet_reply(sock);
+
+	return out;
+}
+
+void check_telnet_modemstate(uint8_t sock)
+{
+	uint8_t state;
+	uint8_t delta;
+
+	if(!(tn_remote & TELNET_OPTFLAG_COM_PORT)) return;
+
+	state = get_telnet_modemstate();
+	if(state == tn_modemstate) return;
+
+	delta = 0;
+	if((state ^ tn_modemstate) & CPC_MODEMSTATE_DSR) delta |= CPC_MODEMSTATE_DELTA_DSR;
+	if((state ^ tn_modemstate) & CPC_MODEMSTATE_CTS) delta |= CPC_MODEMSTATE_DELTA_CTS;
+	tn_modemstate = state;
+
+	state |= delta;
+	if(state & tn_modemstate_mask)
+	{
+		state &= tn_modemstate_mask;
+		put_telnet_cpc_reply(sock, CPC_NOTIFY_MODEMSTATE, &state, 1);
+		flush_telnet_reply(sock);
+	}
+}
+
+uint8_t get_telnet_flow_suspended(void)
+{
+	return tn_flow_suspended;
+}
+
+void init_telnet_session(void)
+{
+	tn_state = TELNET_STATE_DATA;
+	tn_cmd = 0;
+	tn_local = 0;
+	tn_remote = 0;
+	tn_sb_len = 0;
+	tn_reply_len = 0;
+
+	tn_modemstate = get_telnet_modemstate();
+	tn_modemstate_mask = 0xFF;
+	tn_linestate_mask = 0;
+	tn_dtr = ON;
+	tn_flow_suspended = SEG_DISABLE;
+}
+
+/* Private functions ---------------------------------------------------------*/
+// Accepted options: BINARY / SGA (both sides), COM-PORT-OPTION; the replies are sent only when the option state changes
+static void proc_telnet_option(uint8_t sock, uint8_t cmd, uint8_t opt)
+{
+	uint8_t optflag = get_telnet_optflag(opt);
+	uint8_t reply[3] = {TELNET_IAC, 0, opt};
+
+	switch(cmd)
+	{
+		case TELNET_WILL:
+			if(!optflag)						reply[1] = TELNET_DONT;
+			else if(!(tn_remote & optflag))		{ tn_remote |= optflag; reply[1] = TELNET_DO; }
+			break;
+
+		case TELNET_WONT:
+			if(tn_remote & optflag)				{ tn_remote &= ~optflag; reply[1] = TELNET_DONT; }
+			break;
+
+		case TELNET_DO:
+			if(!optflag)						reply[1] = TELNET_WONT;
+			else if(!(tn_local & optflag))		{ tn_local |= optflag; reply[1] = TELNET_WILL; }
+			break;
+
+		case TELNET_DONT:
+			if(tn_local & optflag)				{ tn_local &= ~optflag; reply[1] = TELNET_WONT; }
+			break;
+
+		default:
+			break;
+	}
+
+	if(reply[1] != 0) put_telnet_reply(sock, reply, 3);
+
+	// COM-PORT-OPTION enabled: modem state changes are notified from now on
+	if((optflag == TELNET_OPTFLAG_COM_PORT) && ((cmd == TELNET_WILL) || (cmd == TELNET_DO)))
+	{
+		tn_remote |= TELNET_OPTFLAG_COM_PORT;
+		tn_modemstate = get_telnet_modemstate();
+	}
+}
+
+// sb: [Command][Value]; the values not supported by the device are answered with the current setting
+static void proc_telnet_com_port(uint8_t sock, uint8_t * sb, uint8_t len)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	struct __serial_info *serial = (struct __serial_info *)dev_config->serial_info;
+	uint8_t cmd = sb[0];
+	uint8_t * value = &sb[1];
+	uint8_t value_len = len - 1;
+	uint8_t reply[4];
+	uint8_t apply = SEG_DISABLE;
+	uint32_t baud;
+	uint8_t i;
+
+	switch(cmd)
+	{
+		case CPC_SIGNATURE:
+			if(value_len == 0) put_telnet_cpc_reply(sock, cmd, dev_config->module_name, strlen((char *)dev_config->module_name));
+			break;
+
+		case CPC_SET_BAUDRATE:
+			if(value_len < 4) break;
+			baud = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) | ((uint32_t)value[2] << 8) | value[3];
+			for(i = 0; (baud != 0) && (get_uart_baud_rate(i) != 0); i++)
+			{
+				if(get_uart_baud_rate(i) == baud)
+				{
+					if(serial->baud_rate != i) { serial->baud_rate = i; apply = SEG_ENABLE; }
+					break;
+				}
+			}
+			baud = get_uart_baud_rate(serial->baud_rate);
+			reply[0] = (uint8_t)(baud >> 24);
+			reply[1] = (uint8_t)(baud >> 16);
+			reply[2] = (uint8_t)(baud >> 8);
+			reply[3] = (uint8_t)baud;
+			put_telnet_cpc_reply(sock, cmd, reply, 4);
+			break;
+
+		case CPC_SET_DATASIZE:
+			if(value_len < 1) break;
+			if((value[0] == 7) && (serial->data_bits != word_len7))			{ serial->data_bits = word_len7; apply = SEG_ENABLE; }
+			else if((value[0] == 8) && (serial->data_bits != word_len8))	{ serial->data_bits = word_len8; apply = SEG_ENABLE; }
+			reply[0] = (serial->data_bits == word_len7) ? 7 : 8;
+			put_telnet_cpc_reply(sock, cmd, reply, 1);
+			break;
+
+		case CPC_SET_PARITY: // MARK / SPACE: not supported
+			if(value_len < 1) break;
+			if((value[0] >= CPC_PARITY_NONE) && (value[0] <= CPC_PARITY_EVEN) && (serial->parity != (value[0] - CPC_PARITY_NONE)))
+			{
+				serial->parity = value[0] - CPC_PARITY_NONE;
+				apply = SEG_ENABLE;
+			}
+			reply[0] = serial->parity + CPC_PARITY_NONE;
+			put_telnet_cpc_reply(sock, cmd, reply, 1);
+			break;
+
+		case CPC_SET_STOPSIZE: // 1.5 stop bits: not supported
+			if(value_len < 1) break;
+			if((value[0] == CPC_STOPSIZE_1) && (serial->stop_bits != stop_bit1))		{ serial->stop_bits = stop_bit1; apply = SEG_ENABLE; }
+			else if((value[0] == CPC_STOPSIZE_2) && (serial->stop_bits != stop_bit2))	{ serial->stop_bits = stop_bit2; apply = SEG_ENABLE; }
+			reply[0] = (serial->stop_bits == stop_bit2) ? CPC_STOPSIZE_2 : CPC_STOPSIZE_1;
+			put_telnet_cpc_reply(sock, cmd, reply, 1);
+			break;
+
+		case CPC_SET_CONTROL:
+			if(value_len < 1) break;
+			switch(value[0])
+			{
+				case CPC_CONTROL_FLOW_NONE:
+				case CPC_CONTROL_FLOW_XONXOFF:
+				case CPC_CONTROL_FLOW_HARDWARE: // RTS/CTS: RS-232/TTL interface only
+					i = value[0] - CPC_CONTROL_FLOW_NONE; // CPC_CONTROL_FLOW_* -> enum flow_ctrl
+					if((i == flow_rts_cts) && (serial->uart_interface != UART_IF_RS232_TTL)) i = serial->flow_control;
+					if(serial->flow_control != i) { serial->flow_control = i; apply = SEG_ENABLE; }
+					// fall through
+				case CPC_CONTROL_FLOW_QUERY:
+					reply[0] = get_cpc_flow_control(serial);
+					break;
+
+				case CPC_CONTROL_BREAK_QUERY: // Break signal: not supported
+				case CPC_CONTROL_BREAK_ON:
+				case CPC_CONTROL_BREAK_OFF:
+					reply[0] = CPC_CONTROL_BREAK_OFF;
+					break;
+
+				case CPC_CONTROL_DTR_ON: // DTR pin is shared with the connection status pin, controlled only if DTR/DSR enabled
+				case CPC_CONTROL_DTR_OFF:
+					if(serial->dtr_en == SEG_ENABLE)
+					{
+						tn_dtr = (value[0] == CPC_CONTROL_DTR_ON) ? ON : OFF;
+						set_flowcontrol_dtr_pin(tn_dtr);
+					}
+					// fall through
+				case CPC_CONTROL_DTR_QUERY:
+					reply[0] = (tn_dtr == ON) ? CPC_CONTROL_DTR_ON : CPC_CONTROL_DTR_OFF;
+					break;
+
+				case CPC_CONTROL_RTS_QUERY: // RTS pin is driven by the UART (RTS/CTS) or RS-485 direction control
+				case CPC_CONTROL_RTS_ON:
+				case CPC_CONTROL_RTS_OFF:
+					reply[0] = CPC_CONTROL_RTS_ON;
+					break;
+
+				default: // Inbound flow control, DCD / DSR flow control: same as the outbound
+					reply[0] = value[0];
+					break;
+			}
+			put_telnet_cpc_reply(sock, cmd, reply, 1);
+			break;
+
+		case CPC_FLOWCONTROL_SUSPEND:
+			tn_flow_suspended = SEG_ENABLE;
+			break;
+
+		case CPC_FLOWCONTROL_RESUME:
+			tn_flow_suspended = SEG_DISABLE;
+			break;
+
+		case CPC_SET_LINESTATE_MASK: // Line state (UART errors) is not reported, the mask is kept only
+			if(value_len < 1) break;
+			tn_linestate_mask = value[0];
+			put_telnet_cpc_reply(sock, cmd, &tn_linestate_mask, 1);
+			break;
+
+		case CPC_SET_MODEMSTATE_MASK:
+			if(value_len < 1) break;
+			tn_modemstate_mask = value[0];
+			put_telnet_cpc_reply(sock, cmd, &tn_modemstate_mask, 1);
+			break;
+
+		case CPC_PURGE_DATA: // Serial data to the UART is not buffered (blocking transmit)
+			if(value_len < 1) break;
+			if((value[0] == CPC_PURGE_RX) || (value[0] == CPC_PURGE_BOTH)) uart_rx_flush(SEG_DATA_UART);
+			put_telnet_cpc_reply(sock, cmd, value, 1);
+			break;
+
+		default: // NOTIFY-LINESTATE / NOTIFY-MODEMSTATE: server to client only
+			break;
+	}
+
+	if(apply == SEG_ENABLE)
+	{
+		while(UART_GetFlagStatus(UART_data, UART_FLAG_BUSY) == SET); // Wait for the last character transmitted
+		serial_info_init(UART_data, serial);
+
+		if(serial->serial_debug_en == SEG_ENABLE)
+		{
+			printf(" > SEG:TELNET:COM PORT - %d-%d-%s-%d, %s\r\n", (int)get_uart_baud_rate(serial->baud_rate), word_len_table[serial->data_bits],
+						parity_table[serial->parity], stop_bit_table[serial->stop_bits], flow_ctrl_table[serial->flow_control]);
+		}
+	}
+}
+
+static uint8_t get_telnet_optflag(uint8_t opt)
+{
+	switch(opt)
+	{
+		case TELNET_OPT_BINARY:		return TELNET_OPTFLAG_BINARY;
+		case TELNET_OPT_SGA:		return TELNET_OPTFLAG_SGA;
+		case TELNET_OPT_COM_PORT:	return TELNET_OPTFLAG_COM_PORT;
+		default:					return 0;
+	}
+}
+
+// DSR: DSR pin if DTR/DSR enabled, CTS: UART CTS input if RTS/CTS flow control enabled; the others are reported as asserted
+static uint8_t get_telnet_modemstate(void)
+{
+	struct __serial_info *serial = (struct __serial_info *)get_DevConfig_pointer()->serial_info;
+	uint8_t state = (CPC_MODEMSTATE_DSR | CPC_MODEMSTATE_CTS);
+
+	if((serial->dsr_en == SEG_ENABLE) && (get_flowcontrol_dsr_pin() == 0)) state &= ~CPC_MODEMSTATE_DSR;
+	if((serial->flow_control == flow_rts_cts) && (UART_GetFlagStatus(UART_data, UART_FLAG_CTS) == RESET)) state &= ~CPC_MODEMSTATE_CTS;
+
+	return state;
+}
+
+static uint8_t get_cpc_flow_control(struct __serial_info *serial)
+{
+	switch(serial->flow_control)
+	{
+		case flow_xon_xoff:		return CPC_CONTROL_FLOW_XONXOFF;
+		case flow_rts_cts:		return CPC_CONTROL_FLOW_HARDWARE;
+		default:				return CPC_CONTROL_FLOW_NONE;
+	}
+}
+
+static void put_telnet_reply(uint8_t sock, const uint8_t * buf, uint16_t len)
+{
+	if((tn_reply_len + len) > TELNET_REPLY_BUF_SIZE) flush_telnet_reply(sock);
+	if(len > TELNET_REPLY_BUF_SIZE) return;
+
+	memcpy(&tn_reply_buf[tn_reply_len], buf, len);
+	tn_reply_len += len;
+}
+
+// [IAC][SB][COM-PORT-OPTION][Command + 100][Value, IAC escaped][IAC][SE]
+static void put_telnet_cpc_reply(uint8_t sock, uint8_t cmd, const uint8_t * value, uint8_t len)
+{
+	uint8_t buf[TELNET_REPLY_BUF_SIZE];
+	uint16_t pos = 0;
+	uint8_t i;
+
+	buf[pos++] = TELNET_IAC;
+	buf[pos++] = TELNET_SB;
+	buf[pos++] = TELNET_OPT_COM_PORT;
+	buf[pos++] = cmd + CPC_SERVER_OFFSET;
+	for(i = 0; (i < len) && (pos < (TELNET_REPLY_BUF_SIZE - 3)); i++)
+	{
+		buf[pos++] = value[i];
+		if(value[i] == TELNET_IAC) buf[pos++] = TELNET_IAC;
+	}
+	buf[pos++] = TELNET_IAC;
+	buf[pos++] = TELNET_SE;
+
+	put_telnet_reply(sock, buf, pos);
+}
+
+static void flush_telnet_reply(uint8_t sock)
+{
+	if(tn_reply_len == 0) return;
+
+	send(sock, tn_reply_buf, tn_reply_len);
+	tn_reply_len = 0;
+}
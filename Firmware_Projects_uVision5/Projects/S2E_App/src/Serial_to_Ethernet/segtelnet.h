@@ -0,0 +1,94 @@
+#ifndef SEGTELNET_H_
+#define SEGTELNET_H_
+
+#include <stdint.h>
+
+// Telnet with COM port control (RFC 2217) on the TCP data socket, NET_OPTION_TELNET_COM_PORT (ConfigData.h)
+// The serial port settings changed by the peer are applied to the running configuration, not saved to the flash.
+
+/* Telnet commands (RFC 854) */
+#define TELNET_SE					240
+#define TELNET_SB					250
+#define TELNET_WILL					251
+#define TELNET_WONT					252
+#define TELNET_DO					253
+#define TELNET_DONT					254
+#define TELNET_IAC					255
+
+/* Telnet options */
+#define TELNET_OPT_BINARY			0
+#define TELNET_OPT_SGA				3		// Suppress Go Ahead
+#define TELNET_OPT_COM_PORT			44		// COM-PORT-OPTION (RFC 2217)
+
+/* COM-PORT-OPTION commands: Client -> Server, the server replies with (command + CPC_SERVER_OFFSET) */
+#define CPC_SIGNATURE				0
+#define CPC_SET_BAUDRATE			1
+#define CPC_SET_DATASIZE			2
+#define CPC_SET_PARITY				3
+#define CPC_SET_STOPSIZE			4
+#define CPC_SET_CONTROL				5
+#define CPC_NOTIFY_LINESTATE		6
+#define CPC_NOTIFY_MODEMSTATE		7
+#define CPC_FLOWCONTROL_SUSPEND		8
+#define CPC_FLOWCONTROL_RESUME		9
+#define CPC_SET_LINESTATE_MASK		10
+#define CPC_SET_MODEMSTATE_MASK		11
+#define CPC_PURGE_DATA				12
+#define CPC_SERVER_OFFSET			100
+
+/* SET-PARITY / SET-STOPSIZE values */
+#define CPC_PARITY_NONE				1
+#define CPC_PARITY_ODD				2
+#define CPC_PARITY_EVEN				3
+#define CPC_STOPSIZE_1				1
+#define CPC_STOPSIZE_2				2
+
+/* SET-CONTROL values */
+#define CPC_CONTROL_FLOW_QUERY		0
+#define CPC_CONTROL_FLOW_NONE		1
+#define CPC_CONTROL_FLOW_XONXOFF	2
+#define CPC_CONTROL_FLOW_HARDWARE	3
+#define CPC_CONTROL_BREAK_QUERY		4
+#define CPC_CONTROL_BREAK_ON		5
+#define CPC_CONTROL_BREAK_OFF		6
+#define CPC_CONTROL_DTR_QUERY		7
+#define CPC_CONTROL_DTR_ON			8
+#define CPC_CONTROL_DTR_OFF			9
+#define CPC_CONTROL_RTS_QUERY		10
+#define CPC_CONTROL_RTS_ON			11
+#define CPC_CONTROL_RTS_OFF			12
+
+/* PURGE-DATA values */
+#define CPC_PURGE_RX				1		// Serial data received from the UART, not sent yet
+#define CPC_PURGE_TX				2		// Network data to be sent to the UART
+#define CPC_PURGE_BOTH				3
+
+/* NOTIFY-MODEMSTATE bits */
+#define CPC_MODEMSTATE_DSR			0x20
+#define CPC_MODEMSTATE_CTS			0x10
+#define CPC_MODEMSTATE_DELTA_DSR	0x02
+#define CPC_MODEMSTATE_DELTA_CTS	0x01
+
+#define TELNET_SB_BUF_SIZE			16		// COM-PORT-OPTION subnegotiation: [Option][Command][Value, max. 4 bytes]
+#define TELNET_REPLY_BUF_SIZE		64		// Negotiation replies, sent once per received data block
+
+// Max. serial data length can be escaped in place in the buffer of 'bufsize' bytes (worst case: all bytes are IAC)
+uint16_t get_telnet_data_max(uint16_t bufsize);
+
+// Serial data -> Telnet data stream (IAC doubling), in place; ret: encoded length
+uint16_t encode_telnet_data(uint8_t * buf, uint16_t len);
+
+// Telnet data stream -> Serial data, in place. Telnet commands are processed and removed,
+// the replies are sent to the 'sock'. Commands can be split across the calls; ret: serial data length
+uint16_t decode_telnet_data(uint8_t sock, uint8_t * buf, uint16_t len);
+
+// Modem state lines check, NOTIFY-MODEMSTATE is sent on change; call periodically while connected
+void check_telnet_modemstate(uint8_t sock);
+
+// [1] The peer requested to suspend the data transfer to it (FLOWCONTROL-SUSPEND)
+uint8_t get_telnet_flow_suspended(void);
+
+// Telnet session state reset; call when a new connection is established
+void init_telnet_session(void);
+
+#endif /* SEGTELNET_H_ */
@@ -25,6 +25,7 @@
 #include "W7500x_board.h"
 #include "timerHandler.h"
 #include "uartHandler.h"
+#include "eventHandler.h"
 
 
 /* Private typedef -----------------------------------------------------------*/
@@ -296,7 +297,9 @@ void ADC_Handler(void)
   * @retval None
   */
 void WZTOE_Handler(void)
-{}
+{
+	WZTOE_IRQ_Handler();
+}
 
 /**
   * @brief  This function handles EXTI Handler.
@@ -32,6 +32,10 @@
 #define SOCK_DNS			4
 #define SOCK_FWUPDATE		4
 
+#define SOCK_MODBUS			5	// MODBUS_GATEWAY_MODE: 2nd Modbus TCP master connection
+
+#define SOCK_TELEMETRY		6	// UDP telemetry push, polled by the housekeeping event (no socket interrupt)
+
 ////////////////////////////////
 // In/External Clock Setting  //
 ////////////////////////////////
@@ -81,6 +85,8 @@ typedef enum{ST_BOOT, ST_OPEN, ST_CONNECT, ST_UPGRADE, ST_ATMODE, ST_UDP} teDEVS
 #define TCP_SERVER_MODE		1
 #define TCP_MIXED_MODE		2
 #define UDP_MODE			3
+#define L2_TUNNEL_MODE		4
+#define MODBUS_GATEWAY_MODE	5
 
 #define MIXED_SERVER		0
 #define MIXED_CLIENT		1
@@ -40,6 +40,7 @@
 
 #include "seg.h"
 #include "segcp.h"
+#include "segtelemetry.h"
 #include "configData.h"
 
 #include "timerHandler.h"
@@ -47,6 +48,9 @@
 #include "deviceHandler.h"
 #include "flashHandler.h"
 #include "gpioHandler.h"
+#include "eventHandler.h"
+#include "profileHandler.h"
+#include "memoryHandler.h"
 
 // ## for debugging
 //#include "loopback.h"
@@ -63,6 +67,12 @@ static void W7500x_WZTOE_Init(void);
 int8_t process_dhcp(void);
 int8_t process_dns(void);
 
+// Main loop event handlers
+static void event_seg_handler(void);
+static void event_segcp_handler(void);
+static void event_dhcp_handler(void);
+static void event_system_handler(void);
+
 // Debug messages
 void display_Dev_Info_header(void);
 void display_Dev_Info_main(void);
@@ -89,6 +99,9 @@ int main(void)
 {
 	DevConfig *dev_config = get_DevConfig_pointer();
 	
+	/* Stack high-water mark: the unused stack is painted before the interrupts are enabled */
+	paint_stack();
+	
 	////////////////////////////////////////////////////////////////////////////////////////////////////
 	// W7500x Hardware Initialize
 	////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -186,29 +199,25 @@ int main(void)
 		flag_hw_trig_enable = 0;
 	}
 	
+	/* Main loop event handlers: dispatched in order of priority, data path first */
+	reg_event_handler(EVENT_SEG, event_seg_handler);
+	reg_event_handler(EVENT_SEGCP, event_segcp_handler);
+	reg_event_handler(EVENT_DHCP, event_dhcp_handler);
+	reg_event_handler(EVENT_SYSTEM, event_system_handler);
+	
+	/* WZTOE socket interrupts: wake up the main loop */
+	Event_Configuration();
+	
+	post_event(EVENT_SEG);
+	post_event(EVENT_SEGCP);
+	
 	while(1) // main loop
 	{
-		do_segcp();
-		do_seg(SOCK_DATA);
-		
-		if(dev_config->options.dhcp_use) DHCP_run(); // DHCP client handler for IP renewal
+		// Runs the pending events; the core sleeps (WFI) until the next interrupt when nothing is left to do
+		if(!dispatch_event()) wait_for_event();
 		
 		// ## debugging: Data echoback
 		//loopback_tcps(6, g_recv_buf, 5001);
-		
-		// ## debugging: PHY link
-		if(flag_check_phylink)
-		{
-			//printf("PHY Link status: %x\r\n", GPIO_ReadInputDataBit(PHYLINK_IN_PORT, PHYLINK_IN_PIN));
-			flag_check_phylink = 0;	// flag clear
-		}
-		
-		// ## debugging: Ring buffer full
-		if(flag_ringbuf_full)
-		{
-			if(dev_config->serial_info[0].serial_debug_en) printf(" > UART Rx Ring buffer Full\r\n");
-			flag_ringbuf_full = 0;
-		}
 	} // End of application main loop
 } // End of main
 
@@ -257,7 +266,7 @@ static void W7500x_WZTOE_Init(void)
 	uint8_t rx_size[8] = { 4, 2, 2, 2, 2, 2, 2, 0 }; // default: { 2, 2, 2, 2, 2, 2, 2, 2 }
 	
 	/* Structure for TCP timeout control: RTR, RCR */
-	wiz_NetTimeout * net_timeout;
+	wiz_NetTimeout net_timeout;
 	
 #ifdef _MAIN_DEBUG_
 	uint8_t i;
@@ -273,13 +282,13 @@ static void W7500x_WZTOE_Init(void)
 	
 	/* Set TCP Timeout: retry count / timeout val */
 	// Retry count default: [8], Timeout val default: [2000]
-	net_timeout->retry_cnt = 8;
-	net_timeout->time_100us = 2500;
-	wizchip_settimeout(net_timeout);
+	net_timeout.retry_cnt = 8;
+	net_timeout.time_100us = 2500;
+	wizchip_settimeout(&net_timeout);
 	
 #ifdef _MAIN_DEBUG_
-	wizchip_gettimeout(net_timeout); // TCP timeout settings
-	printf(" - Network Timeout Settings - RCR: %d, RTR: %dms\r\n", net_timeout->retry_cnt, net_timeout->time_100us);
+	wizchip_gettimeout(&net_timeout); // TCP timeout settings
+	printf(" - Network Timeout Settings - RCR: %d, RTR: %dms\r\n", net_timeout.retry_cnt, net_timeout.time_100us);
 #endif
 	
 	/* Set Network Configuration */
@@ -399,6 +408,62 @@ int8_t process_dns(void)
 	return ret;
 }
 
+static void event_seg_handler(void)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	
+	do_seg(SOCK_DATA);
+	
+	// Received data left in the socket buffer: keep the data path running
+	// (Modbus gateway: queued requests wait in the socket buffer for the RTU bus, polled by the 1ms timer event)
+	if(getSn_RX_RSR(SOCK_DATA) && (dev_config->network_info[0].working_mode != MODBUS_GATEWAY_MODE)) post_event(EVENT_SEG);
+}
+
+static void event_segcp_handler(void)
+{
+	do_segcp();
+}
+
+static void event_dhcp_handler(void)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	
+	if(dev_config->options.dhcp_use) // DHCP client handler for IP renewal
+	{
+		CALL_PROBE_ENTER(PROFILE_DHCP_RUN);
+		DHCP_run();
+		CALL_PROBE_EXIT(PROFILE_DHCP_RUN);
+	}
+}
+
+static void event_system_handler(void)
+{
+	DevConfig *dev_config = get_DevConfig_pointer();
+	
+	// ## debugging: PHY link
+	if(flag_check_phylink)
+	{
+		//printf("PHY Link status: %x\r\n", GPIO_ReadInputDataBit(PHYLINK_IN_PORT, PHYLINK_IN_PIN));
+		flag_check_phylink = 0;	// flag clear
+	}
+	
+	// ## debugging: Ring buffer full
+	if(flag_ringbuf_full)
+	{
+		if(dev_config->serial_info[0].serial_debug_en) printf(" > UART Rx Ring buffer Full\r\n");
+		flag_ringbuf_full = 0;
+	}
+	
+	// UDP telemetry push
+	do_telemetry();
+	
+	// Stack high-water mark scan
+	check_stack_usage();
+	
+	// Deferred configuration data save
+	do_save_DevConfig();
+}
+
 void display_Dev_Info_header(void)
 {
 	DevConfig *dev_config = get_DevConfig_pointer();
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+#
+# W7500x S2E App - binary TLV configuration client (Linux host)
+#
+# The protocol is of src/Configuration/segcptlv.h; served on the SEGCP UDP port with the ASCII commands.
+#
+#   s2e_config.py get [options] <device ip> [field ...]
+#       Reads the fields (default: all) with the broadcast MAC (read privilege)
+#   s2e_config.py set [options] -m MAC [--save] [--reboot] <device ip> field=value [field=value ...]
+#       Writes the fields in a request; none is written if a value is rejected
+#
+#   Options: [-w search password] [-p port] [-t timeout] [-u]
+#       -u: the reply to this host, not broadcast (always with the device MAC)
+#   Values: IP addresses as a.b.c.d, byte arrays as hex (e.g., serial_trigger=2b2b2b), strings as they are
+
+import argparse
+import random
+import socket
+import struct
+import sys
+
+SEGCP_PORT = 50001
+MAGIC = b'WC'
+VERSION = 1
+
+OP_GET = 0x01
+OP_SET = 0x02
+FLAG_SAVE = 0x10
+FLAG_REBOOT = 0x20
+FLAG_UNICAST = 0x40
+OP_REPLY = 0x80
+
+# SEGCP_ER_* of segcp.h
+STATUS = {0: 'OK', 1: 'not available', 2: 'no parameter', 3: 'ignored (read only)', 4: 'unknown field / operation',
+          5: 'invalid value', 6: 'no privilege (device MAC required)'}
+
+# teSEGCPTLV: id, value type ('u8', 'u16', 'ip', 'bytes', 'str')
+FIELDS = {
+    'mac': (0x01, 'bytes'), 'fw_ver': (0x02, 'ver'), 'module_type': (0x03, 'bytes'), 'module_name': (0x04, 'str'),
+    'uart_interface': (0x05, 'u8'),
+    'local_ip': (0x10, 'ip'), 'gateway': (0x11, 'ip'), 'subnet': (0x12, 'ip'), 'dhcp_use': (0x13, 'u8'),
+    'dns_server_ip': (0x14, 'ip'), 'dns_use': (0x15, 'u8'), 'dns_domain_name': (0x16, 'str'),
+    'working_mode': (0x20, 'u8'), 'remote_ip': (0x21, 'ip'), 'local_port': (0x22, 'u16'), 'remote_port': (0x23, 'u16'),
+    'inactivity': (0x24, 'u16'), 'reconnection': (0x25, 'u16'), 'packing_time': (0x26, 'u16'),
+    'packing_size': (0x27, 'u8'), 'packing_delimiter': (0x28, 'bytes'), 'packing_delimiter_length': (0x29, 'u8'),
+    'packing_data_appendix': (0x2A, 'u8'), 'keepalive_en': (0x2B, 'u8'), 'keepalive_wait_time': (0x2C, 'u16'),
+    'keepalive_retry_time': (0x2D, 'u16'),
+    'baud_rate': (0x30, 'u8'), 'data_bits': (0x31, 'u8'), 'parity': (0x32, 'u8'), 'stop_bits': (0x33, 'u8'),
+    'flow_control': (0x34, 'u8'), 'dtr_en': (0x35, 'u8'), 'dsr_en': (0x36, 'u8'), 'serial_debug_en': (0x37, 'u8'),
+    'pw_connect': (0x40, 'str'), 'pw_search': (0x41, 'str'), 'pw_connect_en': (0x42, 'u8'),
+    'serial_command': (0x43, 'u8'), 'serial_command_echo': (0x44, 'u8'), 'serial_trigger': (0x45, 'bytes'),
+    'reconnect_backoff_max': (0x50, 'u8'), 'option_flags': (0x51, 'u8'), 'frame_mode': (0x52, 'u8'),
+    'telemetry_ip': (0x53, 'ip'),
+}
+NAMES = dict((fid, name) for name, (fid, _) in FIELDS.items())
+
+
+def crc16_modbus(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def encode(name, text):
+    fid, kind = FIELDS[name]
+    if kind == 'u8':
+        value = struct.pack('>B', int(text, 0))
+    elif kind == 'u16':
+        value = struct.pack('>H', int(text, 0))
+    elif kind == 'ip':
+        value = socket.inet_aton(text)
+    elif kind == 'str':
+        value = text.encode()
+    else:
+        value = bytes.fromhex(text.replace(':', '').replace('-', ''))
+    return struct.pack('BB', fid, len(value)) + value
+
+
+def decode(fid, value):
+    kind = FIELDS[NAMES[fid]][1] if fid in NAMES else 'bytes'
+    if kind in ('u8', 'u16'):
+        return str(int.from_bytes(value, 'big'))
+    if kind == 'ip':
+        return socket.inet_ntoa(value)
+    if kind == 'ver':
+        return '.'.join(str(b) for b in value)
+    if kind == 'str':
+        return value.decode('latin-1')
+    return value.hex()
+
+
+def request(args, op, tlvs):
+    mac = bytes.fromhex(args.mac.replace(':', '').replace('-', '')) if args.mac else b'\xff' * 6
+    pw = args.password.encode()
+    seq = random.getrandbits(16)
+    packet = MAGIC + struct.pack('>BBH', VERSION, op, seq) + mac + bytes([len(pw)]) + pw + tlvs
+    packet += struct.pack('<H', crc16_modbus(packet))
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.settimeout(args.timeout)
+    sock.sendto(packet, (args.ip, args.port))
+
+    # The reply may be broadcast: the other replies (e.g., ASCII) and the devices are skipped by the header
+    while True:
+        data, _ = sock.recvfrom(2048)
+        if len(data) < 16 or data[0:2] != MAGIC or crc16_modbus(data) != 0:
+            continue
+        _, rop, rseq = struct.unpack('>BBH', data[2:6])
+        if rop == (op | OP_REPLY) and rseq == seq and (not args.mac or data[6:12] == mac):
+            return data[12], data[13], data[14:-2]
+
+
+def print_reply(status, err_id, tlvs):
+    if status:
+        sys.stderr.write('Error: %s, field %s\n' % (STATUS.get(status, status), NAMES.get(err_id, '0x%02X' % err_id)))
+        return 1
+    i = 0
+    while i + 2 <= len(tlvs):
+        fid, length = tlvs[i], tlvs[i + 1]
+        value = tlvs[i + 2:i + 2 + length]
+        print('%-26s %s' % (NAMES.get(fid, '0x%02X' % fid), decode(fid, value)))
+        i += 2 + length
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='W7500x S2E binary TLV configuration client')
+    sub = parser.add_subparsers(dest='command')
+
+    for name in ('get', 'set'):
+        p = sub.add_parser(name)
+        p.add_argument('ip')
+        p.add_argument('fields', nargs='*')
+        p.add_argument('-p', '--port', type=int, default=SEGCP_PORT)
+        p.add_argument('-m', '--mac', help='device MAC address (default: broadcast MAC, read only)')
+        p.add_argument('-w', '--password', default='', help='search password')
+        p.add_argument('-t', '--timeout', type=float, default=2.0)
+        p.add_argument('-u', '--unicast', action='store_true', help='reply to this host (default: broadcast with the broadcast MAC)')
+        if name == 'set':
+            p.add_argument('--save', action='store_true', help='save to the storage')
+            p.add_argument('--reboot', action='store_true', help='reboot the device (apply the IP settings)')
+
+    args = parser.parse_args()
+    if args.command is None:
+        parser.print_help()
+        return 1
+
+    flags = FLAG_UNICAST if args.unicast else 0
+    try:
+        if args.command == 'get':
+            tlvs = b''.join(struct.pack('BB', FIELDS[f][0], 0) for f in args.fields)
+            op = OP_GET | flags
+        else:
+            tlvs = b''.join(encode(*f.split('=', 1)) for f in args.fields)
+            op = OP_SET | flags | (FLAG_SAVE if args.save else 0) | (FLAG_REBOOT if args.reboot else 0)
+    except (KeyError, ValueError, OSError) as e:
+        sys.stderr.write('Invalid field: %s\n' % e)
+        return 1
+
+    try:
+        return print_reply(*request(args, op, tlvs))
+    except socket.timeout:
+        sys.stderr.write('No reply from %s:%d\n' % (args.ip, args.port))
+        return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
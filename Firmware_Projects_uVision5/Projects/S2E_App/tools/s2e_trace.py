@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+#
+# W7500x S2E App - data-path event trace decoder (Linux host)
+#
+# The trace records are read by the SEGCP TD command (src/PlatformHandler/traceHandler.h):
+#   TD0 rewinds the dump cursor, each TD returns the next page of a ring until an empty page.
+#   Page: [ring],[first sequence number],[now usec]/[record],[record],...
+#   Record (hex): [time usec 8][event 2][arg8 2][arg16 4]
+#
+#   s2e_trace.py fetch <device ip> -m MAC [-w search password] [-p port] [-o dump.txt]
+#       Dumps the trace over the SEGCP UDP port, decodes it; -o keeps the raw pages for later
+#       The device MAC is required: TD0 is a set command, refused with the broadcast MAC (read only)
+#   s2e_trace.py decode <dump.txt>
+#       Decodes the saved pages or a captured terminal log (e.g., the TD replies of the serial AT command mode)
+#
+# The rings (main loop, interrupt priority 0 to 3) are merged by the timestamp; the time is shown
+# relative to the end of the dump. The timestamps wrap around every 71 minutes.
+
+import argparse
+import re
+import socket
+import sys
+
+SEGCP_PORT = 50001
+RING_NAMES = ['main', 'irq0', 'irq1', 'irq2', 'irq3']
+PAGE_RE = re.compile(r'TD(\d+),(\d+),(\d+)/([0-9A-Fa-f,]*)')
+
+# The order of teTRACE
+EVENTS = ['NONE', 'UART_RING_FULL', 'UART_RTS_OFF', 'UART_RTS_ON', 'UART_XOFF', 'UART_XON', 'SEND_BUSY',
+          'SEND_SHORT', 'SOCK_STATE', 'PACK_FULL', 'CONNECT', 'CONN_LOST', 'RECONNECTED']
+
+SOCK_STATUS = {0x00: 'CLOSED', 0x13: 'INIT', 0x14: 'LISTEN', 0x15: 'SYNSENT', 0x16: 'SYNRECV',
+               0x17: 'ESTABLISHED', 0x18: 'FIN_WAIT', 0x1A: 'CLOSING', 0x1B: 'TIME_WAIT', 0x1C: 'CLOSE_WAIT',
+               0x1D: 'LAST_ACK', 0x22: 'UDP', 0x32: 'IPRAW', 0x42: 'MACRAW', 0x5F: 'PPPOE'}
+
+
+def sock_status(code):
+    return SOCK_STATUS.get(code, '0x%02X' % code)
+
+
+def describe(event, arg8, arg16):
+    name = EVENTS[event] if event < len(EVENTS) else 'EVENT_%d' % event
+
+    if name in ('UART_RTS_OFF', 'UART_RTS_ON', 'UART_XOFF', 'UART_XON'):
+        return '%s rx_used=%d' % (name, arg16)
+    if name in ('SEND_BUSY', 'SEND_SHORT'):
+        return '%s sock=%d dropped=%d' % (name, arg8, arg16)
+    if name == 'SOCK_STATE':
+        return '%s sock=%d %s -> %s' % (name, arg8, sock_status(arg16 >> 8), sock_status(arg16 & 0xFF))
+    if name == 'PACK_FULL':
+        return '%s size=%d' % (name, arg16)
+    if name == 'CONNECT':
+        return '%s attempt=%d next_wait=%dms' % (name, arg8, arg16)
+    if name == 'RECONNECTED':
+        return '%s outage=%s%dms' % (name, '>=' if arg16 == 0xFFFF else '', arg16)
+    if arg8 or arg16:
+        return '%s arg8=%d arg16=%d' % (name, arg8, arg16)
+    return name
+
+
+def parse_pages(text):
+    pages = []
+    for m in PAGE_RE.finditer(text):
+        recs = [r for r in m.group(4).split(',') if len(r) == 16]
+        pages.append((int(m.group(1)), int(m.group(2)), int(m.group(3)), recs))
+    return pages
+
+
+def decode(pages, out):
+    records = []
+    gaps = []
+    next_seq = {}
+    now = None
+
+    for ring, seq, page_now, recs in pages:
+        now = page_now # The latest page is the reference: all the records were written before it
+        if not recs:
+            continue
+        if ring in next_seq and seq != next_seq[ring]:
+            gaps.append((ring, next_seq[ring], seq))
+        elif ring not in next_seq and seq != 0:
+            gaps.append((ring, 0, seq))
+        for i, r in enumerate(recs):
+            records.append((int(r[0:8], 16), ring, seq + i, int(r[8:10], 16), int(r[10:12], 16), int(r[12:16], 16)))
+        next_seq[ring] = seq + len(recs)
+
+    if now is None:
+        out.write('No trace pages found\n')
+        return 1
+
+    # Age from the end of the dump; the 32-bit usec timestamps are compared modulo 2^32
+    records.sort(key=lambda r: (now - r[0]) & 0xFFFFFFFF, reverse=True)
+
+    for ring, first, seq in gaps:
+        out.write('# %s: records %d..%d overwritten\n' % (RING_NAMES[ring] if ring < len(RING_NAMES) else ring, first, seq - 1))
+
+    out.write('%14s  %-5s %6s  %s\n' % ('time (s)', 'ring', 'seq', 'event'))
+    for time, ring, seq, event, arg8, arg16 in records:
+        age = (now - time) & 0xFFFFFFFF
+        out.write('%14.6f  %-5s %6d  %s\n' % (-age / 1e6, RING_NAMES[ring] if ring < len(RING_NAMES) else ring, seq,
+                                             describe(event, arg8, arg16)))
+    return 0
+
+
+# The set commands (e.g., TD0) have no reply; the reply of the last TD read is returned
+def segcp_request(sock, addr, header, cmds):
+    sock.sendto(header + cmds + b'\r\n', addr)
+    while True:
+        data, _ = sock.recvfrom(2048)
+        body = data[10:].decode('latin-1') # [MA][MAC 6][\r\n]
+        for line in body.split('\r\n'):
+            if PAGE_RE.match(line):
+                return line
+
+
+def fetch(args):
+    mac = bytes.fromhex(args.mac.replace(':', '').replace('-', ''))
+    header = b'MA' + mac + b'\r\nPW ' + args.password.encode() + b'\r\n'
+    header += b'QD0\r\n' # The device is addressed by the IP: no search reply delay
+    addr = (args.ip, args.port)
+    lines = []
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.settimeout(args.timeout)
+
+    try:
+        cmds = b'TD0\r\nTD'
+        while True:
+            line = segcp_request(sock, addr, header, cmds)
+            cmds = b'TD'
+            lines.append(line)
+            pages = parse_pages(line)
+            if not pages or not pages[0][3]:
+                break
+    except socket.timeout:
+        sys.stderr.write('No reply from %s:%d\n' % addr)
+        return 1
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write('\n'.join(lines) + '\n')
+
+    return decode(parse_pages('\n'.join(lines)), sys.stdout)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='W7500x S2E data-path event trace decoder')
+    sub = parser.add_subparsers(dest='command')
+
+    p = sub.add_parser('fetch', help='dump the trace over SEGCP (UDP) and decode')
+    p.add_argument('ip')
+    p.add_argument('-p', '--port', type=int, default=SEGCP_PORT)
+    p.add_argument('-m', '--mac', required=True, help='device MAC address (TD0 rewinds the dump: write privilege)')
+    p.add_argument('-w', '--password', default='', help='search password')
+    p.add_argument('-o', '--output', help='save the raw TD pages')
+    p.add_argument('-t', '--timeout', type=float, default=2.0)
+
+    p = sub.add_parser('decode', help='decode saved TD pages')
+    p.add_argument('file')
+
+    args = parser.parse_args()
+    if args.command == 'fetch':
+        return fetch(args)
+    if args.command == 'decode':
+        with open(args.file, 'r', errors='replace') as f:
+            return decode(parse_pages(f.read()), sys.stdout)
+    parser.print_help()
+    return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())